@@ -0,0 +1,154 @@
+/**
+ * Copyright Matthew Oliver
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "Batch.h"
+
+#include "Shared.h"
+#include "TextureCache.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <thread>
+
+using namespace std;
+
+namespace {
+bool matchWildcard(string_view pattern, string_view name) noexcept
+{
+    // Simple glob matching where '*' matches any number of characters and '?' matches a single character
+    size_t p = 0, n = 0, star = string_view::npos, starMatch = 0;
+    while (n < name.size()) {
+        if (p < pattern.size() && (pattern[p] == '?' || pattern[p] == name[n])) {
+            ++p;
+            ++n;
+        } else if (p < pattern.size() && pattern[p] == '*') {
+            star = p++;
+            starMatch = n;
+        } else if (star != string_view::npos) {
+            p = star + 1;
+            n = ++starMatch;
+        } else {
+            return false;
+        }
+    }
+    while (p < pattern.size() && pattern[p] == '*') {
+        ++p;
+    }
+    return p == pattern.size();
+}
+} // namespace
+
+vector<string> findBatchFiles(const string& batch) noexcept
+{
+    vector<string> files;
+    error_code ec;
+    if (batch.find_first_of("*?") == string::npos) {
+        // Read list of files, relative paths are relative to the list file
+        ifstream list(batch);
+        if (!list.is_open()) {
+            printError("Failed to open batch file list: "s + batch);
+            return files;
+        }
+        const string folder = getFolder(batch);
+        string line;
+        while (getline(list, line)) {
+            while (!line.empty() && isspace(static_cast<unsigned char>(line.back()))) {
+                line.pop_back();
+            }
+            if (line.empty() || line.front() == '#') {
+                continue;
+            }
+            files.push_back(filesystem::path(line).is_absolute() ? line : folder + line);
+        }
+        return files;
+    }
+
+    // Find all files in the folder that match the wildcard file name
+    const string folder = getFolder(batch);
+    const string pattern = batch.substr(folder.length());
+    for (auto& entry : filesystem::directory_iterator(folder.empty() ? "." : folder, ec)) {
+        const string name = entry.path().filename().string();
+        if (entry.is_regular_file(ec) && matchWildcard(pattern, name)) {
+            files.push_back(folder + name);
+        }
+    }
+    if (ec) {
+        printError("Failed to search batch folder: "s + folder);
+    }
+    ranges::sort(files);
+    return files;
+}
+
+bool optimiseBatch(const Optimiser::Options& options, const vector<pair<string, string>>& files, uint32_t jobs,
+    size_t cacheSize) noexcept
+{
+    if (files.empty()) {
+        printError("No input files found for batch"sv);
+        return false;
+    }
+
+    // A single pool and cache are shared by every file, each file is driven from its own thread so that waiting on
+    // one file's jobs never blocks a pool thread
+    BS::thread_pool pool;
+    TextureCache cache(cacheSize);
+    atomic<size_t> nextFile = 0;
+    atomic<size_t> failed = 0;
+    vector<vector<string>> removedFiles(files.size());
+    auto runFiles = [&]() {
+        for (size_t i = nextFile++; i < files.size(); i = nextFile++) {
+            printInfo("Optimising batch file "s + to_string(i + 1) + " of " + to_string(files.size()) + ": " +
+                files[i].first);
+            Optimiser optimiser(options, pool, cache);
+            optimiser.deferFileRemoval(removedFiles[i]);
+            if (!optimiser.pass(files[i].first, files[i].second)) {
+                printError("Failed optimising batch file: "s + files[i].first);
+                ++failed;
+            }
+        }
+    };
+    vector<thread> drivers;
+    const size_t driverCount = std::clamp<size_t>(jobs, 1, files.size());
+    for (size_t i = 1; i < driverCount; ++i) {
+        drivers.emplace_back(runFiles);
+    }
+    runFiles();
+    for (auto& driver : drivers) {
+        driver.join();
+    }
+
+    // Source textures may be shared between files so they are only removed once the whole batch has completed, a
+    // failed file still references its sources so nothing is removed if any file failed
+    vector<string> removed;
+    for (auto& list : removedFiles) {
+        removed.insert(removed.end(), list.begin(), list.end());
+    }
+    ranges::sort(removed);
+    removed.erase(ranges::unique(removed).begin(), removed.end());
+    if (failed > 0 && !removed.empty()) {
+        printWarning("Keeping "s + to_string(removed.size()) + " old textures as not all batch files succeeded");
+    } else {
+        for (auto& file : removed) {
+            printInfo("Removing old texture: "s + file);
+            remove(file.c_str());
+        }
+    }
+    printInfo("Optimised "s + to_string(files.size() - failed) + " of " + to_string(files.size()) + " batch files");
+    return failed == 0;
+}
@@ -0,0 +1,42 @@
+/**
+ * Copyright Matthew Oliver
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#pragma once
+
+#include "Optimiser.h"
+
+#include <string>
+#include <utility>
+#include <vector>
+
+/**
+ * Find the input files for a batch.
+ * @param batch Either a text file listing one input file per line or a folder path ending with a wildcard file name
+ *  such as *.gltf, where '*' matches any number of characters and '?' matches a single character.
+ * @return The list of found files, empty if none were found.
+ */
+std::vector<std::string> findBatchFiles(const std::string& batch) noexcept;
+
+/**
+ * Optimise multiple files in a single process. All files share one thread pool and texture cache so that jobs from
+ * different files run together and textures used by several files are only encoded once.
+ * @param options   Optimiser options used for every file.
+ * @param files     Pairs of input and output files.
+ * @param jobs      Number of files that are processed at the same time.
+ * @param cacheSize Maximum size in bytes of the shared texture cache, 0 for no limit.
+ * @return True if all files were optimised, false if any failed.
+ */
+[[nodiscard]] bool optimiseBatch(const Optimiser::Options& options,
+    const std::vector<std::pair<std::string, std::string>>& files, uint32_t jobs, size_t cacheSize) noexcept;
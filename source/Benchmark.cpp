@@ -0,0 +1,157 @@
+/**
+ * Copyright Matthew Oliver
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "Benchmark.h"
+
+#include "GLTFWriter.h"
+#include "Shared.h"
+#include "SharedCGLTF.h"
+
+#include <cgltf.h>
+#include <cgltf_write.h>
+#include <chrono>
+#include <cstdio>
+#include <filesystem>
+#include <functional>
+#include <memory>
+#include <sstream>
+
+#ifndef _WIN32
+#    include <sys/resource.h>
+#    include <sys/wait.h>
+#    include <unistd.h>
+#endif
+
+using namespace std;
+
+#ifndef _WIN32
+namespace {
+struct WriterResult
+{
+    bool succeeded = false;
+    double seconds = 0.0;
+    long startRSS = 0; /**< Peak resident memory in KiB when the writer started */
+    long peakRSS = 0;  /**< Peak resident memory in KiB once the writer completed */
+    uintmax_t outputSize = 0;
+};
+
+long getPeakRSS() noexcept
+{
+    rusage usage = {};
+    getrusage(RUSAGE_SELF, &usage);
+#    ifdef __APPLE__
+    // Reported in bytes instead of KiB
+    return usage.ru_maxrss / 1024;
+#    else
+    return usage.ru_maxrss;
+#    endif
+}
+
+bool measureWriter(const function<bool(const string&)>& writer, const string& outputFile, WriterResult& result) noexcept
+{
+    int results[2];
+    if (pipe(results) != 0) {
+        printError("Failed to create pipe for benchmark"sv);
+        return false;
+    }
+    const pid_t child = fork();
+    if (child < 0) {
+        printError("Failed to start benchmark process"sv);
+        close(results[0]);
+        close(results[1]);
+        return false;
+    }
+    if (child == 0) {
+        // The child starts with the parent's current memory use, which already includes the parsed input
+        close(results[0]);
+        WriterResult measured;
+        measured.startRSS = getPeakRSS();
+        const auto start = chrono::steady_clock::now();
+        measured.succeeded = writer(outputFile);
+        measured.seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+        measured.peakRSS = getPeakRSS();
+        error_code ec;
+        measured.outputSize = filesystem::file_size(outputFile, ec);
+        const bool sent = ::write(results[1], &measured, sizeof(measured)) == sizeof(measured);
+        _exit(sent ? 0 : 1);
+    }
+    close(results[1]);
+    const bool received = ::read(results[0], &result, sizeof(result)) == sizeof(result);
+    close(results[0]);
+    int status = 0;
+    waitpid(child, &status, 0);
+    remove(outputFile.c_str());
+    return received && result.succeeded;
+}
+
+string getResultText(const string_view& name, const WriterResult& result) noexcept
+{
+    ostringstream text;
+    text.setf(ios::fixed);
+    text.precision(1);
+    text << name << ": " << result.seconds * 1000.0 << " ms, peak RSS " << result.peakRSS / 1024.0 << " MiB (+"
+         << (result.peakRSS - result.startRSS) / 1024.0 << " MiB while writing), output " << result.outputSize
+         << " bytes";
+    return text.str();
+}
+} // namespace
+
+bool runWriterBenchmark(const string& inputFile) noexcept
+{
+    printInfo("Benchmarking gltf writers with: "s + inputFile);
+    cgltf_options options = {};
+    cgltf_result parseResult = cgltf_result_success;
+    const auto data = shared_ptr<cgltf_data>(
+        [&]() {
+            cgltf_data* parsed = nullptr;
+            parseResult = cgltf_parse_file(&options, inputFile.c_str(), &parsed);
+            return parsed;
+        }(),
+        [](auto p) { cgltf_free(p); });
+    if (parseResult != cgltf_result_success) {
+        printError("Failed to parse input file: "s + getCGLTFError(parseResult, data));
+        return false;
+    }
+
+    // Outputs are written to the temporary folder and removed once measured
+    error_code ec;
+    const string outputFile =
+        (filesystem::temp_directory_path(ec) / ("gltfoptimiser_benchmark_"s + to_string(getpid()) + ".gltf"))
+            .string();
+    WriterResult streamed, cgltf;
+    const bool streamedWritten = measureWriter(
+        [&](const string& file) { return GLTFWriter(*data).writeGLTF(file); }, outputFile, streamed);
+    const bool cgltfWritten = measureWriter(
+        [&](const string& file) {
+            cgltf_options writeOptions = {};
+            return cgltf_write_file(&writeOptions, file.c_str(), data.get()) == cgltf_result_success;
+        },
+        outputFile, cgltf);
+    if (!streamedWritten || !cgltfWritten) {
+        printError("Failed writing benchmark output: "s + outputFile);
+        return false;
+    }
+    printInfo(getResultText("GLTFWriter"sv, streamed));
+    printInfo(getResultText("cgltf_write_file"sv, cgltf));
+    return true;
+}
+#else
+bool runWriterBenchmark(const string&) noexcept
+{
+    printError("Writer benchmark is not supported on this platform"sv);
+    return false;
+}
+#endif
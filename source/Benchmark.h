@@ -0,0 +1,26 @@
+/**
+ * Copyright Matthew Oliver
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#pragma once
+
+#include <string>
+
+/**
+ * Compare writing the JSON of a gltf file using the streaming GLTFWriter against cgltf_write_file. Each writer runs in
+ * a separate child process so that the reported peak resident memory of one is not hidden by the other.
+ * @param inputFile The gltf or glb file to write, only its JSON is written.
+ * @return True if both writers succeeded, false if either failed.
+ */
+[[nodiscard]] bool runWriterBenchmark(const std::string& inputFile) noexcept;
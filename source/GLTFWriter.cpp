@@ -0,0 +1,1215 @@
+/**
+ * Copyright Matthew Oliver
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "GLTFWriter.h"
+
+#include "Shared.h"
+
+#include <array>
+#include <charconv>
+#include <cstring>
+#include <limits>
+
+using namespace std;
+
+namespace {
+// Output is flushed to disk whenever this much JSON has been generated
+constexpr size_t chunkSize = 1024 * 1024;
+
+constexpr uint32_t glbMagic = 0x46546C67;
+constexpr uint32_t glbVersion = 2;
+constexpr uint32_t glbHeaderSize = 12;
+constexpr uint32_t glbChunkHeaderSize = 8;
+constexpr uint32_t glbChunkJSON = 0x4E4F534A;
+constexpr uint32_t glbChunkBIN = 0x004E4942;
+
+// Known extensions in the same order as cgltf writes them
+constexpr array<string_view, 16> extensionNames = {"KHR_texture_transform", "KHR_materials_unlit",
+    "KHR_materials_pbrSpecularGlossiness", "KHR_lights_punctual", "KHR_draco_mesh_compression",
+    "KHR_materials_clearcoat", "KHR_materials_ior", "KHR_materials_specular", "KHR_materials_transmission",
+    "KHR_materials_sheen", "KHR_materials_variants", "KHR_materials_volume", "KHR_texture_basisu",
+    "KHR_materials_emissive_strength", "EXT_mesh_gpu_instancing", "KHR_materials_iridescence"};
+
+enum ExtensionFlag : uint32_t
+{
+    textureTransform = 1 << 0,
+    materialsUnlit = 1 << 1,
+    specularGlossiness = 1 << 2,
+    lightsPunctual = 1 << 3,
+    dracoMeshCompression = 1 << 4,
+    materialsClearcoat = 1 << 5,
+    materialsIOR = 1 << 6,
+    materialsSpecular = 1 << 7,
+    materialsTransmission = 1 << 8,
+    materialsSheen = 1 << 9,
+    materialsVariants = 1 << 10,
+    materialsVolume = 1 << 11,
+    textureBasisu = 1 << 12,
+    materialsEmissiveStrength = 1 << 13,
+    meshGPUInstancing = 1 << 14,
+    materialsIridescence = 1 << 15,
+};
+
+bool isToolExtension(const char* name) noexcept
+{
+    return name != nullptr && string_view(name).starts_with(toolExtensionPrefix);
+}
+
+bool hasToolExtension(const cgltf_extension* extensions, cgltf_size count) noexcept
+{
+    for (cgltf_size i = 0; i < count; ++i) {
+        if (isToolExtension(extensions[i].name)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+bool checkFloatArray(const cgltf_float* values, cgltf_size count, cgltf_float defaultValue) noexcept
+{
+    for (cgltf_size i = 0; i < count; ++i) {
+        if (values[i] != defaultValue) {
+            return true;
+        }
+    }
+    return false;
+}
+
+int getComponentType(cgltf_component_type type) noexcept
+{
+    switch (type) {
+        case cgltf_component_type_r_8:
+            return 5120;
+        case cgltf_component_type_r_8u:
+            return 5121;
+        case cgltf_component_type_r_16:
+            return 5122;
+        case cgltf_component_type_r_16u:
+            return 5123;
+        case cgltf_component_type_r_32u:
+            return 5125;
+        case cgltf_component_type_r_32f:
+            return 5126;
+        default:
+            return 0;
+    }
+}
+
+const char* getTypeName(cgltf_type type) noexcept
+{
+    constexpr const char* names[] = {nullptr, "SCALAR", "VEC2", "VEC3", "VEC4", "MAT2", "MAT3", "MAT4"};
+    return (type < cgltf_type_max_enum) ? names[type] : nullptr;
+}
+
+const char* getAlphaModeName(cgltf_alpha_mode mode) noexcept
+{
+    return (mode == cgltf_alpha_mode_mask) ? "MASK" : (mode == cgltf_alpha_mode_blend) ? "BLEND" : nullptr;
+}
+
+const char* getInterpolationName(cgltf_interpolation_type type) noexcept
+{
+    constexpr const char* names[] = {"LINEAR", "STEP", "CUBICSPLINE"};
+    return (type < cgltf_interpolation_type_max_enum) ? names[type] : nullptr;
+}
+
+const char* getPathName(cgltf_animation_path_type type) noexcept
+{
+    constexpr const char* names[] = {nullptr, "translation", "rotation", "scale", "weights"};
+    return (type < cgltf_animation_path_type_max_enum) ? names[type] : nullptr;
+}
+} // namespace
+
+GLTFWriter::GLTFWriter(const cgltf_data& gltfData) noexcept
+    : data(gltfData)
+{}
+
+bool GLTFWriter::writeGLTF(const std::string& fileName) noexcept
+{
+    file.open(fileName, ios::binary);
+    if (!file.is_open()) {
+        printError("Failed to open output file: "s + fileName);
+        return false;
+    }
+    buffer.reserve(chunkSize);
+    writeDocument();
+    flush();
+    file.close();
+    if (file.fail()) {
+        printError("Failed writing output file: "s + fileName);
+        return false;
+    }
+    return true;
+}
+
+bool GLTFWriter::writeGLTF(std::vector<uint8_t>& output) noexcept
+{
+    memory = &output;
+    memory->clear();
+    buffer.reserve(chunkSize);
+    writeDocument();
+    flush();
+    memory = nullptr;
+    return true;
+}
+
+bool GLTFWriter::writeGLB(const std::string& fileName, const std::vector<std::span<const uint8_t>>& binary) noexcept
+{
+    file.open(fileName, ios::binary);
+    if (!file.is_open()) {
+        printError("Failed to open output file: "s + fileName);
+        return false;
+    }
+    if (!writeGLBChunks(binary)) {
+        printError("Output file exceeds maximum glb file size: "s + fileName);
+        return false;
+    }
+
+    // Patch in the final lengths
+    const array<uint32_t, 2> lengths = {static_cast<uint32_t>(outputSize), static_cast<uint32_t>(jsonSize)};
+    file.seekp(8);
+    file.write(reinterpret_cast<const char*>(lengths.data()), sizeof(lengths));
+    file.close();
+    if (file.fail()) {
+        printError("Failed writing output file: "s + fileName);
+        return false;
+    }
+    return true;
+}
+
+bool GLTFWriter::writeGLB(std::vector<uint8_t>& output, const std::vector<std::span<const uint8_t>>& binary) noexcept
+{
+    memory = &output;
+    memory->clear();
+    const bool written = writeGLBChunks(binary);
+    memory = nullptr;
+    if (!written) {
+        printError("Output exceeds maximum glb file size"sv);
+        return false;
+    }
+    const array<uint32_t, 2> lengths = {static_cast<uint32_t>(outputSize), static_cast<uint32_t>(jsonSize)};
+    memcpy(output.data() + 8, lengths.data(), sizeof(lengths));
+    return true;
+}
+
+bool GLTFWriter::writeGLBChunks(const std::vector<std::span<const uint8_t>>& binary) noexcept
+{
+    buffer.reserve(chunkSize);
+    if (memory != nullptr) {
+        size_t binarySize = 0;
+        for (auto& i : binary) {
+            binarySize += i.size() + 3;
+        }
+        memory->reserve(binarySize + chunkSize);
+    }
+
+    // Lengths in the file and JSON chunk headers are not known until the JSON has been written so are patched later
+    const array<uint32_t, 5> header = {glbMagic, glbVersion, 0, 0, glbChunkJSON};
+    write(string_view(reinterpret_cast<const char*>(header.data()), sizeof(header)));
+    writeDocument();
+    jsonSize = (outputSize - glbHeaderSize - glbChunkHeaderSize + 3) & ~size_t(3);
+    while (outputSize < glbHeaderSize + glbChunkHeaderSize + jsonSize) {
+        write(" ");
+    }
+
+    // Binary data is written straight from its source memory
+    size_t binarySize = 0;
+    for (auto& i : binary) {
+        binarySize = ((binarySize + 3) & ~size_t(3)) + i.size();
+    }
+    binarySize = (binarySize + 3) & ~size_t(3);
+    if (binarySize > 0) {
+        const array<uint32_t, 2> chunkHeader = {static_cast<uint32_t>(binarySize), glbChunkBIN};
+        write(string_view(reinterpret_cast<const char*>(chunkHeader.data()), sizeof(chunkHeader)));
+        const size_t binaryStart = outputSize;
+        for (auto& i : binary) {
+            while (((outputSize - binaryStart) & 3) != 0) {
+                write(string_view("\0", 1));
+            }
+            write(string_view(reinterpret_cast<const char*>(i.data()), i.size()));
+        }
+        while (((outputSize - binaryStart) & 3) != 0) {
+            write(string_view("\0", 1));
+        }
+    }
+    flush();
+    return outputSize <= numeric_limits<uint32_t>::max();
+}
+
+void GLTFWriter::writeDocument() noexcept
+{
+    depth = 1;
+    needsComma = false;
+    extensionFlags = 0;
+    requiredExtensionFlags = 0;
+
+    write("{");
+    if (data.accessors_count > 0) {
+        writeLine("\"accessors\": [");
+        for (cgltf_size i = 0; i < data.accessors_count; ++i) {
+            writeAccessor(data.accessors[i]);
+        }
+        writeLine("]");
+    }
+
+    writeLine("\"asset\": {");
+    writeStringProperty("copyright", data.asset.copyright);
+    writeStringProperty("generator", data.asset.generator);
+    writeStringProperty("version", data.asset.version);
+    writeStringProperty("minVersion", data.asset.min_version);
+    writeExtras(data.asset.extras);
+    writeLine("}");
+
+    if (data.buffer_views_count > 0) {
+        writeLine("\"bufferViews\": [");
+        for (cgltf_size i = 0; i < data.buffer_views_count; ++i) {
+            writeBufferView(data.buffer_views[i]);
+        }
+        writeLine("]");
+    }
+    if (data.buffers_count > 0) {
+        writeLine("\"buffers\": [");
+        for (cgltf_size i = 0; i < data.buffers_count; ++i) {
+            writeBuffer(data.buffers[i]);
+        }
+        writeLine("]");
+    }
+    if (data.images_count > 0) {
+        writeLine("\"images\": [");
+        for (cgltf_size i = 0; i < data.images_count; ++i) {
+            writeImage(data.images[i]);
+        }
+        writeLine("]");
+    }
+    if (data.meshes_count > 0) {
+        writeLine("\"meshes\": [");
+        for (cgltf_size i = 0; i < data.meshes_count; ++i) {
+            writeMesh(data.meshes[i]);
+        }
+        writeLine("]");
+    }
+    if (data.materials_count > 0) {
+        writeLine("\"materials\": [");
+        for (cgltf_size i = 0; i < data.materials_count; ++i) {
+            writeMaterial(data.materials[i]);
+        }
+        writeLine("]");
+    }
+    if (data.nodes_count > 0) {
+        writeLine("\"nodes\": [");
+        for (cgltf_size i = 0; i < data.nodes_count; ++i) {
+            writeNode(data.nodes[i]);
+        }
+        writeLine("]");
+    }
+    if (data.samplers_count > 0) {
+        writeLine("\"samplers\": [");
+        for (cgltf_size i = 0; i < data.samplers_count; ++i) {
+            writeSampler(data.samplers[i]);
+        }
+        writeLine("]");
+    }
+    if (data.scene != nullptr) {
+        writeIntProperty("scene", data.scene - data.scenes, -1);
+    }
+    if (data.scenes_count > 0) {
+        writeLine("\"scenes\": [");
+        for (cgltf_size i = 0; i < data.scenes_count; ++i) {
+            writeScene(data.scenes[i]);
+        }
+        writeLine("]");
+    }
+    if (data.textures_count > 0) {
+        writeLine("\"textures\": [");
+        for (cgltf_size i = 0; i < data.textures_count; ++i) {
+            writeTexture(data.textures[i]);
+        }
+        writeLine("]");
+    }
+    if (data.skins_count > 0) {
+        writeLine("\"skins\": [");
+        for (cgltf_size i = 0; i < data.skins_count; ++i) {
+            writeSkin(data.skins[i]);
+        }
+        writeLine("]");
+    }
+    if (data.animations_count > 0) {
+        writeLine("\"animations\": [");
+        for (cgltf_size i = 0; i < data.animations_count; ++i) {
+            writeAnimation(data.animations[i]);
+        }
+        writeLine("]");
+    }
+    if (data.cameras_count > 0) {
+        writeLine("\"cameras\": [");
+        for (cgltf_size i = 0; i < data.cameras_count; ++i) {
+            writeCamera(data.cameras[i]);
+        }
+        writeLine("]");
+    }
+    if (data.lights_count > 0 || data.variants_count > 0 ||
+        hasToolExtension(data.data_extensions, data.data_extensions_count)) {
+        writeLine("\"extensions\": {");
+        if (data.lights_count > 0) {
+            writeLine("\"KHR_lights_punctual\": {");
+            writeLine("\"lights\": [");
+            for (cgltf_size i = 0; i < data.lights_count; ++i) {
+                writeLight(data.lights[i]);
+            }
+            writeLine("]");
+            writeLine("}");
+        }
+        if (data.variants_count > 0) {
+            extensionFlags |= materialsVariants;
+            writeLine("\"KHR_materials_variants\": {");
+            writeLine("\"variants\": [");
+            for (cgltf_size i = 0; i < data.variants_count; ++i) {
+                writeLine("{");
+                writeStringProperty("name", data.variants[i].name);
+                writeExtras(data.variants[i].extras);
+                writeLine("}");
+            }
+            writeLine("]");
+            writeLine("}");
+        }
+        writeToolExtensions(data.data_extensions, data.data_extensions_count);
+        writeLine("}");
+    }
+
+    // Only the extensions that were actually written are listed, along with any created by this tool
+    bool toolExtensions = false;
+    for (cgltf_size i = 0; i < data.extensions_used_count; ++i) {
+        toolExtensions = toolExtensions || isToolExtension(data.extensions_used[i]);
+    }
+    if (extensionFlags != 0 || toolExtensions) {
+        writeLine("\"extensionsUsed\": [");
+        writeExtensionNames(extensionFlags, data.extensions_used, data.extensions_used_count);
+        writeLine("]");
+    }
+    toolExtensions = false;
+    for (cgltf_size i = 0; i < data.extensions_required_count; ++i) {
+        toolExtensions = toolExtensions || isToolExtension(data.extensions_required[i]);
+    }
+    if (requiredExtensionFlags != 0 || toolExtensions) {
+        writeLine("\"extensionsRequired\": [");
+        writeExtensionNames(requiredExtensionFlags, data.extensions_required, data.extensions_required_count);
+        writeLine("]");
+    }
+    writeExtras(data.extras);
+    write("\n}\n");
+}
+
+void GLTFWriter::write(const std::string_view& text) noexcept
+{
+    outputSize += text.size();
+    if (buffer.size() + text.size() > chunkSize) {
+        flush();
+        // Large blocks are written directly instead of being copied through the buffer
+        if (text.size() >= chunkSize) {
+            writeOutput(text.data(), text.size());
+            return;
+        }
+    }
+    buffer.insert(buffer.end(), text.begin(), text.end());
+}
+
+void GLTFWriter::writeString(const char* text) noexcept
+{
+    write("\"");
+    for (const char* c = text; *c != '\0'; ++c) {
+        switch (*c) {
+            case '"':
+                write("\\\"");
+                break;
+            case '\\':
+                write("\\\\");
+                break;
+            case '\n':
+                write("\\n");
+                break;
+            case '\r':
+                write("\\r");
+                break;
+            case '\t':
+                write("\\t");
+                break;
+            default:
+                if (static_cast<unsigned char>(*c) < 0x20) {
+                    constexpr char hex[] = "0123456789abcdef";
+                    const char escaped[] = {'\\', 'u', '0', '0', hex[(*c >> 4) & 0xF], hex[*c & 0xF]};
+                    write(string_view(escaped, sizeof(escaped)));
+                } else {
+                    write(string_view(c, 1));
+                }
+        }
+    }
+    write("\"");
+}
+
+void GLTFWriter::writeFloat(cgltf_float value) noexcept
+{
+    // Matches the "%.9g" formatting used by cgltf but is independent of the current locale
+    char text[32];
+    const auto result = to_chars(text, text + sizeof(text), static_cast<double>(value), chars_format::general, 9);
+    write(string_view(text, result.ptr - text));
+}
+
+void GLTFWriter::writeIndent() noexcept
+{
+    write(needsComma ? ",\n" : "\n");
+    needsComma = false;
+    for (int i = 0; i < depth; ++i) {
+        write("  ");
+    }
+}
+
+void GLTFWriter::writeLine(const std::string_view& line) noexcept
+{
+    const bool closing = line.front() == ']' || line.front() == '}';
+    if (closing) {
+        --depth;
+        needsComma = false;
+    }
+    writeIndent();
+    write(line);
+    if (closing) {
+        needsComma = true;
+    }
+    if (line.back() == '[' || line.back() == '{') {
+        ++depth;
+        needsComma = false;
+    }
+}
+
+void GLTFWriter::writeStringProperty(const char* label, const char* value) noexcept
+{
+    if (value != nullptr) {
+        writeIndent();
+        write("\""s + label + "\": ");
+        writeString(value);
+        needsComma = true;
+    }
+}
+
+void GLTFWriter::writeIntProperty(const char* label, int64_t value, int64_t defaultValue) noexcept
+{
+    if (value != defaultValue) {
+        writeIndent();
+        write("\""s + label + "\": " + to_string(value));
+        needsComma = true;
+    }
+}
+
+void GLTFWriter::writeFloatProperty(const char* label, cgltf_float value, cgltf_float defaultValue) noexcept
+{
+    if (value != defaultValue) {
+        writeIndent();
+        write("\""s + label + "\": ");
+        writeFloat(value);
+        needsComma = true;
+    }
+}
+
+void GLTFWriter::writeBoolProperty(const char* label, bool value, bool defaultValue) noexcept
+{
+    if (value != defaultValue) {
+        writeIndent();
+        write("\""s + label + "\": " + (value ? "true" : "false"));
+        needsComma = true;
+    }
+}
+
+void GLTFWriter::writeFloatArrayProperty(const char* label, const cgltf_float* values, cgltf_size count) noexcept
+{
+    writeIndent();
+    write("\""s + label + "\": [");
+    for (cgltf_size i = 0; i < count; ++i) {
+        if (i != 0) {
+            write(", ");
+        }
+        writeFloat(values[i]);
+    }
+    write("]");
+    needsComma = true;
+}
+
+template<typename T>
+void GLTFWriter::writeIndexProperty(const char* label, const T* value, const T* start) noexcept
+{
+    if (value != nullptr) {
+        writeIndent();
+        write("\""s + label + "\": " + to_string(value - start));
+        needsComma = true;
+    }
+}
+
+template<typename T>
+void GLTFWriter::writeIndexArrayProperty(const char* label, T* const* values, cgltf_size count, const T* start) noexcept
+{
+    if (values != nullptr) {
+        writeIndent();
+        write("\""s + label + "\": [");
+        for (cgltf_size i = 0; i < count; ++i) {
+            write(((i != 0) ? ", "s : " "s) + to_string(values[i] - start));
+        }
+        write(" ]");
+        needsComma = true;
+    }
+}
+
+void GLTFWriter::writeExtras(const cgltf_extras& extras) noexcept
+{
+    // Extras are copied verbatim from the input JSON
+    if (extras.end_offset > extras.start_offset && data.json != nullptr) {
+        writeIndent();
+        write("\"extras\": ");
+        write(string_view(data.json + extras.start_offset, extras.end_offset - extras.start_offset));
+        needsComma = true;
+    }
+}
+
+void GLTFWriter::writeToolExtensions(const cgltf_extension* extensions, cgltf_size count) noexcept
+{
+    // Other unknown extensions are dropped as cgltf does, as any indices they contain may no longer be valid
+    for (cgltf_size i = 0; i < count; ++i) {
+        if (isToolExtension(extensions[i].name)) {
+            writeIndent();
+            writeString(extensions[i].name);
+            write(": ");
+            write(extensions[i].data != nullptr ? extensions[i].data : "{}");
+            needsComma = true;
+        }
+    }
+}
+
+void GLTFWriter::writeExtensionNames(uint32_t flags, char* const* names, cgltf_size count) noexcept
+{
+    for (cgltf_size i = 0; i < extensionNames.size(); ++i) {
+        if ((flags & (1u << i)) != 0) {
+            writeIndent();
+            write("\""s + string(extensionNames[i]) + "\"");
+            needsComma = true;
+        }
+    }
+    for (cgltf_size i = 0; i < count; ++i) {
+        if (isToolExtension(names[i])) {
+            writeIndent();
+            writeString(names[i]);
+            needsComma = true;
+        }
+    }
+}
+
+void GLTFWriter::writeTextureView(const char* label, const cgltf_texture_view& view, const char* scaleLabel) noexcept
+{
+    if (view.texture == nullptr) {
+        return;
+    }
+    writeLine("\""s + label + "\": {");
+    writeIndexProperty("index", view.texture, data.textures);
+    writeIntProperty("texCoord", view.texcoord, 0);
+    if (scaleLabel != nullptr) {
+        writeFloatProperty(scaleLabel, view.scale, 1.0f);
+    }
+    if (view.has_transform || hasToolExtension(view.extensions, view.extensions_count)) {
+        writeLine("\"extensions\": {");
+        if (view.has_transform) {
+            extensionFlags |= textureTransform;
+            const cgltf_texture_transform& transform = view.transform;
+            writeLine("\"KHR_texture_transform\": {");
+            if (checkFloatArray(transform.offset, 2, 0.0f)) {
+                writeFloatArrayProperty("offset", transform.offset, 2);
+            }
+            writeFloatProperty("rotation", transform.rotation, 0.0f);
+            if (checkFloatArray(transform.scale, 2, 1.0f)) {
+                writeFloatArrayProperty("scale", transform.scale, 2);
+            }
+            if (transform.has_texcoord) {
+                writeIntProperty("texCoord", transform.texcoord, -1);
+            }
+            writeLine("}");
+        }
+        writeToolExtensions(view.extensions, view.extensions_count);
+        writeLine("}");
+    }
+    writeExtras(view.extras);
+    writeLine("}");
+}
+
+void GLTFWriter::writeAccessor(const cgltf_accessor& accessor) noexcept
+{
+    writeLine("{");
+    writeStringProperty("name", accessor.name);
+    writeIndexProperty("bufferView", accessor.buffer_view, data.buffer_views);
+    writeIntProperty("componentType", getComponentType(accessor.component_type), 0);
+    writeStringProperty("type", getTypeName(accessor.type));
+    const cgltf_size components = cgltf_num_components(accessor.type);
+    writeBoolProperty("normalized", accessor.normalized, false);
+    writeIntProperty("byteOffset", accessor.offset, 0);
+    writeIntProperty("count", accessor.count, -1);
+    if (accessor.has_min) {
+        writeFloatArrayProperty("min", accessor.min, components);
+    }
+    if (accessor.has_max) {
+        writeFloatArrayProperty("max", accessor.max, components);
+    }
+    if (accessor.is_sparse) {
+        const cgltf_accessor_sparse& sparse = accessor.sparse;
+        writeLine("\"sparse\": {");
+        writeIntProperty("count", sparse.count, 0);
+        writeLine("\"indices\": {");
+        writeIntProperty("byteOffset", sparse.indices_byte_offset, 0);
+        writeIndexProperty("bufferView", sparse.indices_buffer_view, data.buffer_views);
+        writeIntProperty("componentType", getComponentType(sparse.indices_component_type), 0);
+        writeExtras(sparse.indices_extras);
+        writeLine("}");
+        writeLine("\"values\": {");
+        writeIntProperty("byteOffset", sparse.values_byte_offset, 0);
+        writeIndexProperty("bufferView", sparse.values_buffer_view, data.buffer_views);
+        writeExtras(sparse.values_extras);
+        writeLine("}");
+        writeExtras(sparse.extras);
+        writeLine("}");
+    }
+    if (hasToolExtension(accessor.extensions, accessor.extensions_count)) {
+        writeLine("\"extensions\": {");
+        writeToolExtensions(accessor.extensions, accessor.extensions_count);
+        writeLine("}");
+    }
+    writeExtras(accessor.extras);
+    writeLine("}");
+}
+
+void GLTFWriter::writeBufferView(const cgltf_buffer_view& view) noexcept
+{
+    writeLine("{");
+    writeStringProperty("name", view.name);
+    writeIndexProperty("buffer", view.buffer, data.buffers);
+    writeIntProperty("byteLength", view.size, -1);
+    writeIntProperty("byteOffset", view.offset, 0);
+    writeIntProperty("byteStride", view.stride, 0);
+    // The target is not written as its usage can be inferred
+    if (hasToolExtension(view.extensions, view.extensions_count)) {
+        writeLine("\"extensions\": {");
+        writeToolExtensions(view.extensions, view.extensions_count);
+        writeLine("}");
+    }
+    writeExtras(view.extras);
+    writeLine("}");
+}
+
+void GLTFWriter::writeBuffer(const cgltf_buffer& gltfBuffer) noexcept
+{
+    writeLine("{");
+    writeStringProperty("name", gltfBuffer.name);
+    writeStringProperty("uri", gltfBuffer.uri);
+    writeIntProperty("byteLength", gltfBuffer.size, -1);
+    if (hasToolExtension(gltfBuffer.extensions, gltfBuffer.extensions_count)) {
+        writeLine("\"extensions\": {");
+        writeToolExtensions(gltfBuffer.extensions, gltfBuffer.extensions_count);
+        writeLine("}");
+    }
+    writeExtras(gltfBuffer.extras);
+    writeLine("}");
+}
+
+void GLTFWriter::writeImage(const cgltf_image& image) noexcept
+{
+    writeLine("{");
+    writeStringProperty("name", image.name);
+    writeStringProperty("uri", image.uri);
+    writeIndexProperty("bufferView", image.buffer_view, data.buffer_views);
+    writeStringProperty("mimeType", image.mime_type);
+    if (hasToolExtension(image.extensions, image.extensions_count)) {
+        writeLine("\"extensions\": {");
+        writeToolExtensions(image.extensions, image.extensions_count);
+        writeLine("}");
+    }
+    writeExtras(image.extras);
+    writeLine("}");
+}
+
+void GLTFWriter::writePrimitive(const cgltf_primitive& prim) noexcept
+{
+    writeIntProperty("mode", prim.type, cgltf_primitive_type_triangles);
+    writeIndexProperty("indices", prim.indices, data.accessors);
+    writeIndexProperty("material", prim.material, data.materials);
+    writeLine("\"attributes\": {");
+    for (cgltf_size i = 0; i < prim.attributes_count; ++i) {
+        writeIndexProperty(prim.attributes[i].name, prim.attributes[i].data, data.accessors);
+    }
+    writeLine("}");
+    if (prim.targets_count > 0) {
+        writeLine("\"targets\": [");
+        for (cgltf_size t = 0; t < prim.targets_count; ++t) {
+            writeLine("{");
+            for (cgltf_size i = 0; i < prim.targets[t].attributes_count; ++i) {
+                const cgltf_attribute& attribute = prim.targets[t].attributes[i];
+                writeIndexProperty(attribute.name, attribute.data, data.accessors);
+            }
+            writeLine("}");
+        }
+        writeLine("]");
+    }
+    writeExtras(prim.extras);
+
+    if (prim.has_draco_mesh_compression || prim.mappings_count > 0 ||
+        hasToolExtension(prim.extensions, prim.extensions_count)) {
+        writeLine("\"extensions\": {");
+        if (prim.has_draco_mesh_compression) {
+            extensionFlags |= dracoMeshCompression;
+            if (prim.attributes_count == 0 || prim.indices == nullptr) {
+                requiredExtensionFlags |= dracoMeshCompression;
+            }
+            const cgltf_draco_mesh_compression& draco = prim.draco_mesh_compression;
+            writeLine("\"KHR_draco_mesh_compression\": {");
+            writeIndexProperty("bufferView", draco.buffer_view, data.buffer_views);
+            writeLine("\"attributes\": {");
+            for (cgltf_size i = 0; i < draco.attributes_count; ++i) {
+                writeIndexProperty(draco.attributes[i].name, draco.attributes[i].data, data.accessors);
+            }
+            writeLine("}");
+            writeLine("}");
+        }
+        if (prim.mappings_count > 0) {
+            extensionFlags |= materialsVariants;
+            writeLine("\"KHR_materials_variants\": {");
+            writeLine("\"mappings\": [");
+            for (cgltf_size i = 0; i < prim.mappings_count; ++i) {
+                const cgltf_material_mapping& mapping = prim.mappings[i];
+                writeLine("{");
+                writeIndexProperty("material", mapping.material, data.materials);
+                writeIndent();
+                write("\"variants\": ["s + to_string(mapping.variant) + "]");
+                needsComma = true;
+                writeExtras(mapping.extras);
+                writeLine("}");
+            }
+            writeLine("]");
+            writeLine("}");
+        }
+        writeToolExtensions(prim.extensions, prim.extensions_count);
+        writeLine("}");
+    }
+}
+
+void GLTFWriter::writeMesh(const cgltf_mesh& mesh) noexcept
+{
+    writeLine("{");
+    writeStringProperty("name", mesh.name);
+    writeLine("\"primitives\": [");
+    for (cgltf_size i = 0; i < mesh.primitives_count; ++i) {
+        writeLine("{");
+        writePrimitive(mesh.primitives[i]);
+        writeLine("}");
+    }
+    writeLine("]");
+    if (mesh.weights_count > 0) {
+        writeFloatArrayProperty("weights", mesh.weights, mesh.weights_count);
+    }
+    if (hasToolExtension(mesh.extensions, mesh.extensions_count)) {
+        writeLine("\"extensions\": {");
+        writeToolExtensions(mesh.extensions, mesh.extensions_count);
+        writeLine("}");
+    }
+    writeExtras(mesh.extras);
+    writeLine("}");
+}
+
+void GLTFWriter::writeMaterial(const cgltf_material& material) noexcept
+{
+    writeLine("{");
+    writeStringProperty("name", material.name);
+    if (material.alpha_mode == cgltf_alpha_mode_mask) {
+        writeFloatProperty("alphaCutoff", material.alpha_cutoff, 0.5f);
+    }
+    writeBoolProperty("doubleSided", material.double_sided, false);
+
+    if (material.has_pbr_metallic_roughness) {
+        const cgltf_pbr_metallic_roughness& params = material.pbr_metallic_roughness;
+        writeLine("\"pbrMetallicRoughness\": {");
+        writeTextureView("baseColorTexture", params.base_color_texture);
+        writeTextureView("metallicRoughnessTexture", params.metallic_roughness_texture);
+        writeFloatProperty("metallicFactor", params.metallic_factor, 1.0f);
+        writeFloatProperty("roughnessFactor", params.roughness_factor, 1.0f);
+        if (checkFloatArray(params.base_color_factor, 4, 1.0f)) {
+            writeFloatArrayProperty("baseColorFactor", params.base_color_factor, 4);
+        }
+        writeExtras(params.extras);
+        writeLine("}");
+    }
+
+    if (material.unlit || material.has_pbr_specular_glossiness || material.has_clearcoat || material.has_ior ||
+        material.has_specular || material.has_transmission || material.has_sheen || material.has_volume ||
+        material.has_emissive_strength || material.has_iridescence ||
+        hasToolExtension(material.extensions, material.extensions_count)) {
+        writeLine("\"extensions\": {");
+        if (material.has_clearcoat) {
+            extensionFlags |= materialsClearcoat;
+            const cgltf_clearcoat& params = material.clearcoat;
+            writeLine("\"KHR_materials_clearcoat\": {");
+            writeTextureView("clearcoatTexture", params.clearcoat_texture);
+            writeTextureView("clearcoatRoughnessTexture", params.clearcoat_roughness_texture);
+            writeTextureView("clearcoatNormalTexture", params.clearcoat_normal_texture, "scale");
+            writeFloatProperty("clearcoatFactor", params.clearcoat_factor, 0.0f);
+            writeFloatProperty("clearcoatRoughnessFactor", params.clearcoat_roughness_factor, 0.0f);
+            writeLine("}");
+        }
+        if (material.has_ior) {
+            extensionFlags |= materialsIOR;
+            writeLine("\"KHR_materials_ior\": {");
+            writeFloatProperty("ior", material.ior.ior, 1.5f);
+            writeLine("}");
+        }
+        if (material.has_specular) {
+            extensionFlags |= materialsSpecular;
+            const cgltf_specular& params = material.specular;
+            writeLine("\"KHR_materials_specular\": {");
+            writeTextureView("specularTexture", params.specular_texture);
+            writeTextureView("specularColorTexture", params.specular_color_texture);
+            writeFloatProperty("specularFactor", params.specular_factor, 1.0f);
+            if (checkFloatArray(params.specular_color_factor, 3, 1.0f)) {
+                writeFloatArrayProperty("specularColorFactor", params.specular_color_factor, 3);
+            }
+            writeLine("}");
+        }
+        if (material.has_transmission) {
+            extensionFlags |= materialsTransmission;
+            const cgltf_transmission& params = material.transmission;
+            writeLine("\"KHR_materials_transmission\": {");
+            writeTextureView("transmissionTexture", params.transmission_texture);
+            writeFloatProperty("transmissionFactor", params.transmission_factor, 0.0f);
+            writeLine("}");
+        }
+        if (material.has_volume) {
+            extensionFlags |= materialsVolume;
+            const cgltf_volume& params = material.volume;
+            writeLine("\"KHR_materials_volume\": {");
+            writeTextureView("thicknessTexture", params.thickness_texture);
+            writeFloatProperty("thicknessFactor", params.thickness_factor, 0.0f);
+            if (checkFloatArray(params.attenuation_color, 3, 1.0f)) {
+                writeFloatArrayProperty("attenuationColor", params.attenuation_color, 3);
+            }
+            writeFloatProperty("attenuationDistance", params.attenuation_distance, numeric_limits<cgltf_float>::max());
+            writeLine("}");
+        }
+        if (material.has_sheen) {
+            extensionFlags |= materialsSheen;
+            const cgltf_sheen& params = material.sheen;
+            writeLine("\"KHR_materials_sheen\": {");
+            writeTextureView("sheenColorTexture", params.sheen_color_texture);
+            writeTextureView("sheenRoughnessTexture", params.sheen_roughness_texture);
+            if (checkFloatArray(params.sheen_color_factor, 3, 0.0f)) {
+                writeFloatArrayProperty("sheenColorFactor", params.sheen_color_factor, 3);
+            }
+            writeFloatProperty("sheenRoughnessFactor", params.sheen_roughness_factor, 0.0f);
+            writeLine("}");
+        }
+        if (material.has_pbr_specular_glossiness) {
+            extensionFlags |= specularGlossiness;
+            const cgltf_pbr_specular_glossiness& params = material.pbr_specular_glossiness;
+            writeLine("\"KHR_materials_pbrSpecularGlossiness\": {");
+            writeTextureView("diffuseTexture", params.diffuse_texture);
+            writeTextureView("specularGlossinessTexture", params.specular_glossiness_texture);
+            if (checkFloatArray(params.diffuse_factor, 4, 1.0f)) {
+                writeFloatArrayProperty("diffuseFactor", params.diffuse_factor, 4);
+            }
+            if (checkFloatArray(params.specular_factor, 3, 1.0f)) {
+                writeFloatArrayProperty("specularFactor", params.specular_factor, 3);
+            }
+            writeFloatProperty("glossinessFactor", params.glossiness_factor, 1.0f);
+            writeLine("}");
+        }
+        if (material.unlit) {
+            extensionFlags |= materialsUnlit;
+            writeLine("\"KHR_materials_unlit\": {");
+            writeLine("}");
+        }
+        if (material.has_emissive_strength) {
+            extensionFlags |= materialsEmissiveStrength;
+            writeLine("\"KHR_materials_emissive_strength\": {");
+            writeFloatProperty("emissiveStrength", material.emissive_strength.emissive_strength, 1.0f);
+            writeLine("}");
+        }
+        if (material.has_iridescence) {
+            extensionFlags |= materialsIridescence;
+            const cgltf_iridescence& params = material.iridescence;
+            writeLine("\"KHR_materials_iridescence\": {");
+            writeFloatProperty("iridescenceFactor", params.iridescence_factor, 0.0f);
+            writeTextureView("iridescenceTexture", params.iridescence_texture);
+            writeFloatProperty("iridescenceIor", params.iridescence_ior, 1.3f);
+            writeFloatProperty("iridescenceThicknessMinimum", params.iridescence_thickness_min, 100.0f);
+            writeFloatProperty("iridescenceThicknessMaximum", params.iridescence_thickness_max, 400.0f);
+            writeTextureView("iridescenceThicknessTexture", params.iridescence_thickness_texture);
+            writeLine("}");
+        }
+        writeToolExtensions(material.extensions, material.extensions_count);
+        writeLine("}");
+    }
+
+    writeTextureView("normalTexture", material.normal_texture, "scale");
+    writeTextureView("occlusionTexture", material.occlusion_texture, "strength");
+    writeTextureView("emissiveTexture", material.emissive_texture);
+    if (checkFloatArray(material.emissive_factor, 3, 0.0f)) {
+        writeFloatArrayProperty("emissiveFactor", material.emissive_factor, 3);
+    }
+    writeStringProperty("alphaMode", getAlphaModeName(material.alpha_mode));
+    writeExtras(material.extras);
+    writeLine("}");
+}
+
+void GLTFWriter::writeNode(const cgltf_node& node) noexcept
+{
+    writeLine("{");
+    writeIndexArrayProperty("children", node.children, node.children_count, data.nodes);
+    writeIndexProperty("mesh", node.mesh, data.meshes);
+    writeStringProperty("name", node.name);
+    if (node.has_matrix) {
+        writeFloatArrayProperty("matrix", node.matrix, 16);
+    }
+    if (node.has_translation) {
+        writeFloatArrayProperty("translation", node.translation, 3);
+    }
+    if (node.has_rotation) {
+        writeFloatArrayProperty("rotation", node.rotation, 4);
+    }
+    if (node.has_scale) {
+        writeFloatArrayProperty("scale", node.scale, 3);
+    }
+    writeIndexProperty("skin", node.skin, data.skins);
+
+    const bool instancing = node.has_mesh_gpu_instancing && node.mesh_gpu_instancing.attributes_count > 0;
+    if (node.light != nullptr || instancing || hasToolExtension(node.extensions, node.extensions_count)) {
+        writeLine("\"extensions\": {");
+        if (node.light != nullptr) {
+            extensionFlags |= lightsPunctual;
+            writeLine("\"KHR_lights_punctual\": {");
+            writeIndexProperty("light", node.light, data.lights);
+            writeLine("}");
+        }
+        if (instancing) {
+            extensionFlags |= meshGPUInstancing;
+            requiredExtensionFlags |= meshGPUInstancing;
+            writeLine("\"EXT_mesh_gpu_instancing\": {");
+            writeIndexProperty("bufferView", node.mesh_gpu_instancing.buffer_view, data.buffer_views);
+            writeLine("\"attributes\": {");
+            for (cgltf_size i = 0; i < node.mesh_gpu_instancing.attributes_count; ++i) {
+                const cgltf_attribute& attribute = node.mesh_gpu_instancing.attributes[i];
+                writeIndexProperty(attribute.name, attribute.data, data.accessors);
+            }
+            writeLine("}");
+            writeLine("}");
+        }
+        writeToolExtensions(node.extensions, node.extensions_count);
+        writeLine("}");
+    }
+    if (node.weights_count > 0) {
+        writeFloatArrayProperty("weights", node.weights, node.weights_count);
+    }
+    writeIndexProperty("camera", node.camera, data.cameras);
+    writeExtras(node.extras);
+    writeLine("}");
+}
+
+void GLTFWriter::writeSampler(const cgltf_sampler& sampler) noexcept
+{
+    writeLine("{");
+    writeStringProperty("name", sampler.name);
+    writeIntProperty("magFilter", sampler.mag_filter, 0);
+    writeIntProperty("minFilter", sampler.min_filter, 0);
+    writeIntProperty("wrapS", sampler.wrap_s, 10497);
+    writeIntProperty("wrapT", sampler.wrap_t, 10497);
+    if (hasToolExtension(sampler.extensions, sampler.extensions_count)) {
+        writeLine("\"extensions\": {");
+        writeToolExtensions(sampler.extensions, sampler.extensions_count);
+        writeLine("}");
+    }
+    writeExtras(sampler.extras);
+    writeLine("}");
+}
+
+void GLTFWriter::writeScene(const cgltf_scene& scene) noexcept
+{
+    writeLine("{");
+    writeStringProperty("name", scene.name);
+    writeIndexArrayProperty("nodes", scene.nodes, scene.nodes_count, data.nodes);
+    if (hasToolExtension(scene.extensions, scene.extensions_count)) {
+        writeLine("\"extensions\": {");
+        writeToolExtensions(scene.extensions, scene.extensions_count);
+        writeLine("}");
+    }
+    writeExtras(scene.extras);
+    writeLine("}");
+}
+
+void GLTFWriter::writeTexture(const cgltf_texture& texture) noexcept
+{
+    writeLine("{");
+    writeStringProperty("name", texture.name);
+    writeIndexProperty("source", texture.image, data.images);
+    writeIndexProperty("sampler", texture.sampler, data.samplers);
+    if (texture.has_basisu || hasToolExtension(texture.extensions, texture.extensions_count)) {
+        writeLine("\"extensions\": {");
+        if (texture.has_basisu) {
+            extensionFlags |= textureBasisu;
+            // Without a fallback image the texture can only be used by loaders supporting the extension
+            if (texture.image == nullptr) {
+                requiredExtensionFlags |= textureBasisu;
+            }
+            writeLine("\"KHR_texture_basisu\": {");
+            writeIndexProperty("source", texture.basisu_image, data.images);
+            writeLine("}");
+        }
+        writeToolExtensions(texture.extensions, texture.extensions_count);
+        writeLine("}");
+    }
+    writeExtras(texture.extras);
+    writeLine("}");
+}
+
+void GLTFWriter::writeSkin(const cgltf_skin& skin) noexcept
+{
+    writeLine("{");
+    writeIndexProperty("skeleton", skin.skeleton, data.nodes);
+    writeIndexProperty("inverseBindMatrices", skin.inverse_bind_matrices, data.accessors);
+    writeIndexArrayProperty("joints", skin.joints, skin.joints_count, data.nodes);
+    writeStringProperty("name", skin.name);
+    if (hasToolExtension(skin.extensions, skin.extensions_count)) {
+        writeLine("\"extensions\": {");
+        writeToolExtensions(skin.extensions, skin.extensions_count);
+        writeLine("}");
+    }
+    writeExtras(skin.extras);
+    writeLine("}");
+}
+
+void GLTFWriter::writeAnimation(const cgltf_animation& animation) noexcept
+{
+    writeLine("{");
+    writeStringProperty("name", animation.name);
+    if (animation.samplers_count > 0) {
+        writeLine("\"samplers\": [");
+        for (cgltf_size i = 0; i < animation.samplers_count; ++i) {
+            const cgltf_animation_sampler& sampler = animation.samplers[i];
+            writeLine("{");
+            writeStringProperty("interpolation", getInterpolationName(sampler.interpolation));
+            writeIndexProperty("input", sampler.input, data.accessors);
+            writeIndexProperty("output", sampler.output, data.accessors);
+            writeExtras(sampler.extras);
+            writeLine("}");
+        }
+        writeLine("]");
+    }
+    if (animation.channels_count > 0) {
+        writeLine("\"channels\": [");
+        for (cgltf_size i = 0; i < animation.channels_count; ++i) {
+            const cgltf_animation_channel& channel = animation.channels[i];
+            writeLine("{");
+            writeIndexProperty("sampler", channel.sampler, animation.samplers);
+            writeLine("\"target\": {");
+            writeIndexProperty("node", channel.target_node, data.nodes);
+            writeStringProperty("path", getPathName(channel.target_path));
+            writeLine("}");
+            writeExtras(channel.extras);
+            writeLine("}");
+        }
+        writeLine("]");
+    }
+    if (hasToolExtension(animation.extensions, animation.extensions_count)) {
+        writeLine("\"extensions\": {");
+        writeToolExtensions(animation.extensions, animation.extensions_count);
+        writeLine("}");
+    }
+    writeExtras(animation.extras);
+    writeLine("}");
+}
+
+void GLTFWriter::writeCamera(const cgltf_camera& camera) noexcept
+{
+    writeLine("{");
+    writeStringProperty("type",
+        (camera.type == cgltf_camera_type_perspective)       ? "perspective" :
+            (camera.type == cgltf_camera_type_orthographic) ? "orthographic" :
+                                                              nullptr);
+    writeStringProperty("name", camera.name);
+    if (camera.type == cgltf_camera_type_orthographic) {
+        const cgltf_camera_orthographic& params = camera.data.orthographic;
+        writeLine("\"orthographic\": {");
+        writeFloatProperty("xmag", params.xmag, -1.0f);
+        writeFloatProperty("ymag", params.ymag, -1.0f);
+        writeFloatProperty("zfar", params.zfar, -1.0f);
+        writeFloatProperty("znear", params.znear, -1.0f);
+        writeExtras(params.extras);
+        writeLine("}");
+    } else if (camera.type == cgltf_camera_type_perspective) {
+        const cgltf_camera_perspective& params = camera.data.perspective;
+        writeLine("\"perspective\": {");
+        if (params.has_aspect_ratio) {
+            writeFloatProperty("aspectRatio", params.aspect_ratio, -1.0f);
+        }
+        writeFloatProperty("yfov", params.yfov, -1.0f);
+        if (params.has_zfar) {
+            writeFloatProperty("zfar", params.zfar, -1.0f);
+        }
+        writeFloatProperty("znear", params.znear, -1.0f);
+        writeExtras(params.extras);
+        writeLine("}");
+    }
+    writeExtras(camera.extras);
+    writeLine("}");
+}
+
+void GLTFWriter::writeLight(const cgltf_light& light) noexcept
+{
+    extensionFlags |= lightsPunctual;
+    writeLine("{");
+    writeStringProperty("type",
+        (light.type == cgltf_light_type_directional) ? "directional" :
+            (light.type == cgltf_light_type_point)   ? "point" :
+            (light.type == cgltf_light_type_spot)    ? "spot" :
+                                                       nullptr);
+    writeStringProperty("name", light.name);
+    if (checkFloatArray(light.color, 3, 1.0f)) {
+        writeFloatArrayProperty("color", light.color, 3);
+    }
+    writeFloatProperty("intensity", light.intensity, 1.0f);
+    writeFloatProperty("range", light.range, 0.0f);
+    if (light.type == cgltf_light_type_spot) {
+        writeLine("\"spot\": {");
+        writeFloatProperty("innerConeAngle", light.spot_inner_cone_angle, 0.0f);
+        writeFloatProperty("outerConeAngle", light.spot_outer_cone_angle, 3.14159265358979323846f / 4.0f);
+        writeLine("}");
+    }
+    writeExtras(light.extras);
+    writeLine("}");
+}
+
+void GLTFWriter::flush() noexcept
+{
+    if (!buffer.empty()) {
+        writeOutput(buffer.data(), buffer.size());
+        buffer.clear();
+    }
+}
+
+void GLTFWriter::writeOutput(const char* text, size_t size) noexcept
+{
+    if (memory != nullptr) {
+        const auto* data = reinterpret_cast<const uint8_t*>(text);
+        memory->insert(memory->end(), data, data + size);
+    } else {
+        file.write(text, static_cast<streamsize>(size));
+    }
+}
@@ -0,0 +1,156 @@
+/**
+ * Copyright Matthew Oliver
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#pragma once
+
+#include <cgltf.h>
+#include <cstdint>
+#include <fstream>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+
+/** Prefix used by extensions created by this tool, these are written along with all extensions known to cgltf */
+constexpr std::string_view toolExtensionPrefix = "GLTFOPT_";
+
+/** Primitive extension referencing meshlets stored in a sidecar file */
+constexpr std::string_view meshletExtension = "GLTFOPT_meshlets";
+
+/**
+ * Writes gltf JSON directly to a file in fixed size chunks instead of building the whole document in memory. The
+ * output matches that of cgltf_write_file.
+ */
+class GLTFWriter
+{
+public:
+    GLTFWriter(const cgltf_data& data) noexcept;
+
+    GLTFWriter() = delete;
+
+    ~GLTFWriter() noexcept = default;
+
+    [[nodiscard]] bool writeGLTF(const std::string& fileName) noexcept;
+
+    /**
+     * Write gltf JSON to memory.
+     * @param output Receives the JSON text.
+     * @return True if it succeeds, false if it fails.
+     */
+    [[nodiscard]] bool writeGLTF(std::vector<uint8_t>& output) noexcept;
+
+    /**
+     * Write a binary glb file. The JSON is streamed out first and then the binary chunk is written directly from the
+     * passed in memory, the header lengths are patched in afterwards so no intermediate copy of the file is required.
+     * @param fileName The output file.
+     * @param binary   The contents of buffer 0, each entry is written at the next 4 byte aligned offset.
+     * @return True if it succeeds, false if it fails.
+     */
+    [[nodiscard]] bool writeGLB(
+        const std::string& fileName, const std::vector<std::span<const uint8_t>>& binary) noexcept;
+
+    /**
+     * Write a binary glb file to memory.
+     * @param output Receives the glb file data.
+     * @param binary The contents of buffer 0, each entry is written at the next 4 byte aligned offset.
+     * @return True if it succeeds, false if it fails.
+     */
+    [[nodiscard]] bool writeGLB(
+        std::vector<uint8_t>& output, const std::vector<std::span<const uint8_t>>& binary) noexcept;
+
+private:
+    [[nodiscard]] bool writeGLBChunks(const std::vector<std::span<const uint8_t>>& binary) noexcept;
+
+    void writeDocument() noexcept;
+
+    void writeOutput(const char* text, size_t size) noexcept;
+
+    void write(const std::string_view& text) noexcept;
+
+    void writeString(const char* text) noexcept;
+
+    void writeFloat(cgltf_float value) noexcept;
+
+    void writeIndent() noexcept;
+
+    void writeLine(const std::string_view& line) noexcept;
+
+    void writeStringProperty(const char* label, const char* value) noexcept;
+
+    void writeIntProperty(const char* label, int64_t value, int64_t defaultValue) noexcept;
+
+    void writeFloatProperty(const char* label, cgltf_float value, cgltf_float defaultValue) noexcept;
+
+    void writeBoolProperty(const char* label, bool value, bool defaultValue) noexcept;
+
+    void writeFloatArrayProperty(const char* label, const cgltf_float* values, cgltf_size count) noexcept;
+
+    template<typename T>
+    void writeIndexProperty(const char* label, const T* value, const T* start) noexcept;
+
+    template<typename T>
+    void writeIndexArrayProperty(const char* label, T* const* values, cgltf_size count, const T* start) noexcept;
+
+    void writeExtras(const cgltf_extras& extras) noexcept;
+
+    void writeToolExtensions(const cgltf_extension* extensions, cgltf_size count) noexcept;
+
+    void writeExtensionNames(uint32_t flags, char* const* names, cgltf_size count) noexcept;
+
+    void writeTextureView(const char* label, const cgltf_texture_view& view, const char* scaleLabel = nullptr) noexcept;
+
+    void writeAccessor(const cgltf_accessor& accessor) noexcept;
+
+    void writeBufferView(const cgltf_buffer_view& view) noexcept;
+
+    void writeBuffer(const cgltf_buffer& buffer) noexcept;
+
+    void writeImage(const cgltf_image& image) noexcept;
+
+    void writePrimitive(const cgltf_primitive& prim) noexcept;
+
+    void writeMesh(const cgltf_mesh& mesh) noexcept;
+
+    void writeMaterial(const cgltf_material& material) noexcept;
+
+    void writeNode(const cgltf_node& node) noexcept;
+
+    void writeSampler(const cgltf_sampler& sampler) noexcept;
+
+    void writeScene(const cgltf_scene& scene) noexcept;
+
+    void writeTexture(const cgltf_texture& texture) noexcept;
+
+    void writeSkin(const cgltf_skin& skin) noexcept;
+
+    void writeAnimation(const cgltf_animation& animation) noexcept;
+
+    void writeCamera(const cgltf_camera& camera) noexcept;
+
+    void writeLight(const cgltf_light& light) noexcept;
+
+    void flush() noexcept;
+
+    const cgltf_data& data;
+    std::ofstream file;
+    std::vector<uint8_t>* memory = nullptr;
+    std::vector<char> buffer;
+    size_t outputSize = 0;
+    size_t jsonSize = 0;
+    int depth = 1;
+    bool needsComma = false;
+    uint32_t extensionFlags = 0;
+    uint32_t requiredExtensionFlags = 0;
+};
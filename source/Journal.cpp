@@ -0,0 +1,92 @@
+/**
+ * Copyright Matthew Oliver
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "Journal.h"
+
+#include "Shared.h"
+
+#include <array>
+#include <cstdio>
+
+using namespace std;
+
+bool Journal::open(const string& fileName, bool resume) noexcept
+{
+    lock_guard<mutex> guard(lock);
+    entries.clear();
+    journalFile = fileName;
+    if (resume) {
+        // Entries are 'parameters<tab>hash<tab>output' lines, a partially written last line is ignored
+        ifstream existing(fileName);
+        string line;
+        while (getline(existing, line)) {
+            const size_t first = line.find('\t');
+            const size_t second = (first != string::npos) ? line.find('\t', first + 1) : string::npos;
+            if (second == string::npos || second + 1 >= line.length()) {
+                continue;
+            }
+            entries[line.substr(second + 1)] = {line.substr(0, first), line.substr(first + 1, second - first - 1)};
+        }
+        if (!entries.empty()) {
+            printInfo("Resuming from journal with completed jobs: "s + to_string(entries.size()));
+        }
+    }
+    file.open(fileName, resume ? ios::app : ios::trunc);
+    if (!file.is_open()) {
+        printError("Failed to open journal: "s + fileName);
+        return false;
+    }
+    return true;
+}
+
+void Journal::close(bool completed) noexcept
+{
+    lock_guard<mutex> guard(lock);
+    if (!file.is_open()) {
+        return;
+    }
+    file.close();
+    entries.clear();
+    if (completed) {
+        remove(journalFile.c_str());
+    }
+}
+
+bool Journal::isComplete(const string& outputFile, const string& parameters) noexcept
+{
+    Entry entry;
+    {
+        lock_guard<mutex> guard(lock);
+        const auto found = entries.find(outputFile);
+        if (found == entries.end()) {
+            return false;
+        }
+        entry = found->second;
+    }
+    // The output may have been modified or removed since it was recorded
+    return entry.parameters == parameters && getFileHash(outputFile) == entry.hash;
+}
+
+void Journal::record(const string& outputFile, const string& parameters, span<const uint8_t> data) noexcept
+{
+    const string hash = getDataHash(data);
+    lock_guard<mutex> guard(lock);
+    if (!file.is_open()) {
+        return;
+    }
+    file << parameters << '\t' << hash << '\t' << outputFile << endl;
+    entries[outputFile] = {parameters, hash};
+}
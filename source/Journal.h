@@ -0,0 +1,88 @@
+/**
+ * Copyright Matthew Oliver
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#pragma once
+
+#include <cstdint>
+#include <fstream>
+#include <map>
+#include <mutex>
+#include <span>
+#include <string>
+
+/**
+ * Append only record of completed jobs so that an interrupted run can be resumed without redoing finished work. Each
+ * entry is flushed as soon as it is recorded so that it survives the process being killed.
+ */
+class Journal
+{
+public:
+    Journal() noexcept = default;
+
+    ~Journal() noexcept = default;
+
+    Journal(const Journal&) = delete;
+
+    Journal& operator=(const Journal&) = delete;
+
+    /**
+     * Open a journal for writing.
+     * @param fileName The journal file.
+     * @param resume   True to keep and load the entries of an existing journal, otherwise any existing journal is
+     *  replaced.
+     * @return True if it succeeds, false if it fails.
+     */
+    [[nodiscard]] bool open(const std::string& fileName, bool resume) noexcept;
+
+    /**
+     * Close the journal.
+     * @param completed True if the run completed, in which case there is nothing left to resume so the journal file is
+     *  removed.
+     */
+    void close(bool completed) noexcept;
+
+    [[nodiscard]] bool isOpen() const noexcept
+    {
+        return file.is_open();
+    }
+
+    /**
+     * Check if a job was completed by a previous run. The output must still match the data that was recorded.
+     * @param outputFile The job output file.
+     * @param parameters The parameters used to create the output (e.g. settings and source hash).
+     * @return True if complete, false if the job must be run.
+     */
+    [[nodiscard]] bool isComplete(const std::string& outputFile, const std::string& parameters) noexcept;
+
+    /**
+     * Record a completed job.
+     * @param outputFile The job output file, this should already have been written.
+     * @param parameters The parameters used to create the output.
+     * @param data       The data written to the output file.
+     */
+    void record(const std::string& outputFile, const std::string& parameters, std::span<const uint8_t> data) noexcept;
+
+private:
+    struct Entry
+    {
+        std::string parameters;
+        std::string hash;
+    };
+
+    std::mutex lock;
+    std::string journalFile;
+    std::ofstream file;
+    std::map<std::string, Entry> entries;
+};
@@ -16,12 +16,12 @@
 
 #include "Optimiser.h"
 
+#include "GLTFWriter.h"
 #include "Shared.h"
 #include "SharedCGLTF.h"
 #include "Version.h"
 
 #include <cgltf.h>
-#include <cgltf_write.h>
 #include <map>
 #include <set>
 #include <vector>
@@ -30,8 +30,95 @@ using namespace std;
 
 Optimiser::Optimiser(const Options& opts) noexcept
     : options(opts)
+    , ownedPool(make_unique<BS::thread_pool>())
+    , pool(*ownedPool)
 {}
 
+Optimiser::Optimiser(
+    const Options& opts, BS::thread_pool& threadPool, TextureCache& cache, DecodedTextureCache* decoded) noexcept
+    : options(opts)
+    , pool(threadPool)
+    , textureCache(&cache)
+    , decodedCache(decoded)
+{}
+
+void Optimiser::setProgressCallback(std::function<void(const std::string&)> callback) noexcept
+{
+    progressCallback = std::move(callback);
+}
+
+void Optimiser::deferFileRemoval(std::vector<std::string>& files) noexcept
+{
+    deferredRemovedFiles = &files;
+}
+
+void Optimiser::reportProgress(const std::string& stage) noexcept
+{
+    if (progressCallback) {
+        progressCallback(stage);
+    }
+}
+
+void Optimiser::cancel() noexcept
+{
+    cancelled = true;
+}
+
+bool Optimiser::runTask(const function<bool()>& task) noexcept
+{
+    // Jobs that have not started are skipped once the pass has been cancelled, the pass itself then fails
+    if (cancelled) {
+        return true;
+    }
+    if (task()) {
+        return true;
+    }
+    if (!options.continueOnError) {
+        cancel();
+    }
+    return false;
+}
+
+bool Optimiser::waitForTasks() noexcept
+{
+    // Only this optimiser's own jobs are waited on as the pool may be shared with others
+    size_t failed = 0;
+    for (auto& task : pendingTasks) {
+        if (!task.get()) {
+            ++failed;
+        }
+    }
+    pendingTasks.clear();
+    if (failed > 0) {
+        printError("Failed jobs: "s + to_string(failed));
+    }
+    if (failed > 0 || cancelled) {
+        // The input still references the source files as no output is written
+        removedFiles.clear();
+        return false;
+    }
+
+    // Source files are only removed once no job can still be reading them
+    if (deferredRemovedFiles != nullptr) {
+        deferredRemovedFiles->insert(deferredRemovedFiles->end(), removedFiles.begin(), removedFiles.end());
+        removedFiles.clear();
+        return true;
+    }
+    for (auto& file : removedFiles) {
+        printInfo("Removing old texture: "s + file);
+        remove(file.c_str());
+    }
+    removedFiles.clear();
+    return true;
+}
+
+bool Optimiser::isCancelled() noexcept
+{
+    // Nothing is reported here as a failed job has already reported its error and a cancel request is reported by
+    // whoever requested it
+    return cancelled;
+}
+
 bool Optimiser::pass(const std::string& inputFile, const std::string& outputFile) noexcept
 {
     // Get asset file location
@@ -43,39 +130,124 @@ bool Optimiser::pass(const std::string& inputFile, const std::string& outputFile
         rootFolder += '/';
     }
     // Open the GLTF file
+    reportProgress("Loading"s);
     printInfo("Opening input gltf file: "s + inputFile);
     cgltf_options optionsCGLTF = {};
     cgltf_result result = cgltf_result_success;
     dataCGLTF = shared_ptr<cgltf_data>(
         [&]() {
             cgltf_data* data = nullptr;
-            result = cgltf_parse_file(&optionsCGLTF, inputFile.c_str(), &data);
+            result = cgltf_parse_file_json(&optionsCGLTF, inputFile.c_str(), &data, &binChunkOffset);
             return data;
         }(),
         [](auto p) { cgltf_free(p); });
     if (result != cgltf_result_success) {
         printError("Failed to parse input file: "s + getCGLTFError(result, dataCGLTF));
-        return 1;
+        return false;
     }
-    result = cgltf_load_buffers(&optionsCGLTF, dataCGLTF.get(), inputFile.c_str());
-    if (result != cgltf_result_success) {
-        printError("Failed to load input file buffers: "s + getCGLTFError(result, dataCGLTF));
-        return 1;
+    sourceFile = inputFile;
+    memoryOutput = nullptr;
+
+    // Completed texture jobs are journaled so that an interrupted run can be resumed
+    const string journalFile = getFolder(outputFile) + getSidecarFileName(outputFile, ".journal"sv);
+    if (!journal.open(journalFile, options.resume)) {
+        return false;
     }
-    result = cgltf_validate(dataCGLTF.get());
+
+    // Textures created by previous runs are only recreated if their source image or settings have changed
+    const string sourcesFile = getFolder(outputFile) + getSidecarFileName(outputFile, ".sources"sv);
+    if (options.incremental && !sourceManifest.load(sourcesFile)) {
+        return false;
+    }
+    bool succeeded = runPasses(outputFile);
+    journal.close(succeeded);
+    if (sourceManifest.isLoaded()) {
+        // Saved even if the run failed so that any completed textures are not recreated
+        succeeded = sourceManifest.save() && succeeded;
+    }
+    return succeeded;
+}
+
+bool Optimiser::pass(
+    span<const uint8_t> input, Output& output, const string& outputName, const string& folder) noexcept
+{
+    reportProgress("Loading"s);
+    cgltf_options optionsCGLTF = {};
+    cgltf_result result = cgltf_result_success;
+    auto data = shared_ptr<cgltf_data>(
+        [&]() {
+            cgltf_data* parsed = nullptr;
+            result = cgltf_parse(&optionsCGLTF, input.data(), input.size(), &parsed);
+            return parsed;
+        }(),
+        [](auto p) { cgltf_free(p); });
     if (result != cgltf_result_success) {
+        printError("Failed to parse input: "s + getCGLTFError(result, data));
+        return false;
+    }
+    return pass(data, output, outputName, folder);
+}
+
+bool Optimiser::pass(
+    shared_ptr<cgltf_data> data, Output& output, const string& outputName, const string& folder) noexcept
+{
+    if (data == nullptr) {
+        return false;
+    }
+    rootFolder = folder;
+    if (!rootFolder.empty() && rootFolder.back() != '/' && rootFolder.back() != '\\') {
+        rootFolder += '/';
+    }
+    dataCGLTF = std::move(data);
+    binChunkOffset = 0;
+
+    // There is no input file, any external buffers are loaded relative to the folder instead
+    sourceFile = rootFolder;
+    output = {};
+    memoryOutput = &output;
+    const bool succeeded = runPasses(outputName);
+    memoryOutput = nullptr;
+    return succeeded;
+}
+
+bool Optimiser::writeOutputFile(
+    const string& folder, const string& uri, const vector<span<const uint8_t>>& data) noexcept
+{
+    // In memory outputs are stored by their uri relative to the output document
+    if (memoryOutput != nullptr) {
+        vector<uint8_t>& file = memoryOutput->files[uri];
+        file.clear();
+        for (auto& i : data) {
+            file.insert(file.end(), i.begin(), i.end());
+        }
+        return true;
+    }
+    return writeFile(folder + uri, data);
+}
+
+bool Optimiser::runPasses(const string& outputFile) noexcept
+{
+    if (cgltf_result result = cgltf_validate(dataCGLTF.get()); result != cgltf_result_success) {
         printError("Invalid input file detected: "s + getCGLTFError(result, dataCGLTF));
-        return 1;
+        return false;
     }
 
-    // Check for unusable extensions
-    if (requiresGLTFExtension(dataCGLTF, "KHR_draco_mesh_compression")) {
-        printError("Draco mesh compressions is not supported (input file uses KHR_draco_mesh_compression)"sv);
-        return 1;
+    // Buffer data is only loaded once the first pass that requires it is run
+    buffersLoaded = false;
+    mappedBuffers.clear();
+    embeddedImages.clear();
+    pendingTasks.clear();
+    removedFiles.clear();
+    buffersModified = false;
+    cancelled = false;
+    const bool optimiseGeometry = !options.texturesOnly;
+    if (optimiseGeometry && !requireBuffers()) {
+        return false;
     }
-    if (requiresGLTFExtension(dataCGLTF, "EXT_mesh_gpu_instancing")) {
-        printError("Mesh instancing is not supported (input file uses EXT_mesh_gpu_instancing)"sv);
-        return 1;
+
+    // Decode any Draco compressed meshes so they can be optimised like any other mesh data
+    if (optimiseGeometry && !passDracoDecode()) {
+        return false;
     }
 
     // TODO: optionally strip material names, mesh names, camera names etc.
@@ -89,28 +261,95 @@ bool Optimiser::pass(const std::string& inputFile, const std::string& outputFile
     // Check for duplicate objects
     passDuplicate();
 
-    // Optimise meshes
-    auto checkMeshes = pool.submit(&Optimiser::passMeshes, this);
+    // Remove redundant animation data, this must occur before any checks for static nodes
+    if (optimiseGeometry && !passAnimations()) {
+        return false;
+    }
 
-    // Wait for thread pool to complete all jobs before continuing
-    pool.wait_for_tasks();
+    // Convert repeated static meshes to instances
+    if (optimiseGeometry && options.instancingMinimum > 0 && !passInstancing()) {
+        return false;
+    }
 
-    if (!checkMeshes.get()) {
+    // Flatten static node hierarchies
+    if (optimiseGeometry && options.flattenStaticNodes && !passFlatten()) {
         return false;
     }
 
-    // Optimise images
-    auto checkTextures = pool.submit(&Optimiser::passTextures, this);
+    // Remove anything detached by instancing or flattening before any jobs are queued so that it is neither optimised
+    // nor compressed, geometry data is checked once mesh optimisation has completed
+    if (optimiseGeometry) {
+        checkUnusedMeshes();
+        checkUnusedMaterials();
+        checkUnusedTextures();
+        checkUnusedImages();
+    }
 
-    // Wait for thread pool to complete all jobs
-    pool.wait_for_tasks();
+    // Export texture jobs to be run by separate workers, the images are left unchanged until the results are merged
+    if (!options.textureManifest.empty() && !passTextureManifest()) {
+        return false;
+    }
 
-    if (!checkTextures.get()) {
+    if (isCancelled()) {
         return false;
     }
 
-    // Write out updated gltf
-    printInfo("Writing output gltf file: "s + outputFile);
+    // Texture jobs only depend on the cleanup passes, so they are queued first and run on the pool while meshes are
+    // optimised. Queuing only modifies images and textures, mesh optimisation only modifies meshes and geometry data.
+    reportProgress("Compressing textures"s);
+    bool succeeded = passTextures();
+
+    // Optimise meshes on this thread, any meshlet jobs are queued to run on the pool alongside the texture jobs
+    if (succeeded && optimiseGeometry) {
+        reportProgress("Optimising meshes"s);
+        succeeded = passMeshes();
+    }
+
+    // All later passes depend on both the texture and mesh results, a failed job fails the pass. Queued jobs are
+    // skipped once this thread has failed unless all errors are to be reported
+    if (!succeeded && !options.continueOnError) {
+        cancel();
+    }
+    succeeded = waitForTasks() && succeeded;
+    if (isCancelled() || !succeeded) {
+        return false;
+    }
+
+    if (optimiseGeometry) {
+        // Remove any geometry data orphaned by mesh optimisation, images are not checked as converted images are
+        // referenced by index until they are stored
+        checkUnusedAttributes();
+        checkUnusedAccessors();
+        checkUnusedBufferViews();
+        checkUnusedBuffers();
+    }
+
+    // Store compressed textures that are not written to separate files
+    if (!passEmbeddedImages()) {
+        return false;
+    }
+
+    // Re-compress meshes
+    if (optimiseGeometry && options.dracoCompressMeshes && !passDracoEncode()) {
+        return false;
+    }
+
+    // Reorder nodes, meshes and geometry data so that nearby objects are stored together
+    if (optimiseGeometry && options.spatialSort && !passSpatialSort()) {
+        return false;
+    }
+
+    // Write out any generated meshlets
+    if (!passMeshlets(outputFile)) {
+        return false;
+    }
+
+    if (isCancelled()) {
+        return false;
+    }
+
+    // Set generator to identify output files
+    reportProgress("Writing"s);
     string_view generator = "GLTFOptimiser (" SIG_VERSION_STR ")";
     auto newMem = realloc(dataCGLTF->asset.generator, generator.size() + 1);
     if (newMem == nullptr) {
@@ -119,15 +358,42 @@ bool Optimiser::pass(const std::string& inputFile, const std::string& outputFile
     }
     dataCGLTF->asset.generator = static_cast<char*>(newMem);
     std::strcpy(dataCGLTF->asset.generator, generator.data());
+
+    // Write out spatial tiles instead of a single gltf
+    if (options.tileMaxNodes > 0 && memoryOutput != nullptr) {
+        printError("Spatial tiles can not be output to memory"sv);
+        return false;
+    }
+    if (options.tileMaxNodes > 0) {
+        return passTiles(outputFile);
+    }
+
+    // Write out a single glb containing all geometry and images
+    if (options.outputGLB) {
+        return passGLB(outputFile);
+    }
+
+    // The binary chunk of a glb input has no uri so must be written out to a separate buffer file
+    for (cgltf_size i = 0; i < dataCGLTF->buffers_count; ++i) {
+        buffersModified = buffersModified || dataCGLTF->buffers[i].uri == nullptr;
+    }
+
+    // Write out any modified geometry buffers
+    if (!passBuffers(outputFile)) {
+        return false;
+    }
+
+    // Write out updated gltf
+    printInfo("Writing output gltf file: "s + outputFile);
     // Validate output file
-    result = cgltf_validate(dataCGLTF.get());
-    if (result != cgltf_result_success) {
+    if (cgltf_result result = cgltf_validate(dataCGLTF.get()); result != cgltf_result_success) {
         printError("Invalid output file detected: "s + getCGLTFError(result, dataCGLTF));
-        return 1;
+        return false;
     }
-    result = cgltf_write_file(&optionsCGLTF, outputFile.c_str(), dataCGLTF.get());
-    if (result != cgltf_result_success) {
-        printError("Failed writing output file: "s + getCGLTFError(result, dataCGLTF));
+    if (memoryOutput != nullptr) {
+        return GLTFWriter(*dataCGLTF).writeGLTF(memoryOutput->document);
+    }
+    if (!GLTFWriter(*dataCGLTF).writeGLTF(outputFile)) {
         return false;
     }
 
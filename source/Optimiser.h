@@ -16,10 +16,21 @@
 #pragma once
 
 #include "BS_thread_pool.hpp"
+#include "Journal.h"
+#include "Shared.h"
+#include "SourceManifest.h"
+#include "TextureCache.h"
 
+#include <array>
+#include <atomic>
 #include <cgltf.h>
+#include <functional>
+#include <future>
+#include <map>
 #include <memory>
+#include <span>
 #include <string>
+#include <vector>
 
 class Optimiser
 {
@@ -29,13 +40,97 @@ public:
         bool keepOriginalTextures = false;
         bool replaceCompressedTextures = false;
         bool splitMetalRoughTextures = false;
+        bool flattenStaticNodes = false;
+        uint32_t instancingMinimum = 0;
+        bool dracoCompressMeshes = false;
+        bool generateMeshlets = false;
+        uint32_t meshletMaxVertices = 64;
+        uint32_t meshletMaxTriangles = 124;
+        float morphTargetEpsilon = 0.0f;
+        float animationTolerance = 0.000001f;
+        bool quantiseRotations = false;
+        bool spatialSort = false;
+        uint32_t tileMaxNodes = 0;
+        bool texturesOnly = false;
+        bool outputGLB = false;
+        bool resume = false;
+        bool incremental = false;
+        bool continueOnError = false; /**< Run all remaining jobs after one fails instead of cancelling them */
+        std::string textureManifest; /**< Write texture jobs to this manifest for workers instead of encoding */
+    };
+
+    /** Result of optimising in memory */
+    struct Output
+    {
+        std::vector<uint8_t> document;                     /**< The output gltf JSON or glb file */
+        std::map<std::string, std::vector<uint8_t>> files; /**< New files referenced by the document (e.g. buffers
+                                                               and ktx2 textures) keyed by their uri */
     };
 
     Optimiser(const Options& opts) noexcept;
 
+    /**
+     * Create an optimiser that runs its jobs on a pool and texture cache shared with other optimisers.
+     * @param opts       The options.
+     * @param threadPool The thread pool used for all jobs.
+     * @param cache      Cache of compressed textures shared between optimisers.
+     * @param decoded    (Optional) Cache of decoded source images shared between optimisers.
+     */
+    Optimiser(const Options& opts, BS::thread_pool& threadPool, TextureCache& cache,
+        DecodedTextureCache* decoded = nullptr) noexcept;
+
     [[nodiscard]] bool pass(const std::string& inputFile, const std::string& outputFile) noexcept;
 
+    /**
+     * Optimise a gltf or glb file that is already in memory, no output is written to disk.
+     * @param input      The input file data, this must remain valid until the function returns.
+     * @param output     Receives the output document along with any files it references.
+     * @param outputName File name of the output document, used to name any referenced files (e.g. scene.gltf
+     *  references scene.bin).
+     * @param folder     (Optional) Folder used to find any external files referenced by the input.
+     * @return True if it succeeds, false if it fails.
+     */
+    [[nodiscard]] bool pass(std::span<const uint8_t> input, Output& output, const std::string& outputName,
+        const std::string& folder = {}) noexcept;
+
+    /**
+     * Optimise an already parsed gltf, no output is written to disk.
+     * @param data       The parsed gltf, this is modified by the optimiser so should not be used afterwards.
+     * @param output     Receives the output document along with any files it references.
+     * @param outputName File name of the output document, used to name any referenced files.
+     * @param folder     (Optional) Folder used to find any external files referenced by the input.
+     * @return True if it succeeds, false if it fails.
+     */
+    [[nodiscard]] bool pass(std::shared_ptr<cgltf_data> data, Output& output, const std::string& outputName,
+        const std::string& folder = {}) noexcept;
+
+    /**
+     * Set a function that is notified as each stage of the optimisation is started and as textures complete. This may
+     * be called from any thread.
+     * @param callback The progress function.
+     */
+    void setProgressCallback(std::function<void(const std::string&)> callback) noexcept;
+
+    /**
+     * Defer removal of converted source textures, the files are added to the list instead of being deleted once the
+     * pass succeeds. Used when several optimisers may share the same source files.
+     * @param files The list that receives the files to remove, this must remain valid while the optimiser is in use.
+     */
+    void deferFileRemoval(std::vector<std::string>& files) noexcept;
+
+    /**
+     * Cancel a running pass, this may be called from any thread. Jobs that have already started run to completion,
+     * any remaining jobs are skipped and the pass fails at the start of its next stage without writing any output. The
+     * cancellation itself is not reported as an error.
+     */
+    void cancel() noexcept;
+
 private:
+    [[nodiscard]] bool runPasses(const std::string& outputFile) noexcept;
+
+    [[nodiscard]] bool writeOutputFile(
+        const std::string& folder, const std::string& uri, const std::vector<std::span<const uint8_t>>& data) noexcept;
+
     void checkInvalidImages() noexcept;
 
     void checkInvalidTextures() noexcept;
@@ -54,6 +149,14 @@ private:
 
     void checkUnusedMeshes() noexcept;
 
+    void checkUnusedAttributes() noexcept;
+
+    void checkUnusedAccessors() noexcept;
+
+    void checkUnusedBufferViews() noexcept;
+
+    void checkUnusedBuffers() noexcept;
+
     void passUnused() noexcept;
 
     void checkDuplicateImages() noexcept;
@@ -62,14 +165,63 @@ private:
 
     void checkDuplicateMaterials() noexcept;
 
+    void checkDuplicateAccessors() noexcept;
+
     void checkDuplicateMeshes() noexcept;
 
     void passDuplicate() noexcept;
 
+    [[nodiscard]] bool passDracoDecode() noexcept;
+
+    [[nodiscard]] bool passDracoEncode() noexcept;
+
     [[nodiscard]] bool passTextures() noexcept;
 
+    [[nodiscard]] bool passEmbeddedImages() noexcept;
+
+    [[nodiscard]] bool passTextureManifest() noexcept;
+
+    [[nodiscard]] bool passAnimations() noexcept;
+
+    void removeUnusedSamplers(cgltf_animation& animation) noexcept;
+
+    void removeEmptyAnimations() noexcept;
+
+    [[nodiscard]] bool passInstancing() noexcept;
+
+    [[nodiscard]] bool passFlatten() noexcept;
+
     [[nodiscard]] bool passMeshes() noexcept;
 
+    [[nodiscard]] bool passSpatialSort() noexcept;
+
+    [[nodiscard]] bool requireBuffers() noexcept;
+
+    [[nodiscard]] bool loadBuffers() noexcept;
+
+    [[nodiscard]] bool passBuffers(const std::string& outputFile) noexcept;
+
+    [[nodiscard]] bool passTiles(const std::string& outputFile) noexcept;
+
+    [[nodiscard]] bool passGLB(const std::string& outputFile) noexcept;
+
+    [[nodiscard]] bool mergePrimitives(cgltf_mesh* mesh) noexcept;
+
+    [[nodiscard]] bool concatenatePrimitives(cgltf_primitive& dest, const std::vector<cgltf_primitive*>& sources,
+        const std::vector<std::array<cgltf_float, 16>>& transforms = {}) noexcept;
+
+    [[nodiscard]] bool compactPrimitives(const std::vector<cgltf_primitive*>& prims) noexcept;
+
+    [[nodiscard]] bool optimiseMorphTargets(cgltf_mesh& mesh) noexcept;
+
+    [[nodiscard]] bool removeMorphTargets(cgltf_mesh& mesh, const std::vector<bool>& keep) noexcept;
+
+    [[nodiscard]] bool convertToSparse(cgltf_accessor*& accessor) noexcept;
+
+    void queueMeshlets() noexcept;
+
+    [[nodiscard]] bool passMeshlets(const std::string& outputFile) noexcept;
+
     void removeImage(cgltf_image* image) noexcept;
 
     void removeTexture(cgltf_texture* texture) noexcept;
@@ -78,10 +230,68 @@ private:
 
     void removeMesh(cgltf_mesh* mesh) noexcept;
 
+    void removeAccessor(cgltf_accessor* accessor) noexcept;
+
+    void removeBufferView(cgltf_buffer_view* view) noexcept;
+
+    void removeBuffer(cgltf_buffer* buffer) noexcept;
+
+    void removeNode(cgltf_node* node) noexcept;
+
     bool convertTexture(cgltf_texture* texture, bool sRGB, bool normalMap, bool split = false) noexcept;
 
+    [[nodiscard]] bool runTask(const std::function<bool()>& task) noexcept;
+
+    [[nodiscard]] bool waitForTasks() noexcept;
+
+    [[nodiscard]] bool isCancelled() noexcept;
+
+    void reportProgress(const std::string& stage) noexcept;
+
     std::string rootFolder;
+    std::string sourceFile;
+    cgltf_size binChunkOffset = 0;
+    bool buffersLoaded = false;
+    std::vector<std::unique_ptr<MappedFile>> mappedBuffers;
     std::shared_ptr<cgltf_data> dataCGLTF = nullptr;
     Options options;
-    BS::thread_pool pool;
+    std::unique_ptr<BS::thread_pool> ownedPool;
+    BS::thread_pool& pool;
+    TextureCache* textureCache = nullptr;
+    DecodedTextureCache* decodedCache = nullptr;
+    std::function<void(const std::string&)> progressCallback;
+    std::vector<std::future<bool>> pendingTasks;
+    std::atomic<bool> cancelled = false;
+    std::vector<std::string> removedFiles;
+    std::vector<std::string>* deferredRemovedFiles = nullptr;
+    Output* memoryOutput = nullptr;
+    Journal journal;
+    SourceManifest sourceManifest;
+    bool buffersModified = false;
+
+    struct Meshlets
+    {
+        cgltf_primitive* prim = nullptr;
+        std::vector<uint8_t> data;
+        cgltf_size meshletCount = 0;
+        cgltf_size vertexCount = 0;
+        cgltf_size trianglesSize = 0;
+    };
+    std::vector<Meshlets> meshlets;
+
+    struct EmbeddedImage
+    {
+        cgltf_size image = 0;
+        bool embeddedSource = false;
+        std::vector<uint8_t> data;
+    };
+    std::vector<std::unique_ptr<EmbeddedImage>> embeddedImages;
+    std::map<cgltf_size, cgltf_size> convertedImages;
+
+    struct TextureTask
+    {
+        uint64_t cost = 0;
+        std::function<bool()> run;
+    };
+    std::vector<TextureTask> textureTasks;
 };
@@ -0,0 +1,357 @@
+/**
+ * Copyright Matthew Oliver
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "Optimiser.h"
+#include "Shared.h"
+#include "SharedCGLTF.h"
+
+#include <algorithm>
+#include <cmath>
+#include <future>
+#include <map>
+#include <set>
+#include <vector>
+
+using namespace std;
+
+namespace {
+struct SamplerKeys
+{
+    cgltf_animation_sampler* sampler = nullptr;
+    cgltf_animation_channel* channel = nullptr; // only set when the sampler is used by a single channel
+    cgltf_animation_path_type path = cgltf_animation_path_type_invalid;
+    vector<cgltf_float> times;
+    vector<cgltf_float> values;
+    cgltf_size components = 0;
+    bool changed = false;
+    bool constant = false;
+};
+
+bool isEqual(
+    const cgltf_float* a, const cgltf_float* b, cgltf_size components, bool rotation, cgltf_float tolerance) noexcept
+{
+    // Quaternions q and -q represent the same rotation
+    cgltf_float sign = 1.0f;
+    if (rotation) {
+        const cgltf_float dot = a[0] * b[0] + a[1] * b[1] + a[2] * b[2] + a[3] * b[3];
+        sign = (dot < 0.0f) ? -1.0f : 1.0f;
+    }
+    for (cgltf_size c = 0; c < components; ++c) {
+        if (fabsf(a[c] - sign * b[c]) > tolerance) {
+            return false;
+        }
+    }
+    return true;
+}
+
+void interpolate(const cgltf_float* a, const cgltf_float* b, cgltf_float t, cgltf_size components, bool rotation,
+    cgltf_float* result) noexcept
+{
+    if (!rotation) {
+        for (cgltf_size c = 0; c < components; ++c) {
+            result[c] = a[c] + (b[c] - a[c]) * t;
+        }
+        return;
+    }
+    // Spherical linear interpolation along the shortest path
+    cgltf_float dot = a[0] * b[0] + a[1] * b[1] + a[2] * b[2] + a[3] * b[3];
+    const cgltf_float sign = (dot < 0.0f) ? -1.0f : 1.0f;
+    dot *= sign;
+    cgltf_float weightA = 1.0f - t;
+    cgltf_float weightB = t * sign;
+    if (dot < 0.9995f) {
+        const cgltf_float theta = acosf(dot);
+        const cgltf_float sinTheta = sinf(theta);
+        weightA = sinf((1.0f - t) * theta) / sinTheta;
+        weightB = sinf(t * theta) / sinTheta * sign;
+    }
+    cgltf_float length = 0.0f;
+    for (cgltf_size c = 0; c < 4; ++c) {
+        result[c] = a[c] * weightA + b[c] * weightB;
+        length += result[c] * result[c];
+    }
+    length = sqrtf(length);
+    for (cgltf_size c = 0; c < 4 && length > 0.0f; ++c) {
+        result[c] /= length;
+    }
+}
+
+void reduceKeys(SamplerKeys& keys, cgltf_float tolerance) noexcept
+{
+    const cgltf_animation_sampler& sampler = *keys.sampler;
+    const cgltf_size keyCount = sampler.input->count;
+    const cgltf_size outputComponents = cgltf_num_components(sampler.output->type);
+    // Cubic spline samplers store in/out tangents alongside each value and are left unchanged
+    if (keyCount < 2 || sampler.interpolation == cgltf_interpolation_type_cubic_spline ||
+        sampler.output->count * outputComponents % keyCount != 0) {
+        return;
+    }
+    const cgltf_size components = sampler.output->count * outputComponents / keyCount;
+    const bool rotation = keys.path == cgltf_animation_path_type_rotation;
+    keys.components = components;
+    keys.times.resize(keyCount);
+    vector<cgltf_float> values(sampler.output->count * outputComponents);
+    for (cgltf_size i = 0; i < keyCount; ++i) {
+        cgltf_accessor_read_float(sampler.input, i, &keys.times[i], 1);
+    }
+    for (cgltf_size i = 0; i < sampler.output->count; ++i) {
+        cgltf_accessor_read_float(sampler.output, i, &values[i * outputComponents], outputComponents);
+    }
+    auto value = [&](cgltf_size key) { return &values[key * components]; };
+
+    // Check for channels that never change
+    keys.constant = true;
+    for (cgltf_size i = 1; i < keyCount && keys.constant; ++i) {
+        keys.constant = isEqual(value(0), value(i), components, rotation, tolerance);
+    }
+    vector<cgltf_size> kept;
+    if (keys.constant) {
+        kept.push_back(0);
+    } else {
+        // Keep only keys that can't be reproduced by interpolating between their neighbours
+        kept.push_back(0);
+        vector<cgltf_float> result(components);
+        for (cgltf_size i = 1; i + 1 < keyCount; ++i) {
+            const cgltf_size previous = kept.back();
+            bool removable = true;
+            if (sampler.interpolation == cgltf_interpolation_type_step) {
+                removable = isEqual(value(previous), value(i), components, rotation, tolerance);
+            } else {
+                const cgltf_float duration = keys.times[i + 1] - keys.times[previous];
+                for (cgltf_size j = previous + 1; j <= i && removable; ++j) {
+                    const cgltf_float t =
+                        (duration > 0.0f) ? (keys.times[j] - keys.times[previous]) / duration : 0.0f;
+                    interpolate(value(previous), value(i + 1), t, components, rotation, result.data());
+                    removable = isEqual(result.data(), value(j), components, rotation, tolerance);
+                }
+            }
+            if (!removable) {
+                kept.push_back(i);
+            }
+        }
+        kept.push_back(keyCount - 1);
+    }
+    keys.changed = kept.size() != keyCount;
+
+    vector<cgltf_float> times;
+    for (auto& key : kept) {
+        times.push_back(keys.times[key]);
+        keys.values.insert(keys.values.end(), value(key), value(key) + components);
+    }
+    keys.times = std::move(times);
+}
+} // namespace
+
+bool Optimiser::passAnimations() noexcept
+{
+    // Find the channel using each sampler
+    vector<SamplerKeys> samplers;
+    map<cgltf_animation_sampler*, cgltf_size> samplerIndices;
+    for (cgltf_size i = 0; i < dataCGLTF->animations_count; ++i) {
+        cgltf_animation& animation = dataCGLTF->animations[i];
+        for (cgltf_size j = 0; j < animation.channels_count; ++j) {
+            cgltf_animation_channel& channel = animation.channels[j];
+            if (channel.sampler == nullptr || channel.sampler->input == nullptr ||
+                channel.sampler->output == nullptr) {
+                continue;
+            }
+            if (auto found = samplerIndices.find(channel.sampler); found != samplerIndices.end()) {
+                samplers[found->second].channel = nullptr;
+                continue;
+            }
+            samplerIndices.emplace(channel.sampler, samplers.size());
+            samplers.push_back({channel.sampler, &channel, channel.target_path});
+        }
+    }
+    if (samplers.empty()) {
+        return true;
+    }
+
+    // Reduce keys for each sampler in parallel
+    vector<future<void>> jobs;
+    const cgltf_float tolerance = options.animationTolerance;
+    for (auto& keys : samplers) {
+        jobs.push_back(pool.submit([&keys, tolerance]() { reduceKeys(keys, tolerance); }));
+    }
+    for (auto& job : jobs) {
+        job.wait();
+    }
+
+    // Constant channels that match the node's rest transform have no effect and are removed
+    set<cgltf_animation_channel*> removedChannels;
+    for (auto& keys : samplers) {
+        if (!keys.constant || keys.channel == nullptr || keys.channel->target_node == nullptr ||
+            keys.channel->target_node->has_matrix) {
+            continue;
+        }
+        const cgltf_node& node = *keys.channel->target_node;
+        const cgltf_float identity[4] = {0.0f, 0.0f, 0.0f, 1.0f};
+        const cgltf_float unit[3] = {1.0f, 1.0f, 1.0f};
+        const cgltf_float* rest = nullptr;
+        if (keys.path == cgltf_animation_path_type_translation) {
+            rest = node.has_translation ? node.translation : identity;
+        } else if (keys.path == cgltf_animation_path_type_rotation) {
+            rest = node.has_rotation ? node.rotation : identity;
+        } else if (keys.path == cgltf_animation_path_type_scale) {
+            rest = node.has_scale ? node.scale : unit;
+        }
+        if (rest != nullptr &&
+            isEqual(rest, keys.values.data(), keys.components, keys.path == cgltf_animation_path_type_rotation,
+                options.animationTolerance)) {
+            removedChannels.insert(keys.channel);
+        }
+    }
+
+    // Write out reduced keys
+    cgltf_size oldKeys = 0;
+    cgltf_size newKeys = 0;
+    map<vector<cgltf_float>, cgltf_size> inputs;
+    for (auto& keys : samplers) {
+        const bool quantise = options.quantiseRotations && keys.path == cgltf_animation_path_type_rotation &&
+            keys.components == 4 && keys.sampler->output->component_type == cgltf_component_type_r_32f;
+        if (!keys.changed && !quantise) {
+            continue;
+        }
+        cgltf_animation_sampler* sampler = keys.sampler;
+        oldKeys += sampler->input->count;
+        newKeys += keys.times.size();
+
+        // Identical key times are shared between samplers
+        auto input = inputs.find(keys.times);
+        const cgltf_size inputSize = (input == inputs.end()) ? keys.times.size() * sizeof(cgltf_float) : 0;
+        const cgltf_size valueSize = quantise ? sizeof(int16_t) : sizeof(cgltf_float);
+        const cgltf_size outputSize = keys.values.size() * valueSize;
+        cgltf_buffer* buffer = cgltf_add_buffer(dataCGLTF.get(), inputSize + ((outputSize + 3) & ~cgltf_size(3)));
+        cgltf_buffer_view* views = (buffer != nullptr) ? cgltf_add_buffer_views(dataCGLTF.get(), 2) : nullptr;
+        cgltf_accessor* accessors = (views != nullptr) ? cgltf_add_accessors(dataCGLTF.get(), 2) : nullptr;
+        if (accessors == nullptr) {
+            printError("Out of memory"sv);
+            return false;
+        }
+        buffer = &dataCGLTF->buffers[dataCGLTF->buffers_count - 1];
+        uint8_t* bufferData = static_cast<uint8_t*>(buffer->data);
+        if (input == inputs.end()) {
+            memcpy(bufferData, keys.times.data(), inputSize);
+            views[0].buffer = buffer;
+            views[0].size = inputSize;
+            cgltf_accessor& accessor = accessors[0];
+            accessor.component_type = cgltf_component_type_r_32f;
+            accessor.type = cgltf_type_scalar;
+            accessor.count = keys.times.size();
+            accessor.stride = sizeof(cgltf_float);
+            accessor.buffer_view = &views[0];
+            accessor.has_min = true;
+            accessor.has_max = true;
+            accessor.min[0] = keys.times.front();
+            accessor.max[0] = keys.times.back();
+            input = inputs.emplace(keys.times, &accessor - dataCGLTF->accessors).first;
+        }
+        if (quantise) {
+            int16_t* output = reinterpret_cast<int16_t*>(bufferData + inputSize);
+            for (cgltf_size v = 0; v < keys.values.size(); ++v) {
+                output[v] = static_cast<int16_t>(roundf(std::clamp(keys.values[v], -1.0f, 1.0f) * 32767.0f));
+            }
+        } else {
+            memcpy(bufferData + inputSize, keys.values.data(), outputSize);
+        }
+        views[1].buffer = buffer;
+        views[1].offset = inputSize;
+        views[1].size = outputSize;
+        cgltf_accessor& accessor = accessors[1];
+        accessor.component_type = quantise ? cgltf_component_type_r_16 : cgltf_component_type_r_32f;
+        accessor.normalized = quantise;
+        accessor.type = sampler->output->type;
+        accessor.count = keys.values.size() / cgltf_num_components(accessor.type);
+        accessor.stride = valueSize * cgltf_num_components(accessor.type);
+        accessor.buffer_view = &views[1];
+
+        // Accessor list may have moved so the shared input is found using its stored index
+        sampler->input = &dataCGLTF->accessors[input->second];
+        sampler->output = &accessor;
+        buffersModified = true;
+    }
+    if (oldKeys != newKeys) {
+        printInfo("Removed redundant animation keys: "s + to_string(oldKeys) + " -> " + to_string(newKeys));
+    }
+
+    // Remove channels once all sampler data has been updated as removal moves channels and samplers
+    cgltf_size removedCount = 0;
+    for (cgltf_size i = 0; i < dataCGLTF->animations_count; ++i) {
+        cgltf_animation& animation = dataCGLTF->animations[i];
+        for (cgltf_size j = animation.channels_count; j-- > 0;) {
+            // Animations must keep at least one channel
+            cgltf_animation_channel* channel = &animation.channels[j];
+            if (!removedChannels.contains(channel) || animation.channels_count == 1) {
+                continue;
+            }
+            cgltf_free_extensions(dataCGLTF.get(), channel->extensions, channel->extensions_count);
+            memmove(channel, channel + 1, (animation.channels_count - j - 1) * sizeof(cgltf_animation_channel));
+            --animation.channels_count;
+            ++removedCount;
+        }
+        removeUnusedSamplers(animation);
+    }
+    if (removedCount > 0) {
+        printInfo("Removed constant animation channels: "s + to_string(removedCount));
+    }
+    return true;
+}
+
+void Optimiser::removeUnusedSamplers(cgltf_animation& animation) noexcept
+{
+    // Compact the samplers list and update channels to match
+    vector<cgltf_size> remap(animation.samplers_count, animation.samplers_count);
+    for (cgltf_size j = 0; j < animation.channels_count; ++j) {
+        if (animation.channels[j].sampler != nullptr) {
+            remap[animation.channels[j].sampler - animation.samplers] = 0;
+        }
+    }
+    cgltf_size newCount = 0;
+    for (cgltf_size j = 0; j < animation.samplers_count; ++j) {
+        if (remap[j] == animation.samplers_count) {
+            cgltf_free_extensions(dataCGLTF.get(), animation.samplers[j].extensions,
+                animation.samplers[j].extensions_count);
+            continue;
+        }
+        remap[j] = newCount;
+        if (newCount != j) {
+            animation.samplers[newCount] = animation.samplers[j];
+        }
+        ++newCount;
+    }
+    for (cgltf_size j = 0; j < animation.channels_count; ++j) {
+        if (animation.channels[j].sampler != nullptr) {
+            animation.channels[j].sampler = &animation.samplers[remap[animation.channels[j].sampler - animation.samplers]];
+        }
+    }
+    animation.samplers_count = newCount;
+}
+
+void Optimiser::removeEmptyAnimations() noexcept
+{
+    // Animations must have at least one channel
+    for (cgltf_size i = dataCGLTF->animations_count; i-- > 0;) {
+        cgltf_animation* animation = &dataCGLTF->animations[i];
+        if (animation->channels_count > 0) {
+            continue;
+        }
+        printWarning("Removed empty animation: "s + getName(*animation));
+        cgltf_remove_animation(dataCGLTF.get(), animation);
+        memmove(animation, animation + 1, (dataCGLTF->animations_count - i - 1) * sizeof(cgltf_animation));
+        --dataCGLTF->animations_count;
+        dataCGLTF->animations[dataCGLTF->animations_count] = {0};
+    }
+}
@@ -0,0 +1,156 @@
+/**
+ * Copyright Matthew Oliver
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "Optimiser.h"
+#include "Shared.h"
+#include "SharedCGLTF.h"
+
+#include <span>
+
+using namespace std;
+
+bool Optimiser::requireBuffers() noexcept
+{
+    if (buffersLoaded) {
+        return true;
+    }
+    buffersLoaded = loadBuffers();
+    return buffersLoaded;
+}
+
+bool Optimiser::loadBuffers() noexcept
+{
+    // External buffer files are memory mapped so that only the data actually accessed by a pass is read from disk
+    for (cgltf_size i = 0; i < dataCGLTF->buffers_count; ++i) {
+        cgltf_buffer& buffer = dataCGLTF->buffers[i];
+        if (buffer.data != nullptr || buffer.uri == nullptr || strncmp(buffer.uri, "data:", 5) == 0 ||
+            strstr(buffer.uri, "://") != nullptr) {
+            continue;
+        }
+        string uri = buffer.uri;
+        uri.resize(cgltf_decode_uri(uri.data()));
+        auto mapped = make_unique<MappedFile>();
+        if (!mapped->open(rootFolder + uri) || mapped->size() < buffer.size) {
+            // Leave the buffer for cgltf to load, which will also report any errors
+            continue;
+        }
+        buffer.data = mapped->data();
+        buffer.data_free_method = cgltf_data_free_method_none;
+        mappedBuffers.push_back(std::move(mapped));
+    }
+
+    // The binary chunk of a glb file was skipped when parsing so it is mapped directly from the input file
+    if (binChunkOffset > 0 && dataCGLTF->buffers_count > 0 && dataCGLTF->buffers[0].uri == nullptr &&
+        dataCGLTF->buffers[0].data == nullptr) {
+        cgltf_buffer& buffer = dataCGLTF->buffers[0];
+        auto mapped = make_unique<MappedFile>();
+        if (!mapped->open(sourceFile) || mapped->size() < binChunkOffset + buffer.size) {
+            printError("Failed to load input file binary chunk: "s + sourceFile);
+            return false;
+        }
+        buffer.data = static_cast<uint8_t*>(mapped->data()) + binChunkOffset;
+        buffer.data_free_method = cgltf_data_free_method_none;
+        mappedBuffers.push_back(std::move(mapped));
+    }
+
+    // Any remaining embedded buffers are loaded by cgltf
+    cgltf_options optionsCGLTF = {};
+    const cgltf_result result = cgltf_load_buffers(&optionsCGLTF, dataCGLTF.get(), sourceFile.c_str());
+    if (result != cgltf_result_success) {
+        printError("Failed to load input file buffers: "s + getCGLTFError(result, dataCGLTF));
+        return false;
+    }
+    return true;
+}
+
+bool Optimiser::passBuffers(const std::string& outputFile) noexcept
+{
+    // Only need to repack buffers if their contents have been changed
+    if (!buffersModified || dataCGLTF->buffer_views_count == 0) {
+        return true;
+    }
+    if (!requireBuffers()) {
+        return false;
+    }
+
+    // Check all buffer data is available for repacking
+    cgltf_size packedSize = 0;
+    for (cgltf_size i = 0; i < dataCGLTF->buffer_views_count; ++i) {
+        cgltf_buffer_view& view = dataCGLTF->buffer_views[i];
+        if (view.has_meshopt_compression) {
+            printError("Repacking meshopt compressed buffers is not supported"sv);
+            return false;
+        }
+        if (view.buffer == nullptr || view.buffer->data == nullptr) {
+            printError("Buffer data missing when repacking buffer view: "s + to_string(i));
+            return false;
+        }
+        // Buffer views are 4 byte aligned so that all accessor component types remain aligned
+        packedSize = ((packedSize + 3) & ~cgltf_size(3)) + view.size;
+    }
+
+    // Copy all used buffer view data into a single new buffer
+    uint8_t* packedData = static_cast<uint8_t*>(malloc(packedSize));
+    if (packedData == nullptr) {
+        printError("Out of memory"sv);
+        return false;
+    }
+    cgltf_size offset = 0;
+    for (cgltf_size i = 0; i < dataCGLTF->buffer_views_count; ++i) {
+        cgltf_buffer_view& view = dataCGLTF->buffer_views[i];
+        const cgltf_size alignedOffset = (offset + 3) & ~cgltf_size(3);
+        memset(packedData + offset, 0, alignedOffset - offset);
+        memcpy(packedData + alignedOffset, static_cast<const uint8_t*>(view.buffer->data) + view.offset, view.size);
+        view.offset = alignedOffset;
+        offset = alignedOffset + view.size;
+    }
+
+    // Replace all existing buffers with the new one
+    for (cgltf_size i = 0; i < dataCGLTF->buffers_count; ++i) {
+        cgltf_remove_buffer(dataCGLTF.get(), &dataCGLTF->buffers[i]);
+    }
+    dataCGLTF->buffers_count = 1;
+    cgltf_buffer& buffer = dataCGLTF->buffers[0];
+    buffer = {0};
+    buffer.data = packedData;
+    buffer.size = packedSize;
+    buffer.data_free_method = cgltf_data_free_method_memory_free;
+    runOverBuffers(*dataCGLTF, [&](cgltf_buffer*& p) { p = &buffer; });
+    dataCGLTF->bin = packedData;
+    dataCGLTF->bin_size = packedSize;
+
+    // Release mapped input buffers so that their files can be overwritten
+    mappedBuffers.clear();
+
+    // Get output buffer file location
+    const string outputFolder = getFolder(outputFile);
+    const string bufferFile = getSidecarFileName(outputFile, ".bin"sv);
+    buffer.uri = static_cast<char*>(malloc(bufferFile.length() + 1));
+    if (buffer.uri == nullptr) {
+        printError("Out of memory"sv);
+        return false;
+    }
+    std::strcpy(buffer.uri, bufferFile.data());
+
+    // Write out buffer data
+    printInfo("Writing output buffer file: "s + outputFolder + bufferFile);
+    if (!writeOutputFile(outputFolder, bufferFile, {span(packedData, packedSize)})) {
+        printError("Failed writing output buffer file: "s + outputFolder + bufferFile);
+        return false;
+    }
+    buffersModified = false;
+    return true;
+}
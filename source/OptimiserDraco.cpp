@@ -0,0 +1,495 @@
+/**
+ * Copyright Matthew Oliver
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "Optimiser.h"
+#include "Shared.h"
+#include "SharedCGLTF.h"
+
+#include <draco/compression/decode.h>
+#include <draco/compression/encode.h>
+#include <future>
+#include <vector>
+
+using namespace std;
+
+namespace {
+struct DracoPrimitive
+{
+    cgltf_primitive* prim = nullptr;
+    bool success = false;
+    string error;
+    vector<vector<uint8_t>> attributes; // decoded vertex streams (decode) or unused (encode)
+    vector<uint32_t> ids;               // draco attribute ids matching each primitive attribute
+    vector<uint8_t> data;               // decoded indices (decode) or compressed mesh (encode)
+    cgltf_size vertexCount = 0;
+};
+
+template<typename T>
+bool readDracoAttribute(
+    const draco::PointAttribute* attribute, cgltf_size vertexCount, cgltf_size components, uint8_t* data) noexcept
+{
+    const cgltf_size stride = (components * sizeof(T) + 3) & ~cgltf_size(3);
+    for (cgltf_size v = 0; v < vertexCount; ++v) {
+        const draco::AttributeValueIndex index = attribute->mapped_index(draco::PointIndex(static_cast<uint32_t>(v)));
+        if (!attribute->ConvertValue<T>(
+                index, static_cast<int8_t>(components), reinterpret_cast<T*>(data + v * stride))) {
+            return false;
+        }
+    }
+    return true;
+}
+
+draco::GeometryAttribute::Type getDracoType(cgltf_attribute_type type) noexcept
+{
+    switch (type) {
+        case cgltf_attribute_type_position:
+            return draco::GeometryAttribute::POSITION;
+        case cgltf_attribute_type_normal:
+            return draco::GeometryAttribute::NORMAL;
+        case cgltf_attribute_type_texcoord:
+            return draco::GeometryAttribute::TEX_COORD;
+        case cgltf_attribute_type_color:
+            return draco::GeometryAttribute::COLOR;
+        default:
+            return draco::GeometryAttribute::GENERIC;
+    }
+}
+
+draco::DataType getDracoDataType(cgltf_component_type type) noexcept
+{
+    switch (type) {
+        case cgltf_component_type_r_8:
+            return draco::DT_INT8;
+        case cgltf_component_type_r_8u:
+            return draco::DT_UINT8;
+        case cgltf_component_type_r_16:
+            return draco::DT_INT16;
+        case cgltf_component_type_r_16u:
+            return draco::DT_UINT16;
+        case cgltf_component_type_r_32u:
+            return draco::DT_UINT32;
+        case cgltf_component_type_r_32f:
+            return draco::DT_FLOAT32;
+        default:
+            return draco::DT_INVALID;
+    }
+}
+
+DracoPrimitive decodePrimitive(cgltf_data* data, cgltf_primitive* prim) noexcept
+{
+    DracoPrimitive ret;
+    ret.prim = prim;
+    const cgltf_draco_mesh_compression& draco = prim->draco_mesh_compression;
+    const cgltf_buffer_view* view = draco.buffer_view;
+    if (view == nullptr || view->buffer == nullptr || view->buffer->data == nullptr) {
+        ret.error = "Missing Draco compressed buffer data"s;
+        return ret;
+    }
+    if (prim->indices == nullptr) {
+        ret.error = "Draco compressed primitive has no indices accessor"s;
+        return ret;
+    }
+
+    draco::DecoderBuffer buffer;
+    buffer.Init(static_cast<const char*>(view->buffer->data) + view->offset, view->size);
+    draco::Decoder decoder;
+    auto decoded = decoder.DecodeMeshFromBuffer(&buffer);
+    if (!decoded.ok()) {
+        ret.error = "Failed to decode Draco mesh: "s + decoded.status().error_msg_string();
+        return ret;
+    }
+    const unique_ptr<draco::Mesh> mesh = std::move(decoded).value();
+    ret.vertexCount = mesh->num_points();
+
+    // Read each attribute in the format declared by its accessor
+    for (cgltf_size k = 0; k < prim->attributes_count; ++k) {
+        const cgltf_attribute& attribute = prim->attributes[k];
+        const cgltf_attribute* dracoAttribute = findAttribute(draco.attributes, draco.attributes_count, attribute);
+        if (dracoAttribute == nullptr) {
+            ret.error = "Draco compressed primitive is missing attribute: "s + attribute.name;
+            return ret;
+        }
+        // Draco attribute ids are stored by cgltf as offsets into the accessor list
+        const auto id = static_cast<uint32_t>(dracoAttribute->data - data->accessors);
+        const draco::PointAttribute* pointAttribute = mesh->GetAttributeByUniqueId(id);
+        if (pointAttribute == nullptr) {
+            ret.error = "Invalid Draco attribute id: "s + to_string(id);
+            return ret;
+        }
+        const cgltf_accessor* accessor = attribute.data;
+        const cgltf_size components = cgltf_num_components(accessor->type);
+        const cgltf_size stride = (getElementSize(accessor) + 3) & ~cgltf_size(3);
+        vector<uint8_t> stream(stride * ret.vertexCount, 0);
+        bool read = false;
+        switch (accessor->component_type) {
+            case cgltf_component_type_r_8:
+                read = readDracoAttribute<int8_t>(pointAttribute, ret.vertexCount, components, stream.data());
+                break;
+            case cgltf_component_type_r_8u:
+                read = readDracoAttribute<uint8_t>(pointAttribute, ret.vertexCount, components, stream.data());
+                break;
+            case cgltf_component_type_r_16:
+                read = readDracoAttribute<int16_t>(pointAttribute, ret.vertexCount, components, stream.data());
+                break;
+            case cgltf_component_type_r_16u:
+                read = readDracoAttribute<uint16_t>(pointAttribute, ret.vertexCount, components, stream.data());
+                break;
+            case cgltf_component_type_r_32u:
+                read = readDracoAttribute<uint32_t>(pointAttribute, ret.vertexCount, components, stream.data());
+                break;
+            case cgltf_component_type_r_32f:
+                read = readDracoAttribute<float>(pointAttribute, ret.vertexCount, components, stream.data());
+                break;
+            default:
+                break;
+        }
+        if (!read) {
+            ret.error = "Failed to read Draco attribute: "s + attribute.name;
+            return ret;
+        }
+        ret.attributes.push_back(std::move(stream));
+        ret.ids.push_back(id);
+    }
+
+    // Read triangle indices using the smallest suitable index type
+    const cgltf_component_type indexType = getIndexType(ret.vertexCount);
+    ret.data.resize(static_cast<cgltf_size>(mesh->num_faces()) * 3 * getComponentSize(indexType));
+    cgltf_size index = 0;
+    for (uint32_t f = 0; f < mesh->num_faces(); ++f) {
+        const draco::Mesh::Face& face = mesh->face(draco::FaceIndex(f));
+        for (auto& point : face) {
+            writeIndex(ret.data.data(), indexType, index++, point.value());
+        }
+    }
+    ret.success = true;
+    return ret;
+}
+
+bool canEncode(const cgltf_primitive& prim) noexcept
+{
+    // Only plain triangle meshes are supported, morph targets rely on vertex order which draco does not guarantee
+    if (prim.type != cgltf_primitive_type_triangles || prim.has_draco_mesh_compression || prim.targets_count > 0 ||
+        prim.attributes_count == 0) {
+        return false;
+    }
+    if (prim.indices != nullptr && getAccessorData(prim.indices) == nullptr) {
+        return false;
+    }
+    for (cgltf_size k = 0; k < prim.attributes_count; ++k) {
+        const cgltf_accessor* accessor = prim.attributes[k].data;
+        if (getAccessorData(accessor) == nullptr || getDracoDataType(accessor->component_type) == draco::DT_INVALID ||
+            accessor->count != prim.attributes[0].data->count) {
+            return false;
+        }
+    }
+    return true;
+}
+
+DracoPrimitive encodePrimitive(cgltf_primitive* prim) noexcept
+{
+    DracoPrimitive ret;
+    ret.prim = prim;
+    ret.vertexCount = prim->attributes[0].data->count;
+
+    // Build draco mesh using the existing vertex order
+    draco::Mesh mesh;
+    mesh.set_num_points(static_cast<uint32_t>(ret.vertexCount));
+    for (cgltf_size k = 0; k < prim->attributes_count; ++k) {
+        const cgltf_accessor* accessor = prim->attributes[k].data;
+        const uint8_t* source = getAccessorData(accessor);
+        draco::GeometryAttribute attribute;
+        attribute.Init(getDracoType(prim->attributes[k].type), nullptr,
+            static_cast<uint8_t>(cgltf_num_components(accessor->type)), getDracoDataType(accessor->component_type),
+            accessor->normalized, static_cast<int64_t>(getElementSize(accessor)), 0);
+        const int id = mesh.AddAttribute(attribute, true, static_cast<uint32_t>(ret.vertexCount));
+        draco::PointAttribute* pointAttribute = mesh.attribute(id);
+        for (cgltf_size v = 0; v < ret.vertexCount; ++v) {
+            pointAttribute->SetAttributeValue(
+                draco::AttributeValueIndex(static_cast<uint32_t>(v)), source + v * accessor->stride);
+        }
+        ret.ids.push_back(pointAttribute->unique_id());
+    }
+    const cgltf_size indexCount = (prim->indices != nullptr) ? prim->indices->count : ret.vertexCount;
+    for (cgltf_size i = 0; i + 2 < indexCount; i += 3) {
+        draco::Mesh::Face face;
+        for (cgltf_size j = 0; j < 3; ++j) {
+            const cgltf_size index = (prim->indices != nullptr) ? cgltf_accessor_read_index(prim->indices, i + j) : i + j;
+            face[j] = draco::PointIndex(static_cast<uint32_t>(index));
+        }
+        mesh.AddFace(face);
+    }
+
+    // Sequential encoding keeps the vertex order so existing accessor counts remain valid
+    draco::Encoder encoder;
+    encoder.SetEncodingMethod(draco::MESH_SEQUENTIAL_ENCODING);
+    encoder.SetAttributeQuantization(draco::GeometryAttribute::POSITION, 14);
+    encoder.SetAttributeQuantization(draco::GeometryAttribute::NORMAL, 10);
+    encoder.SetAttributeQuantization(draco::GeometryAttribute::TEX_COORD, 12);
+    encoder.SetAttributeQuantization(draco::GeometryAttribute::COLOR, 10);
+    encoder.SetAttributeQuantization(draco::GeometryAttribute::GENERIC, 12);
+    draco::EncoderBuffer buffer;
+    const draco::Status status = encoder.EncodeMeshToBuffer(mesh, &buffer);
+    if (!status.ok()) {
+        ret.error = "Failed to encode Draco mesh: "s + status.error_msg_string();
+        return ret;
+    }
+    const uint8_t* encoded = reinterpret_cast<const uint8_t*>(buffer.data());
+    ret.data.assign(encoded, encoded + buffer.size());
+    ret.success = true;
+    return ret;
+}
+
+void freeDracoCompression(cgltf_primitive& prim) noexcept
+{
+    cgltf_draco_mesh_compression& draco = prim.draco_mesh_compression;
+    for (cgltf_size k = 0; k < draco.attributes_count; ++k) {
+        free(draco.attributes[k].name);
+    }
+    free(draco.attributes);
+    draco = {0};
+    prim.has_draco_mesh_compression = false;
+}
+} // namespace
+
+bool Optimiser::passDracoDecode() noexcept
+{
+    // Decode all compressed primitives in parallel
+    vector<future<DracoPrimitive>> jobs;
+    for (cgltf_size i = 0; i < dataCGLTF->meshes_count; ++i) {
+        cgltf_mesh& mesh = dataCGLTF->meshes[i];
+        for (cgltf_size j = 0; j < mesh.primitives_count; ++j) {
+            cgltf_primitive* prim = &mesh.primitives[j];
+            if (!prim->has_draco_mesh_compression) {
+                continue;
+            }
+            // Primitives that also provide uncompressed fallback data don't need decoding
+            bool fallback = prim->indices == nullptr || getAccessorData(prim->indices) != nullptr;
+            for (cgltf_size k = 0; k < prim->attributes_count; ++k) {
+                fallback = fallback && getAccessorData(prim->attributes[k].data) != nullptr;
+            }
+            if (fallback) {
+                freeDracoCompression(*prim);
+                continue;
+            }
+            jobs.push_back(pool.submit(decodePrimitive, dataCGLTF.get(), prim));
+        }
+    }
+    if (jobs.empty()) {
+        return true;
+    }
+    printInfo("Decoding Draco compressed primitives: "s + to_string(jobs.size()));
+    vector<DracoPrimitive> decoded;
+    for (auto& job : jobs) {
+        decoded.push_back(job.get());
+    }
+
+    // Replace the placeholder accessors with new ones that reference the decoded data
+    for (auto& result : decoded) {
+        if (!result.success) {
+            printError(result.error);
+            return false;
+        }
+        cgltf_primitive& prim = *result.prim;
+        cgltf_size bufferSize = 0;
+        for (auto& stream : result.attributes) {
+            bufferSize += stream.size();
+        }
+        const cgltf_size indexOffset = bufferSize;
+        bufferSize += result.data.size();
+
+        cgltf_buffer* buffer = cgltf_add_buffer(dataCGLTF.get(), bufferSize);
+        cgltf_buffer_view* views =
+            (buffer != nullptr) ? cgltf_add_buffer_views(dataCGLTF.get(), prim.attributes_count + 1) : nullptr;
+        cgltf_accessor* accessors =
+            (views != nullptr) ? cgltf_add_accessors(dataCGLTF.get(), prim.attributes_count + 1) : nullptr;
+        if (accessors == nullptr) {
+            printError("Out of memory"sv);
+            return false;
+        }
+        buffer = &dataCGLTF->buffers[dataCGLTF->buffers_count - 1];
+        uint8_t* bufferData = static_cast<uint8_t*>(buffer->data);
+        cgltf_size offset = 0;
+        for (cgltf_size k = 0; k < prim.attributes_count; ++k) {
+            const cgltf_accessor* placeholder = prim.attributes[k].data;
+            const vector<uint8_t>& stream = result.attributes[k];
+            memcpy(bufferData + offset, stream.data(), stream.size());
+            cgltf_buffer_view& view = views[k];
+            view.buffer = buffer;
+            view.offset = offset;
+            view.size = stream.size();
+            view.stride = (getElementSize(placeholder) + 3) & ~cgltf_size(3);
+            view.type = cgltf_buffer_view_type_vertices;
+            cgltf_accessor& accessor = accessors[k];
+            accessor.component_type = placeholder->component_type;
+            accessor.normalized = placeholder->normalized;
+            accessor.type = placeholder->type;
+            accessor.count = result.vertexCount;
+            accessor.stride = view.stride;
+            accessor.buffer_view = &view;
+            accessor.has_min = placeholder->has_min;
+            accessor.has_max = placeholder->has_max;
+            memcpy(accessor.min, placeholder->min, sizeof(accessor.min));
+            memcpy(accessor.max, placeholder->max, sizeof(accessor.max));
+            prim.attributes[k].data = &accessor;
+            offset += stream.size();
+        }
+        memcpy(bufferData + indexOffset, result.data.data(), result.data.size());
+        const cgltf_component_type indexType = getIndexType(result.vertexCount);
+        cgltf_buffer_view& indexView = views[prim.attributes_count];
+        indexView.buffer = buffer;
+        indexView.offset = indexOffset;
+        indexView.size = result.data.size();
+        indexView.type = cgltf_buffer_view_type_indices;
+        cgltf_accessor& indexAccessor = accessors[prim.attributes_count];
+        indexAccessor.component_type = indexType;
+        indexAccessor.type = cgltf_type_scalar;
+        indexAccessor.count = result.data.size() / getComponentSize(indexType);
+        indexAccessor.stride = getComponentSize(indexType);
+        indexAccessor.buffer_view = &indexView;
+        prim.indices = &indexAccessor;
+
+        freeDracoCompression(prim);
+    }
+    // Placeholder accessors and compressed data are now unused and will be removed by the unused pass
+    buffersModified = true;
+    return true;
+}
+
+bool Optimiser::passDracoEncode() noexcept
+{
+    // Encode all supported primitives in parallel
+    vector<future<DracoPrimitive>> jobs;
+    for (cgltf_size i = 0; i < dataCGLTF->meshes_count; ++i) {
+        cgltf_mesh& mesh = dataCGLTF->meshes[i];
+        for (cgltf_size j = 0; j < mesh.primitives_count; ++j) {
+            cgltf_primitive* prim = &mesh.primitives[j];
+            if (canEncode(*prim)) {
+                jobs.push_back(pool.submit(encodePrimitive, prim));
+            }
+        }
+    }
+    if (jobs.empty()) {
+        return true;
+    }
+    printInfo("Draco compressing primitives: "s + to_string(jobs.size()));
+    vector<DracoPrimitive> encoded;
+    for (auto& job : jobs) {
+        auto result = job.get();
+        if (!result.success) {
+            printWarning(result.error);
+            continue;
+        }
+        encoded.push_back(std::move(result));
+    }
+    if (encoded.empty()) {
+        return true;
+    }
+
+    // Store all compressed data in a single new buffer
+    cgltf_size bufferSize = 0;
+    cgltf_size accessorCount = 0;
+    for (auto& result : encoded) {
+        bufferSize = ((bufferSize + 3) & ~cgltf_size(3)) + result.data.size();
+        accessorCount += result.prim->attributes_count + 1;
+    }
+    cgltf_buffer* buffer = cgltf_add_buffer(dataCGLTF.get(), bufferSize);
+    cgltf_buffer_view* views = (buffer != nullptr) ? cgltf_add_buffer_views(dataCGLTF.get(), encoded.size()) : nullptr;
+    cgltf_accessor* accessors = (views != nullptr) ? cgltf_add_accessors(dataCGLTF.get(), accessorCount) : nullptr;
+    if (accessors == nullptr) {
+        printError("Out of memory"sv);
+        return false;
+    }
+    buffer = &dataCGLTF->buffers[dataCGLTF->buffers_count - 1];
+    uint8_t* bufferData = static_cast<uint8_t*>(buffer->data);
+    cgltf_size offset = 0;
+    for (cgltf_size e = 0; e < encoded.size(); ++e) {
+        DracoPrimitive& result = encoded[e];
+        cgltf_primitive& prim = *result.prim;
+        offset = (offset + 3) & ~cgltf_size(3);
+        memcpy(bufferData + offset, result.data.data(), result.data.size());
+        cgltf_buffer_view& view = views[e];
+        view.buffer = buffer;
+        view.offset = offset;
+        view.size = result.data.size();
+        offset += result.data.size();
+
+        // Replace the primitive's accessors with new ones that have no buffer data, any shared originals are kept
+        // while still in use elsewhere
+        auto replaceAccessor = [&](cgltf_accessor*& original) {
+            cgltf_accessor& accessor = *accessors++;
+            accessor.component_type = original->component_type;
+            accessor.normalized = original->normalized;
+            accessor.type = original->type;
+            accessor.count = original->count;
+            accessor.stride = original->stride;
+            accessor.has_min = original->has_min;
+            accessor.has_max = original->has_max;
+            memcpy(accessor.min, original->min, sizeof(accessor.min));
+            memcpy(accessor.max, original->max, sizeof(accessor.max));
+            original = &accessor;
+        };
+        for (cgltf_size k = 0; k < prim.attributes_count; ++k) {
+            replaceAccessor(prim.attributes[k].data);
+        }
+        if (prim.indices != nullptr) {
+            replaceAccessor(prim.indices);
+        } else {
+            cgltf_accessor& accessor = *accessors++;
+            const cgltf_component_type indexType = getIndexType(result.vertexCount);
+            accessor.component_type = indexType;
+            accessor.type = cgltf_type_scalar;
+            accessor.count = result.vertexCount - (result.vertexCount % 3);
+            accessor.stride = getComponentSize(indexType);
+            prim.indices = &accessor;
+        }
+
+        // Draco attribute accessor pointers are filled in once accessors are no longer being moved
+        cgltf_draco_mesh_compression& draco = prim.draco_mesh_compression;
+        draco.attributes = static_cast<cgltf_attribute*>(calloc(prim.attributes_count, sizeof(cgltf_attribute)));
+        if (draco.attributes == nullptr) {
+            printError("Out of memory"sv);
+            return false;
+        }
+        draco.attributes_count = prim.attributes_count;
+        for (cgltf_size k = 0; k < prim.attributes_count; ++k) {
+            draco.attributes[k].name = static_cast<char*>(malloc(strlen(prim.attributes[k].name) + 1));
+            if (draco.attributes[k].name == nullptr) {
+                printError("Out of memory"sv);
+                return false;
+            }
+            std::strcpy(draco.attributes[k].name, prim.attributes[k].name);
+            draco.attributes[k].type = prim.attributes[k].type;
+            draco.attributes[k].index = prim.attributes[k].index;
+        }
+        draco.buffer_view = &view;
+        prim.has_draco_mesh_compression = true;
+    }
+    buffersModified = true;
+
+    // Remove the now unused uncompressed data
+    checkUnusedAccessors();
+    checkUnusedBufferViews();
+    checkUnusedBuffers();
+
+    // cgltf stores draco attribute ids as offsets into the accessor list
+    for (auto& result : encoded) {
+        cgltf_draco_mesh_compression& draco = result.prim->draco_mesh_compression;
+        for (cgltf_size k = 0; k < draco.attributes_count; ++k) {
+            draco.attributes[k].data = dataCGLTF->accessors + result.ids[k];
+        }
+    }
+    return true;
+}
@@ -20,6 +20,8 @@
 
 #include <map>
 #include <ranges>
+#include <tuple>
+#include <vector>
 
 using namespace std;
 
@@ -148,9 +150,109 @@ void Optimiser::checkDuplicateMaterials() noexcept
     }
 }
 
+void Optimiser::checkDuplicateAccessors() noexcept
+{
+    // Accessors can only be compared once their data has been loaded
+    if (!buffersLoaded) {
+        return;
+    }
+
+    // Bucket accessors by a hash of their contents so only likely matches need to be compared, the buffer view target
+    // and stride are part of the key as index and vertex data can not share a buffer view
+    map<tuple<cgltf_buffer_view_type, cgltf_size, uint64_t>, vector<cgltf_accessor*>> accessorHashes;
+    for (cgltf_size i = 0; i < dataCGLTF->accessors_count; ++i) {
+        cgltf_accessor* accessor = &dataCGLTF->accessors[i];
+        const uint8_t* data = getAccessorData(accessor);
+        if (data == nullptr) {
+            continue;
+        }
+        // FNV-1a
+        uint64_t hash = 14695981039346656037ULL;
+        const cgltf_size elementSize = getElementSize(accessor);
+        for (cgltf_size j = 0; j < accessor->count; ++j) {
+            for (cgltf_size k = 0; k < elementSize; ++k) {
+                hash = (hash ^ data[j * accessor->stride + k]) * 1099511628211ULL;
+            }
+        }
+        const cgltf_buffer_view* view = accessor->buffer_view;
+        const cgltf_buffer_view_type type = (view != nullptr) ? view->type : cgltf_buffer_view_type_invalid;
+        const cgltf_size stride = (view != nullptr) ? view->stride : 0;
+        accessorHashes[{type, stride, hash}].push_back(accessor);
+    }
+
+    // Check for duplicate accessors
+    map<cgltf_accessor*, cgltf_accessor*> accessorDuplicates;
+    for (auto& bucket : accessorHashes | views::values) {
+        for (size_t i = 0; i < bucket.size(); ++i) {
+            cgltf_accessor* accessor = bucket[i];
+            if (accessorDuplicates.contains(accessor)) {
+                continue;
+            }
+            for (size_t j = i + 1; j < bucket.size(); ++j) {
+                cgltf_accessor* accessor2 = bucket[j];
+                if (!accessorDuplicates.contains(accessor2) && *accessor == *accessor2) {
+                    accessorDuplicates[accessor2] = accessor;
+                }
+            }
+        }
+    }
+    // Update all users to remove duplicate accessors
+    runOverAccessors(*dataCGLTF, [&](cgltf_accessor*& p) {
+        if (auto pos = accessorDuplicates.find(p); pos != accessorDuplicates.end()) {
+            p = pos->second;
+        }
+    });
+    // Remove duplicate accessors
+    for (auto& i : accessorDuplicates | views::reverse) {
+        auto current = i.first;
+        removeAccessor(current);
+        // Update pointers for move
+        for (auto& j : accessorDuplicates) {
+            if (j.second > current) {
+                j.second = j.second - 1;
+            }
+        }
+    }
+    if (!accessorDuplicates.empty()) {
+        printInfo("Removed duplicate accessors: "s + to_string(accessorDuplicates.size()));
+    }
+}
+
 void Optimiser::checkDuplicateMeshes() noexcept
 {
-    // TODO
+    // Check for duplicate meshes
+    map<cgltf_mesh*, cgltf_mesh*> meshDuplicates;
+    for (cgltf_size i = 0; i < dataCGLTF->meshes_count; ++i) {
+        cgltf_mesh* mesh = &dataCGLTF->meshes[i];
+        if (meshDuplicates.contains(mesh)) {
+            continue;
+        }
+        for (cgltf_size j = i + 1; j < dataCGLTF->meshes_count; ++j) {
+            cgltf_mesh* mesh2 = &dataCGLTF->meshes[j];
+            if (!meshDuplicates.contains(mesh2) && *mesh == *mesh2) {
+                meshDuplicates[mesh2] = mesh;
+            }
+        }
+    }
+    // Update nodes to remove duplicate meshes
+    runOverMeshes(*dataCGLTF, [&](cgltf_mesh*& p) {
+        if (auto pos = meshDuplicates.find(p); pos != meshDuplicates.end()) {
+            p = pos->second;
+        }
+    });
+    // Remove duplicate meshes
+    for (auto& i : meshDuplicates | views::reverse) {
+        auto current = i.first;
+        auto current2 = i.second;
+        printWarning("Removed duplicate mesh: "s + getName(*current) + ", " + getName(*current2));
+        removeMesh(current);
+        // Update pointers for move
+        for (auto& j : meshDuplicates) {
+            if (j.second > current) {
+                j.second = j.second - 1;
+            }
+        }
+    }
 }
 
 void Optimiser::passDuplicate() noexcept
@@ -159,5 +261,6 @@ void Optimiser::passDuplicate() noexcept
     checkDuplicateImages();
     checkDuplicateTextures();
     checkDuplicateMaterials();
+    checkDuplicateAccessors();
     checkDuplicateMeshes();
 }
@@ -0,0 +1,207 @@
+/**
+ * Copyright Matthew Oliver
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "Optimiser.h"
+#include "Shared.h"
+#include "SharedCGLTF.h"
+
+#include <map>
+#include <ranges>
+#include <set>
+#include <vector>
+
+using namespace std;
+
+namespace {
+bool canBake(const cgltf_mesh& mesh) noexcept
+{
+    // Morph targets are applied in object space so cannot be pre-transformed
+    if (mesh.weights_count != 0) {
+        return false;
+    }
+    auto checkFormat = [](const cgltf_attribute* attribute, cgltf_type type) {
+        return attribute == nullptr ||
+            (attribute->data->component_type == cgltf_component_type_r_32f && attribute->data->type == type);
+    };
+    for (cgltf_size i = 0; i < mesh.primitives_count; ++i) {
+        const cgltf_primitive& prim = mesh.primitives[i];
+        if (!canMerge(prim) || prim.targets_count != 0) {
+            return false;
+        }
+        // Transformed attributes must be stored as floats
+        const cgltf_attribute* position = findAttribute(prim, cgltf_attribute_type_position);
+        if (position == nullptr || !checkFormat(position, cgltf_type_vec3) ||
+            !checkFormat(findAttribute(prim, cgltf_attribute_type_normal), cgltf_type_vec3) ||
+            !checkFormat(findAttribute(prim, cgltf_attribute_type_tangent), cgltf_type_vec4)) {
+            return false;
+        }
+    }
+    return true;
+}
+} // namespace
+
+bool Optimiser::passFlatten() noexcept
+{
+    if (dataCGLTF->scenes_count != 1) {
+        printWarning("Static node flattening is only supported for files containing a single scene"sv);
+        return true;
+    }
+
+    // Find all nodes in the scene hierarchy that are not animated
+    cgltf_scene& scene = dataCGLTF->scenes[0];
+    vector<cgltf_node*> staticNodes = getStaticNodes(*dataCGLTF, scene);
+
+    // Meshes shared between several nodes are left alone as baking would duplicate their data
+    map<cgltf_mesh*, cgltf_size> meshUsage;
+    for (cgltf_size i = 0; i < dataCGLTF->nodes_count; ++i) {
+        ++meshUsage[dataCGLTF->nodes[i].mesh];
+    }
+    vector<cgltf_node*> bakedNodes;
+    for (auto& node : staticNodes) {
+        if (node->mesh != nullptr && meshUsage[node->mesh] == 1 && node->weights_count == 0 && canBake(*node->mesh)) {
+            bakedNodes.push_back(node);
+        }
+    }
+    if (bakedNodes.size() < 2) {
+        return true;
+    }
+
+    // Group all primitives by material and layout along with their world transforms
+    vector<vector<cgltf_primitive*>> groups;
+    vector<vector<array<cgltf_float, 16>>> groupTransforms;
+    for (auto& node : bakedNodes) {
+        array<cgltf_float, 16> transform;
+        cgltf_node_transform_world(node, transform.data());
+        for (cgltf_size j = 0; j < node->mesh->primitives_count; ++j) {
+            cgltf_primitive* prim = &node->mesh->primitives[j];
+            bool found = false;
+            for (cgltf_size k = 0; k < groups.size(); ++k) {
+                if (isCompatible(*groups[k].front(), *prim)) {
+                    groups[k].push_back(prim);
+                    groupTransforms[k].push_back(transform);
+                    found = true;
+                    break;
+                }
+            }
+            if (!found) {
+                groups.push_back({prim});
+                groupTransforms.push_back({transform});
+            }
+        }
+    }
+
+    // Create a new mesh containing a single primitive for each group
+    cgltf_mesh* mesh = cgltf_add_meshes(dataCGLTF.get(), 1);
+    if (mesh == nullptr) {
+        printError("Out of memory"sv);
+        return false;
+    }
+    const cgltf_size meshPos = mesh - dataCGLTF->meshes;
+    string_view meshName = "flattened"sv;
+    mesh->name = static_cast<char*>(malloc(meshName.length() + 1));
+    mesh->primitives = static_cast<cgltf_primitive*>(calloc(groups.size(), sizeof(cgltf_primitive)));
+    if (mesh->name == nullptr || mesh->primitives == nullptr) {
+        printError("Out of memory"sv);
+        return false;
+    }
+    std::strcpy(mesh->name, meshName.data());
+    mesh->primitives_count = groups.size();
+    for (cgltf_size i = 0; i < groups.size(); ++i) {
+        const cgltf_primitive& base = *groups[i].front();
+        cgltf_primitive& prim = mesh->primitives[i];
+        prim.type = base.type;
+        prim.material = base.material;
+        prim.attributes = static_cast<cgltf_attribute*>(calloc(base.attributes_count, sizeof(cgltf_attribute)));
+        if (prim.attributes == nullptr) {
+            printError("Out of memory"sv);
+            return false;
+        }
+        for (cgltf_size j = 0; j < base.attributes_count; ++j) {
+            prim.attributes[j].name = static_cast<char*>(malloc(strlen(base.attributes[j].name) + 1));
+            if (prim.attributes[j].name == nullptr) {
+                printError("Out of memory"sv);
+                return false;
+            }
+            std::strcpy(prim.attributes[j].name, base.attributes[j].name);
+            prim.attributes[j].type = base.attributes[j].type;
+            prim.attributes[j].index = base.attributes[j].index;
+            ++prim.attributes_count;
+        }
+        if (!concatenatePrimitives(prim, groups[i], groupTransforms[i])) {
+            return false;
+        }
+    }
+
+    // Detach baked meshes and collapse any nodes that are left empty
+    set<cgltf_node*> removedNodes;
+    set<cgltf_mesh*> bakedMeshes;
+    for (auto& node : bakedNodes) {
+        bakedMeshes.insert(node->mesh);
+        node->mesh = nullptr;
+    }
+    auto isEmpty = [&](cgltf_node* node) {
+        if (node->mesh != nullptr || node->camera != nullptr || node->light != nullptr || node->skin != nullptr ||
+            node->extensions_count != 0) {
+            return false;
+        }
+        for (cgltf_size i = 0; i < node->children_count; ++i) {
+            if (!removedNodes.contains(node->children[i])) {
+                return false;
+            }
+        }
+        return true;
+    };
+    for (auto& node : bakedNodes) {
+        if (isEmpty(node)) {
+            removedNodes.insert(node);
+        }
+    }
+    // Parents are only removed if they have been emptied by removing their children
+    for (auto& node : staticNodes | views::reverse) {
+        if (node->children_count != 0 && isEmpty(node)) {
+            removedNodes.insert(node);
+        }
+    }
+    for (auto& i : removedNodes | views::reverse) {
+        removeNode(i);
+    }
+
+    // Add new node containing the flattened mesh to the scene root
+    cgltf_node* node = cgltf_add_nodes(dataCGLTF.get(), 1);
+    auto newMemory = static_cast<cgltf_node**>(realloc(scene.nodes, (scene.nodes_count + 1) * sizeof(cgltf_node*)));
+    if (node == nullptr || newMemory == nullptr) {
+        printError("Out of memory"sv);
+        return false;
+    }
+    scene.nodes = newMemory;
+    scene.nodes[scene.nodes_count] = node;
+    ++scene.nodes_count;
+    node->mesh = &dataCGLTF->meshes[meshPos];
+    node->name = static_cast<char*>(malloc(meshName.length() + 1));
+    if (node->name != nullptr) {
+        std::strcpy(node->name, meshName.data());
+    }
+
+    // Baked meshes were only used by their own node so are no longer referenced, they are removed here rather than
+    // relying on a later pass so that their geometry is not optimised and written out alongside the flattened copy
+    for (auto& i : bakedMeshes | views::reverse) {
+        removeMesh(i);
+    }
+
+    printInfo("Flattened static nodes: "s + to_string(bakedNodes.size()) + " meshes into " +
+        to_string(groups.size()) + " primitives, " + to_string(removedNodes.size()) + " nodes removed");
+    return true;
+}
@@ -0,0 +1,181 @@
+/**
+ * Copyright Matthew Oliver
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "GLTFWriter.h"
+#include "Optimiser.h"
+#include "Shared.h"
+#include "SharedCGLTF.h"
+
+#include <algorithm>
+#include <cctype>
+#include <cstring>
+#include <filesystem>
+#include <span>
+#include <vector>
+
+using namespace std;
+
+namespace {
+const char* getMimeType(const string& uri) noexcept
+{
+    const size_t fileExt = uri.rfind('.');
+    if (fileExt == string::npos) {
+        return nullptr;
+    }
+    string extension = uri.substr(fileExt + 1);
+    ranges::transform(extension, extension.begin(), [](char c) { return static_cast<char>(tolower(c)); });
+    if (extension == "ktx2") {
+        return "image/ktx2";
+    } else if (extension == "png") {
+        return "image/png";
+    } else if (extension == "jpg" || extension == "jpeg") {
+        return "image/jpeg";
+    } else if (extension == "webp") {
+        return "image/webp";
+    }
+    return nullptr;
+}
+} // namespace
+
+bool Optimiser::passGLB(const std::string& outputFile) noexcept
+{
+    if (!requireBuffers()) {
+        return false;
+    }
+
+    // Mapped input data can not be streamed into the file that it is mapped from
+    if (error_code ec; memoryOutput == nullptr && filesystem::equivalent(outputFile, sourceFile, ec)) {
+        for (cgltf_size i = 0; i < dataCGLTF->buffers_count; ++i) {
+            cgltf_buffer& buffer = dataCGLTF->buffers[i];
+            if (buffer.data == nullptr || buffer.data_free_method != cgltf_data_free_method_none) {
+                continue;
+            }
+            void* data = malloc(buffer.size);
+            if (data == nullptr) {
+                printError("Out of memory"sv);
+                return false;
+            }
+            memcpy(data, buffer.data, buffer.size);
+            buffer.data = data;
+            buffer.data_free_method = cgltf_data_free_method_memory_free;
+        }
+        mappedBuffers.clear();
+    }
+
+    // Find the data for each image to embed, either from compressed textures in memory or from existing image files
+    vector<span<const uint8_t>> imageData(dataCGLTF->images_count);
+    for (auto& embedded : embeddedImages) {
+        if (!embedded->data.empty()) {
+            imageData[embedded->image] = embedded->data;
+        }
+    }
+    vector<unique_ptr<MappedFile>> imageFiles;
+    for (cgltf_size i = 0; i < dataCGLTF->images_count; ++i) {
+        cgltf_image& image = dataCGLTF->images[i];
+        if (image.buffer_view != nullptr || image.uri == nullptr || strncmp(image.uri, "data:", 5) == 0 ||
+            strstr(image.uri, "://") != nullptr) {
+            imageData[i] = {};
+            continue;
+        }
+        string uri = image.uri;
+        uri.resize(cgltf_decode_uri(uri.data()));
+        if (image.mime_type == nullptr) {
+            const char* mimeType = getMimeType(uri);
+            image.mime_type = (mimeType != nullptr) ? static_cast<char*>(malloc(strlen(mimeType) + 1)) : nullptr;
+            if (image.mime_type == nullptr) {
+                printWarning("Unknown image type, keeping external image file: "s + uri);
+                imageData[i] = {};
+                continue;
+            }
+            strcpy(image.mime_type, mimeType);
+        }
+        if (imageData[i].empty()) {
+            auto mapped = make_unique<MappedFile>();
+            if (!mapped->open(rootFolder + uri)) {
+                printWarning("Failed to open image, keeping external image file: "s + uri);
+                continue;
+            }
+            imageData[i] = span(static_cast<const uint8_t*>(mapped->data()), mapped->size());
+            imageFiles.push_back(std::move(mapped));
+        }
+    }
+
+    // Images are stored in new buffer views after all existing geometry data
+    const cgltf_size imageCount = ranges::count_if(imageData, [](auto& data) { return !data.empty(); });
+    const cgltf_size firstImageView = dataCGLTF->buffer_views_count;
+    if (imageCount > 0) {
+        cgltf_buffer_view* views = cgltf_add_buffer_views(dataCGLTF.get(), imageCount);
+        if (views == nullptr) {
+            printError("Out of memory"sv);
+            return false;
+        }
+        for (cgltf_size i = 0; i < dataCGLTF->images_count; ++i) {
+            if (imageData[i].empty()) {
+                continue;
+            }
+            cgltf_image& image = dataCGLTF->images[i];
+            views->size = imageData[i].size();
+            image.buffer_view = views++;
+            free(image.uri);
+            image.uri = nullptr;
+        }
+        erase_if(imageData, [](auto& data) { return data.empty(); });
+    }
+
+    // Lay out all buffer views in a single 4 byte aligned binary chunk
+    cgltf_buffer buffer = {0};
+    vector<span<const uint8_t>> binary;
+    binary.reserve(dataCGLTF->buffer_views_count);
+    cgltf_size offset = 0;
+    for (cgltf_size i = 0; i < dataCGLTF->buffer_views_count; ++i) {
+        cgltf_buffer_view& view = dataCGLTF->buffer_views[i];
+        if (i >= firstImageView) {
+            binary.push_back(imageData[i - firstImageView]);
+        } else if (view.has_meshopt_compression) {
+            printError("Repacking meshopt compressed buffers is not supported"sv);
+            return false;
+        } else if (view.buffer == nullptr || view.buffer->data == nullptr) {
+            printError("Buffer data missing when repacking buffer view: "s + to_string(i));
+            return false;
+        } else {
+            binary.emplace_back(static_cast<const uint8_t*>(view.buffer->data) + view.offset, view.size);
+        }
+        offset = (offset + 3) & ~cgltf_size(3);
+        view.buffer = &buffer;
+        view.offset = offset;
+        offset += view.size;
+    }
+    buffer.size = offset;
+
+    // The original buffers are still needed as the source of the binary data so are replaced in a shallow copy
+    cgltf_data glb = *dataCGLTF;
+    glb.file_type = cgltf_file_type_glb;
+    glb.buffers = (dataCGLTF->buffer_views_count > 0) ? &buffer : nullptr;
+    glb.buffers_count = (dataCGLTF->buffer_views_count > 0) ? 1 : 0;
+
+    // Write out updated glb
+    printInfo("Writing output glb file: "s + outputFile);
+    if (cgltf_result result = cgltf_validate(&glb); result != cgltf_result_success) {
+        printError("Invalid output file detected: "s + getCGLTFError(result, dataCGLTF));
+        return false;
+    }
+    if (memoryOutput != nullptr ? !GLTFWriter(glb).writeGLB(memoryOutput->document, binary) :
+                                  !GLTFWriter(glb).writeGLB(outputFile, binary)) {
+        return false;
+    }
+    buffersModified = false;
+    return true;
+}
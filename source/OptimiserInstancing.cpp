@@ -0,0 +1,259 @@
+/**
+ * Copyright Matthew Oliver
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "Optimiser.h"
+#include "Shared.h"
+#include "SharedCGLTF.h"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <map>
+#include <ranges>
+#include <set>
+#include <vector>
+
+using namespace std;
+
+namespace {
+struct InstanceTransform
+{
+    array<cgltf_float, 3> translation = {0.0f, 0.0f, 0.0f};
+    array<cgltf_float, 4> rotation = {0.0f, 0.0f, 0.0f, 1.0f};
+    array<cgltf_float, 3> scale = {1.0f, 1.0f, 1.0f};
+};
+
+bool decomposeTransform(const array<cgltf_float, 16>& m, InstanceTransform& transform) noexcept
+{
+    transform.translation = {m[12], m[13], m[14]};
+
+    // Extract scale from the length of each basis vector
+    array<array<cgltf_float, 3>, 3> basis = {{{m[0], m[1], m[2]}, {m[4], m[5], m[6]}, {m[8], m[9], m[10]}}};
+    for (size_t i = 0; i < 3; ++i) {
+        transform.scale[i] = sqrtf(basis[i][0] * basis[i][0] + basis[i][1] * basis[i][1] + basis[i][2] * basis[i][2]);
+        if (transform.scale[i] <= numeric_limits<cgltf_float>::epsilon()) {
+            return false;
+        }
+    }
+    const cgltf_float determinant = m[0] * (m[5] * m[10] - m[9] * m[6]) - m[4] * (m[1] * m[10] - m[9] * m[2]) +
+        m[8] * (m[1] * m[6] - m[5] * m[2]);
+    if (determinant < 0.0f) {
+        transform.scale[0] = -transform.scale[0];
+    }
+    for (size_t i = 0; i < 3; ++i) {
+        for (size_t j = 0; j < 3; ++j) {
+            basis[i][j] /= transform.scale[i];
+        }
+    }
+
+    // Sheared transforms cannot be represented by TRS
+    constexpr cgltf_float tolerance = 1e-4f;
+    auto dot = [](const array<cgltf_float, 3>& a, const array<cgltf_float, 3>& b) {
+        return a[0] * b[0] + a[1] * b[1] + a[2] * b[2];
+    };
+    if (fabsf(dot(basis[0], basis[1])) > tolerance || fabsf(dot(basis[0], basis[2])) > tolerance ||
+        fabsf(dot(basis[1], basis[2])) > tolerance) {
+        return false;
+    }
+
+    // Convert rotation matrix to quaternion
+    const cgltf_float trace = basis[0][0] + basis[1][1] + basis[2][2];
+    cgltf_float x, y, z, w;
+    if (trace > 0.0f) {
+        const cgltf_float s = 0.5f / sqrtf(trace + 1.0f);
+        w = 0.25f / s;
+        x = (basis[1][2] - basis[2][1]) * s;
+        y = (basis[2][0] - basis[0][2]) * s;
+        z = (basis[0][1] - basis[1][0]) * s;
+    } else if (basis[0][0] > basis[1][1] && basis[0][0] > basis[2][2]) {
+        const cgltf_float s = 2.0f * sqrtf(1.0f + basis[0][0] - basis[1][1] - basis[2][2]);
+        w = (basis[1][2] - basis[2][1]) / s;
+        x = 0.25f * s;
+        y = (basis[1][0] + basis[0][1]) / s;
+        z = (basis[2][0] + basis[0][2]) / s;
+    } else if (basis[1][1] > basis[2][2]) {
+        const cgltf_float s = 2.0f * sqrtf(1.0f + basis[1][1] - basis[0][0] - basis[2][2]);
+        w = (basis[2][0] - basis[0][2]) / s;
+        x = (basis[1][0] + basis[0][1]) / s;
+        y = 0.25f * s;
+        z = (basis[2][1] + basis[1][2]) / s;
+    } else {
+        const cgltf_float s = 2.0f * sqrtf(1.0f + basis[2][2] - basis[0][0] - basis[1][1]);
+        w = (basis[0][1] - basis[1][0]) / s;
+        x = (basis[2][0] + basis[0][2]) / s;
+        y = (basis[2][1] + basis[1][2]) / s;
+        z = 0.25f * s;
+    }
+    const cgltf_float length = sqrtf(x * x + y * y + z * z + w * w);
+    transform.rotation = {x / length, y / length, z / length, w / length};
+    return true;
+}
+} // namespace
+
+bool Optimiser::passInstancing() noexcept
+{
+    if (dataCGLTF->scenes_count != 1) {
+        printWarning("Mesh instancing is only supported for files containing a single scene"sv);
+        return true;
+    }
+
+    // Find all static leaf nodes and group them by mesh
+    cgltf_scene& scene = dataCGLTF->scenes[0];
+    map<cgltf_mesh*, vector<cgltf_node*>> meshNodes;
+    for (auto& node : getStaticNodes(*dataCGLTF, scene)) {
+        if (node->mesh != nullptr && node->children_count == 0 && node->camera == nullptr &&
+            node->light == nullptr && node->weights_count == 0 && node->extensions_count == 0) {
+            meshNodes[node->mesh].push_back(node);
+        }
+    }
+
+    // Nodes can only be removed once all instanced nodes have been created
+    set<cgltf_node*> removedNodes;
+    vector<pair<cgltf_mesh*, vector<InstanceTransform>>> instances;
+    for (auto& [mesh, nodes] : meshNodes) {
+        if (nodes.size() < options.instancingMinimum) {
+            continue;
+        }
+        vector<InstanceTransform> transforms;
+        vector<cgltf_node*> instancedNodes;
+        for (auto& node : nodes) {
+            array<cgltf_float, 16> matrix;
+            cgltf_node_transform_world(node, matrix.data());
+            InstanceTransform transform;
+            if (decomposeTransform(matrix, transform)) {
+                transforms.push_back(transform);
+                instancedNodes.push_back(node);
+            }
+        }
+        if (transforms.size() < options.instancingMinimum) {
+            continue;
+        }
+        instances.emplace_back(mesh, transforms);
+        removedNodes.insert(instancedNodes.begin(), instancedNodes.end());
+    }
+    if (instances.empty()) {
+        return true;
+    }
+
+    // Remove all the nodes that are being replaced and any parent left empty
+    for (auto& node : getStaticNodes(*dataCGLTF, scene) | views::reverse) {
+        if (node->children_count == 0 || removedNodes.contains(node) || node->mesh != nullptr ||
+            node->camera != nullptr || node->light != nullptr || node->extensions_count != 0) {
+            continue;
+        }
+        bool empty = true;
+        for (cgltf_size i = 0; i < node->children_count; ++i) {
+            empty = empty && removedNodes.contains(node->children[i]);
+        }
+        if (empty) {
+            removedNodes.insert(node);
+        }
+    }
+    vector<cgltf_size> meshPositions;
+    for (auto& instance : instances) {
+        meshPositions.push_back(instance.first - dataCGLTF->meshes);
+    }
+    for (auto& i : removedNodes | views::reverse) {
+        removeNode(i);
+    }
+
+    for (size_t i = 0; i < instances.size(); ++i) {
+        const vector<InstanceTransform>& transforms = instances[i].second;
+
+        // Only output attributes that are not the identity for all instances
+        const bool hasTranslation = ranges::any_of(transforms, [](const InstanceTransform& t) {
+            return t.translation != array<cgltf_float, 3>{0.0f, 0.0f, 0.0f};
+        });
+        const bool hasRotation = ranges::any_of(transforms, [](const InstanceTransform& t) {
+            return t.rotation != array<cgltf_float, 4>{0.0f, 0.0f, 0.0f, 1.0f};
+        });
+        const bool hasScale = ranges::any_of(
+            transforms, [](const InstanceTransform& t) { return t.scale != array<cgltf_float, 3>{1.0f, 1.0f, 1.0f}; });
+        vector<pair<string_view, cgltf_type>> attributes;
+        if (hasTranslation || (!hasRotation && !hasScale)) {
+            attributes.emplace_back("TRANSLATION"sv, cgltf_type_vec3);
+        }
+        if (hasRotation) {
+            attributes.emplace_back("ROTATION"sv, cgltf_type_vec4);
+        }
+        if (hasScale) {
+            attributes.emplace_back("SCALE"sv, cgltf_type_vec3);
+        }
+
+        // Create buffer containing instance data
+        cgltf_size bufferSize = 0;
+        for (auto& attribute : attributes) {
+            bufferSize += cgltf_num_components(attribute.second) * sizeof(cgltf_float) * transforms.size();
+        }
+        cgltf_buffer* buffer = cgltf_add_buffer(dataCGLTF.get(), bufferSize);
+        cgltf_buffer_view* views = cgltf_add_buffer_views(dataCGLTF.get(), attributes.size());
+        cgltf_accessor* accessors = cgltf_add_accessors(dataCGLTF.get(), attributes.size());
+        cgltf_node* node = cgltf_add_nodes(dataCGLTF.get(), 1);
+        auto newMemory =
+            static_cast<cgltf_node**>(realloc(scene.nodes, (scene.nodes_count + 1) * sizeof(cgltf_node*)));
+        if (buffer == nullptr || views == nullptr || accessors == nullptr || node == nullptr || newMemory == nullptr) {
+            printError("Out of memory"sv);
+            return false;
+        }
+        scene.nodes = newMemory;
+        scene.nodes[scene.nodes_count] = node;
+        ++scene.nodes_count;
+        node->mesh = &dataCGLTF->meshes[meshPositions[i]];
+        node->mesh_gpu_instancing.attributes =
+            static_cast<cgltf_attribute*>(calloc(attributes.size(), sizeof(cgltf_attribute)));
+        if (node->mesh_gpu_instancing.attributes == nullptr) {
+            printError("Out of memory"sv);
+            return false;
+        }
+        node->has_mesh_gpu_instancing = true;
+        buffer = &dataCGLTF->buffers[dataCGLTF->buffers_count - 1];
+        cgltf_float* bufferData = static_cast<cgltf_float*>(buffer->data);
+        cgltf_size offset = 0;
+        for (size_t j = 0; j < attributes.size(); ++j) {
+            const cgltf_size components = cgltf_num_components(attributes[j].second);
+            cgltf_accessor& accessor = accessors[j];
+            accessor.component_type = cgltf_component_type_r_32f;
+            accessor.type = attributes[j].second;
+            accessor.count = transforms.size();
+            accessor.stride = components * sizeof(cgltf_float);
+            accessor.buffer_view = &views[j];
+            views[j].buffer = buffer;
+            views[j].offset = offset;
+            views[j].size = accessor.stride * transforms.size();
+            for (auto& transform : transforms) {
+                const cgltf_float* source = (attributes[j].first == "TRANSLATION"sv) ? transform.translation.data() :
+                    (attributes[j].first == "ROTATION"sv)                            ? transform.rotation.data() :
+                                                                                       transform.scale.data();
+                memcpy(bufferData, source, accessor.stride);
+                bufferData += components;
+            }
+            offset += views[j].size;
+
+            cgltf_attribute& attribute = node->mesh_gpu_instancing.attributes[j];
+            attribute.name = static_cast<char*>(malloc(attributes[j].first.length() + 1));
+            if (attribute.name == nullptr) {
+                printError("Out of memory"sv);
+                return false;
+            }
+            std::strcpy(attribute.name, attributes[j].first.data());
+            attribute.data = &accessor;
+            ++node->mesh_gpu_instancing.attributes_count;
+        }
+        printInfo("Instanced mesh: "s + getName(*node->mesh) + " (" + to_string(transforms.size()) + " instances)");
+    }
+    buffersModified = true;
+    return true;
+}
@@ -18,6 +18,9 @@
 #include "Shared.h"
 #include "SharedCGLTF.h"
 
+#include <algorithm>
+#include <array>
+#include <cmath>
 #include <map>
 #include <ranges>
 #include <set>
@@ -25,8 +28,532 @@
 
 using namespace std;
 
+namespace {
+void transformPosition(const array<cgltf_float, 16>& m, cgltf_float* v) noexcept
+{
+    const cgltf_float x = v[0];
+    const cgltf_float y = v[1];
+    const cgltf_float z = v[2];
+    v[0] = m[0] * x + m[4] * y + m[8] * z + m[12];
+    v[1] = m[1] * x + m[5] * y + m[9] * z + m[13];
+    v[2] = m[2] * x + m[6] * y + m[10] * z + m[14];
+}
+
+void transformDirection(const array<cgltf_float, 9>& m, cgltf_float* v) noexcept
+{
+    const cgltf_float x = m[0] * v[0] + m[3] * v[1] + m[6] * v[2];
+    const cgltf_float y = m[1] * v[0] + m[4] * v[1] + m[7] * v[2];
+    const cgltf_float z = m[2] * v[0] + m[5] * v[1] + m[8] * v[2];
+    const cgltf_float length = sqrtf(x * x + y * y + z * z);
+    const cgltf_float scale = (length > 0.0f) ? 1.0f / length : 0.0f;
+    v[0] = x * scale;
+    v[1] = y * scale;
+    v[2] = z * scale;
+}
+
+template<typename Function>
+void runOverVertexStreams(cgltf_primitive& prim, Function function) noexcept
+{
+    for (cgltf_size j = 0; j < prim.attributes_count; ++j) {
+        function(prim.attributes[j]);
+    }
+    for (cgltf_size k = 0; k < prim.targets_count; ++k) {
+        for (cgltf_size j = 0; j < prim.targets[k].attributes_count; ++j) {
+            function(prim.targets[k].attributes[j]);
+        }
+    }
+}
+
+void calculateBounds(cgltf_accessor& accessor) noexcept
+{
+    // Bounds are stored using the accessor's component values, so normalised data is read without normalisation
+    cgltf_accessor raw = accessor;
+    raw.normalized = false;
+    const cgltf_size components = cgltf_num_components(accessor.type);
+    for (cgltf_size c = 0; c < components; ++c) {
+        accessor.min[c] = numeric_limits<cgltf_float>::max();
+        accessor.max[c] = numeric_limits<cgltf_float>::lowest();
+    }
+    array<cgltf_float, 16> element = {};
+    for (cgltf_size v = 0; v < accessor.count; ++v) {
+        cgltf_accessor_read_float(&raw, v, element.data(), components);
+        for (cgltf_size c = 0; c < components; ++c) {
+            accessor.min[c] = std::min(accessor.min[c], element[c]);
+            accessor.max[c] = std::max(accessor.max[c], element[c]);
+        }
+    }
+    accessor.has_min = accessor.count > 0;
+    accessor.has_max = accessor.count > 0;
+}
+
+cgltf_float getDeterminant(const array<cgltf_float, 16>& m) noexcept
+{
+    return m[0] * (m[5] * m[10] - m[9] * m[6]) - m[4] * (m[1] * m[10] - m[9] * m[2]) +
+        m[8] * (m[1] * m[6] - m[5] * m[2]);
+}
+
+array<cgltf_float, 9> getNormalMatrix(const array<cgltf_float, 16>& m) noexcept
+{
+    // Cofactor matrix is the inverse transpose scaled by the determinant, sign is corrected so normals keep their
+    // facing when the transform is mirrored
+    const cgltf_float sign = (getDeterminant(m) < 0.0f) ? -1.0f : 1.0f;
+    return {sign * (m[5] * m[10] - m[6] * m[9]), sign * (m[6] * m[8] - m[4] * m[10]),
+        sign * (m[4] * m[9] - m[5] * m[8]), sign * (m[2] * m[9] - m[1] * m[10]), sign * (m[0] * m[10] - m[2] * m[8]),
+        sign * (m[1] * m[8] - m[0] * m[9]), sign * (m[1] * m[6] - m[2] * m[5]), sign * (m[2] * m[4] - m[0] * m[6]),
+        sign * (m[0] * m[5] - m[1] * m[4])};
+}
+} // namespace
+
 bool Optimiser::passMeshes() noexcept
 {
-    // TODO: optimise meshes
+    // Merge primitives that can be drawn together
+    for (cgltf_size i = 0; i < dataCGLTF->meshes_count; ++i) {
+        // Texture jobs run at the same time so may have already failed the pass
+        if (isCancelled()) {
+            return false;
+        }
+        cgltf_mesh& mesh = dataCGLTF->meshes[i];
+        if (!mergePrimitives(&mesh)) {
+            return false;
+        }
+    }
+
+    // Remove unreferenced vertices and use the smallest index type, primitives that share the same vertex data are
+    // compacted together so that the shared data is not copied for each of them
+    map<vector<cgltf_accessor*>, vector<cgltf_primitive*>> streamGroups;
+    map<cgltf_accessor*, cgltf_size> streamUses;
+    for (cgltf_size i = 0; i < dataCGLTF->meshes_count; ++i) {
+        cgltf_mesh& mesh = dataCGLTF->meshes[i];
+        for (cgltf_size j = 0; j < mesh.primitives_count; ++j) {
+            cgltf_primitive& prim = mesh.primitives[j];
+            vector<cgltf_accessor*> streams;
+            runOverVertexStreams(prim, [&](cgltf_attribute& attribute) {
+                streams.push_back(attribute.data);
+                ++streamUses[attribute.data];
+            });
+            if (prim.indices != nullptr && prim.attributes_count > 0 && !prim.has_draco_mesh_compression &&
+                getAccessorData(prim.indices) != nullptr) {
+                streamGroups[streams].push_back(&prim);
+            }
+        }
+    }
+    vector<vector<cgltf_primitive*>> compactGroups;
+    for (auto& [streams, prims] : streamGroups) {
+        // Vertex data that is also used by a primitive outside the group can not be replaced without duplicating it
+        const bool shared = ranges::any_of(streams, [&](cgltf_accessor* stream) {
+            return streamUses[stream] != static_cast<cgltf_size>(ranges::count(streams, stream)) * prims.size();
+        });
+        if (!shared) {
+            compactGroups.push_back(std::move(prims));
+        }
+    }
+    for (auto& prims : compactGroups) {
+        if (isCancelled()) {
+            return false;
+        }
+        if (!compactPrimitives(prims)) {
+            return false;
+        }
+    }
+
+    // Remove empty morph targets and store the remaining ones sparsely where smaller
+    for (cgltf_size i = 0; i < dataCGLTF->meshes_count; ++i) {
+        if (!optimiseMorphTargets(dataCGLTF->meshes[i])) {
+            return false;
+        }
+    }
+
+    // Build meshlets in separate jobs once primitives are no longer being modified
+    if (options.generateMeshlets) {
+        queueMeshlets();
+    }
+    return true;
+}
+
+bool Optimiser::mergePrimitives(cgltf_mesh* mesh) noexcept
+{
+    // Group all primitives that share the same material, mode and attribute layout
+    vector<vector<cgltf_primitive*>> groups;
+    for (cgltf_size i = 0; i < mesh->primitives_count; ++i) {
+        cgltf_primitive* prim = &mesh->primitives[i];
+        bool found = false;
+        if (canMerge(*prim)) {
+            for (auto& group : groups) {
+                cgltf_primitive* groupPrim = group.front();
+                if (canMerge(*groupPrim) && isCompatible(*groupPrim, *prim)) {
+                    group.push_back(prim);
+                    found = true;
+                    break;
+                }
+            }
+        }
+        if (!found) {
+            groups.push_back({prim});
+        }
+    }
+    if (groups.size() == mesh->primitives_count) {
+        return true;
+    }
+
+    // Combine each group into its first primitive
+    for (auto& group : groups) {
+        if (group.size() > 1 && !concatenatePrimitives(*group.front(), group)) {
+            return false;
+        }
+    }
+
+    // Remove all the primitives that were merged into another
+    cgltf_size newCount = 0;
+    for (cgltf_size i = 0; i < mesh->primitives_count; ++i) {
+        cgltf_primitive* prim = &mesh->primitives[i];
+        const bool keep = ranges::any_of(groups, [&](const auto& group) { return group.front() == prim; });
+        if (keep) {
+            if (newCount != i) {
+                mesh->primitives[newCount] = *prim;
+            }
+            ++newCount;
+        } else {
+            cgltf_remove_primitive(dataCGLTF.get(), prim);
+        }
+    }
+    printInfo("Merged mesh primitives: "s + getName(*mesh) + " (" + to_string(mesh->primitives_count) + " -> " +
+        to_string(newCount) + ")");
+    mesh->primitives_count = newCount;
+    return true;
+}
+
+bool Optimiser::concatenatePrimitives(cgltf_primitive& dest, const vector<cgltf_primitive*>& sources,
+    const vector<array<cgltf_float, 16>>& transforms) noexcept
+{
+    // Determine the combined vertex/index counts and required index width
+    cgltf_size vertexCount = 0;
+    cgltf_size indexCount = 0;
+    cgltf_size indexSize = 1;
+    for (auto& prim : sources) {
+        const cgltf_size primVertices = prim->attributes[0].data->count;
+        if (prim->indices != nullptr) {
+            indexCount += prim->indices->count;
+            indexSize = std::max(indexSize, getComponentSize(prim->indices->component_type));
+        } else {
+            indexCount += primVertices;
+            indexSize = std::max(indexSize, getComponentSize(getIndexType(primVertices - 1)));
+        }
+        vertexCount += primVertices;
+    }
+    cgltf_component_type indexType = getIndexType(vertexCount - 1);
+    if (getComponentSize(indexType) < indexSize) {
+        indexType = (indexSize == 2) ? cgltf_component_type_r_16u : cgltf_component_type_r_32u;
+    }
+
+    // Collect every attribute stream that needs to be concatenated, the destination defines the layout
+    vector<cgltf_attribute*> streams;
+    vector<cgltf_size> streamTargets; // target index + 1 for morph target attributes, 0 for base attributes
+    for (cgltf_size j = 0; j < dest.attributes_count; ++j) {
+        streams.push_back(&dest.attributes[j]);
+        streamTargets.push_back(0);
+    }
+    for (cgltf_size k = 0; k < dest.targets_count; ++k) {
+        for (cgltf_size j = 0; j < dest.targets[k].attributes_count; ++j) {
+            streams.push_back(&dest.targets[k].attributes[j]);
+            streamTargets.push_back(k + 1);
+        }
+    }
+    auto getSource = [&](const cgltf_primitive& prim, cgltf_size stream) -> const cgltf_accessor* {
+        const cgltf_size target = streamTargets[stream];
+        const cgltf_attribute* attributes = (target == 0) ? prim.attributes : prim.targets[target - 1].attributes;
+        const cgltf_size count = (target == 0) ? prim.attributes_count : prim.targets[target - 1].attributes_count;
+        return findAttribute(attributes, count, *streams[stream])->data;
+    };
+    vector<const cgltf_accessor*> streamFormats;
+    for (cgltf_size s = 0; s < streams.size(); ++s) {
+        streamFormats.push_back(getSource(*sources.front(), s));
+    }
+
+    // Calculate new buffer layout with each element 4 byte aligned as required for vertex attributes
+    vector<cgltf_size> streamOffsets;
+    vector<cgltf_size> streamStrides;
+    cgltf_size bufferSize = 0;
+    for (auto& format : streamFormats) {
+        const cgltf_size stride = (getElementSize(format) + 3) & ~cgltf_size(3);
+        streamOffsets.push_back(bufferSize);
+        streamStrides.push_back(stride);
+        bufferSize += stride * vertexCount;
+    }
+    const cgltf_size indexOffset = bufferSize;
+    bufferSize += ((getComponentSize(indexType) * indexCount) + 3) & ~cgltf_size(3);
+
+    cgltf_buffer* buffer = cgltf_add_buffer(dataCGLTF.get(), bufferSize);
+    if (buffer == nullptr) {
+        printError("Out of memory"sv);
+        return false;
+    }
+    uint8_t* bufferData = static_cast<uint8_t*>(buffer->data);
+    memset(bufferData, 0, bufferSize);
+
+    // Copy across vertex data
+    for (cgltf_size s = 0; s < streams.size(); ++s) {
+        const cgltf_size elementSize = getElementSize(streamFormats[s]);
+        const bool floatData = streamFormats[s]->component_type == cgltf_component_type_r_32f;
+        const cgltf_attribute_type type = streams[s]->type;
+        uint8_t* dest = bufferData + streamOffsets[s];
+        for (cgltf_size p = 0; p < sources.size(); ++p) {
+            const cgltf_accessor* accessor = getSource(*sources[p], s);
+            const uint8_t* source = getAccessorData(accessor);
+            const bool transform = !transforms.empty() && streamTargets[s] == 0 && floatData;
+            array<cgltf_float, 9> normalMatrix = {0};
+            cgltf_float tangentSign = 1.0f;
+            if (transform) {
+                normalMatrix = getNormalMatrix(transforms[p]);
+                tangentSign = (getDeterminant(transforms[p]) < 0.0f) ? -1.0f : 1.0f;
+            }
+            for (cgltf_size v = 0; v < accessor->count; ++v) {
+                memcpy(dest, source + v * accessor->stride, elementSize);
+                if (transform) {
+                    // Bake the transform into the vertex data
+                    cgltf_float* element = reinterpret_cast<cgltf_float*>(dest);
+                    if (type == cgltf_attribute_type_position) {
+                        transformPosition(transforms[p], element);
+                    } else if (type == cgltf_attribute_type_normal) {
+                        transformDirection(normalMatrix, element);
+                    } else if (type == cgltf_attribute_type_tangent) {
+                        const array<cgltf_float, 16>& m = transforms[p];
+                        transformDirection({m[0], m[1], m[2], m[4], m[5], m[6], m[8], m[9], m[10]}, element);
+                        element[3] *= tangentSign;
+                    }
+                }
+                dest += streamStrides[s];
+            }
+        }
+    }
+
+    // Copy across index data offsetting each primitive by its vertex start position
+    uint8_t* indexData = bufferData + indexOffset;
+    cgltf_size currentIndex = 0;
+    cgltf_size vertexStart = 0;
+    for (cgltf_size p = 0; p < sources.size(); ++p) {
+        const cgltf_primitive* prim = sources[p];
+        const cgltf_size primVertices = prim->attributes[0].data->count;
+        const cgltf_size primIndices = (prim->indices != nullptr) ? prim->indices->count : primVertices;
+        // Mirrored transforms reverse the triangle winding order
+        const bool flip = !transforms.empty() && prim->type == cgltf_primitive_type_triangles &&
+            getDeterminant(transforms[p]) < 0.0f;
+        for (cgltf_size k = 0; k < primIndices; ++k) {
+            cgltf_size source = k;
+            if (flip && (k % 3) != 0) {
+                source = (k % 3 == 1) ? k + 1 : k - 1;
+            }
+            const cgltf_size index =
+                (prim->indices != nullptr) ? cgltf_accessor_read_index(prim->indices, source) : source;
+            writeIndex(indexData, indexType, currentIndex++, vertexStart + index);
+        }
+        vertexStart += primVertices;
+    }
+
+    // Create new buffer views and accessors for the merged data
+    cgltf_buffer_view* views = cgltf_add_buffer_views(dataCGLTF.get(), streams.size() + 1);
+    cgltf_accessor* accessors = cgltf_add_accessors(dataCGLTF.get(), streams.size() + 1);
+    if (views == nullptr || accessors == nullptr) {
+        printError("Out of memory"sv);
+        return false;
+    }
+    buffer = &dataCGLTF->buffers[dataCGLTF->buffers_count - 1];
+    for (cgltf_size s = 0; s < streams.size(); ++s) {
+        const cgltf_accessor* format = getSource(*sources.front(), s);
+        cgltf_buffer_view& view = views[s];
+        view.buffer = buffer;
+        view.offset = streamOffsets[s];
+        view.size = streamStrides[s] * vertexCount;
+        view.stride = streamStrides[s];
+        view.type = cgltf_buffer_view_type_vertices;
+        cgltf_accessor& accessor = accessors[s];
+        accessor.component_type = format->component_type;
+        accessor.normalized = format->normalized;
+        accessor.type = format->type;
+        accessor.count = vertexCount;
+        accessor.stride = streamStrides[s];
+        accessor.buffer_view = &view;
+
+        const cgltf_size components = cgltf_num_components(accessor.type);
+        for (cgltf_size c = 0; c < components; ++c) {
+            accessor.min[c] = numeric_limits<cgltf_float>::max();
+            accessor.max[c] = numeric_limits<cgltf_float>::lowest();
+        }
+        if (!transforms.empty() && streamTargets[s] == 0 && accessor.component_type == cgltf_component_type_r_32f) {
+            // Transformed data needs new bounds calculated
+            const uint8_t* data = bufferData + streamOffsets[s];
+            for (cgltf_size v = 0; v < vertexCount; ++v) {
+                const cgltf_float* element = reinterpret_cast<const cgltf_float*>(data + v * streamStrides[s]);
+                for (cgltf_size c = 0; c < components; ++c) {
+                    accessor.min[c] = std::min(accessor.min[c], element[c]);
+                    accessor.max[c] = std::max(accessor.max[c], element[c]);
+                }
+            }
+            accessor.has_min = true;
+            accessor.has_max = true;
+        } else {
+            // Combine min/max bounds of all merged accessors
+            accessor.has_min = true;
+            accessor.has_max = true;
+            for (auto& prim : sources) {
+                const cgltf_accessor* source = getSource(*prim, s);
+                accessor.has_min = accessor.has_min && source->has_min;
+                accessor.has_max = accessor.has_max && source->has_max;
+                for (cgltf_size c = 0; c < components; ++c) {
+                    accessor.min[c] = std::min(accessor.min[c], source->min[c]);
+                    accessor.max[c] = std::max(accessor.max[c], source->max[c]);
+                }
+            }
+        }
+    }
+    cgltf_buffer_view& indexView = views[streams.size()];
+    indexView.buffer = buffer;
+    indexView.offset = indexOffset;
+    indexView.size = getComponentSize(indexType) * indexCount;
+    indexView.type = cgltf_buffer_view_type_indices;
+    cgltf_accessor& indexAccessor = accessors[streams.size()];
+    indexAccessor.component_type = indexType;
+    indexAccessor.type = cgltf_type_scalar;
+    indexAccessor.count = indexCount;
+    indexAccessor.stride = getComponentSize(indexType);
+    indexAccessor.buffer_view = &indexView;
+
+    // Update destination primitive to use the merged data
+    for (cgltf_size s = 0; s < streams.size(); ++s) {
+        streams[s]->data = &accessors[s];
+    }
+    dest.indices = &indexAccessor;
+    buffersModified = true;
+    return true;
+}
+
+bool Optimiser::compactPrimitives(const vector<cgltf_primitive*>& prims) noexcept
+{
+    // All primitives share the same vertex streams, only the first is needed to find them
+    cgltf_primitive& first = *prims.front();
+    const cgltf_size vertexCount = first.attributes[0].data->count;
+    vector<cgltf_attribute*> streams;
+    runOverVertexStreams(first, [&](cgltf_attribute& attribute) { streams.push_back(&attribute); });
+    for (auto& stream : streams) {
+        if (getAccessorData(stream->data) == nullptr || stream->data->count != vertexCount) {
+            return true;
+        }
+    }
+
+    // Remap vertices referenced by any of the primitives in order of first use
+    constexpr cgltf_size unused = numeric_limits<cgltf_size>::max();
+    vector<cgltf_size> remap(vertexCount, unused);
+    vector<cgltf_size> vertices;
+    vertices.reserve(vertexCount);
+    for (auto& prim : prims) {
+        for (cgltf_size i = 0; i < prim->indices->count; ++i) {
+            const cgltf_size index = cgltf_accessor_read_index(prim->indices, i);
+            if (index >= vertexCount) {
+                printWarning("Skipping compaction of primitive with out of range indices"sv);
+                return true;
+            }
+            if (remap[index] == unused) {
+                remap[index] = vertices.size();
+                vertices.push_back(index);
+            }
+        }
+    }
+    const cgltf_size usedCount = vertices.size();
+    const cgltf_component_type indexType = getIndexType((usedCount > 0) ? usedCount - 1 : 0);
+    if (usedCount == vertexCount &&
+        ranges::all_of(prims, [&](const auto& prim) { return prim->indices->component_type == indexType; })) {
+        return true;
+    }
+
+    // Calculate new buffer layout with each element 4 byte aligned as required for vertex attributes
+    vector<cgltf_size> streamOffsets;
+    vector<cgltf_size> streamStrides;
+    cgltf_size bufferSize = 0;
+    for (auto& stream : streams) {
+        const cgltf_size stride = (getElementSize(stream->data) + 3) & ~cgltf_size(3);
+        streamOffsets.push_back(bufferSize);
+        streamStrides.push_back(stride);
+        bufferSize += stride * usedCount;
+    }
+    vector<cgltf_size> indexOffsets;
+    for (auto& prim : prims) {
+        indexOffsets.push_back(bufferSize);
+        bufferSize += ((getComponentSize(indexType) * prim->indices->count) + 3) & ~cgltf_size(3);
+    }
+
+    cgltf_buffer* buffer = cgltf_add_buffer(dataCGLTF.get(), bufferSize);
+    if (buffer == nullptr) {
+        printError("Out of memory"sv);
+        return false;
+    }
+    uint8_t* bufferData = static_cast<uint8_t*>(buffer->data);
+    memset(bufferData, 0, bufferSize);
+
+    // Copy only the used vertices and remap the indices
+    for (cgltf_size s = 0; s < streams.size(); ++s) {
+        const cgltf_accessor* accessor = streams[s]->data;
+        const uint8_t* source = getAccessorData(accessor);
+        const cgltf_size elementSize = getElementSize(accessor);
+        uint8_t* dest = bufferData + streamOffsets[s];
+        for (cgltf_size v = 0; v < usedCount; ++v) {
+            memcpy(dest + v * streamStrides[s], source + vertices[v] * accessor->stride, elementSize);
+        }
+    }
+    for (size_t p = 0; p < prims.size(); ++p) {
+        uint8_t* indexData = bufferData + indexOffsets[p];
+        for (cgltf_size i = 0; i < prims[p]->indices->count; ++i) {
+            writeIndex(indexData, indexType, i, remap[cgltf_accessor_read_index(prims[p]->indices, i)]);
+        }
+    }
+
+    // Create new buffer views and accessors for the compacted data
+    cgltf_buffer_view* views = cgltf_add_buffer_views(dataCGLTF.get(), streams.size() + prims.size());
+    cgltf_accessor* accessors = cgltf_add_accessors(dataCGLTF.get(), streams.size() + prims.size());
+    if (views == nullptr || accessors == nullptr) {
+        printError("Out of memory"sv);
+        return false;
+    }
+    buffer = &dataCGLTF->buffers[dataCGLTF->buffers_count - 1];
+    for (cgltf_size s = 0; s < streams.size(); ++s) {
+        const cgltf_accessor* format = streams[s]->data;
+        cgltf_buffer_view& view = views[s];
+        view.buffer = buffer;
+        view.offset = streamOffsets[s];
+        view.size = streamStrides[s] * usedCount;
+        view.stride = streamStrides[s];
+        view.type = cgltf_buffer_view_type_vertices;
+        cgltf_accessor& accessor = accessors[s];
+        accessor.component_type = format->component_type;
+        accessor.normalized = format->normalized;
+        accessor.type = format->type;
+        accessor.count = usedCount;
+        accessor.stride = streamStrides[s];
+        accessor.buffer_view = &view;
+
+        // Bounds are recalculated so they only cover the remaining vertices, positions always require them
+        if (format->has_min || format->has_max || streams[s]->type == cgltf_attribute_type_position) {
+            calculateBounds(accessor);
+        }
+    }
+    for (size_t p = 0; p < prims.size(); ++p) {
+        cgltf_buffer_view& indexView = views[streams.size() + p];
+        indexView.buffer = buffer;
+        indexView.offset = indexOffsets[p];
+        indexView.size = getComponentSize(indexType) * prims[p]->indices->count;
+        indexView.type = cgltf_buffer_view_type_indices;
+        cgltf_accessor& indexAccessor = accessors[streams.size() + p];
+        indexAccessor.component_type = indexType;
+        indexAccessor.type = cgltf_type_scalar;
+        indexAccessor.count = prims[p]->indices->count;
+        indexAccessor.stride = getComponentSize(indexType);
+        indexAccessor.buffer_view = &indexView;
+    }
+
+    // Update all primitives to use the shared compacted data
+    for (size_t p = 0; p < prims.size(); ++p) {
+        cgltf_size s = 0;
+        runOverVertexStreams(*prims[p], [&](cgltf_attribute& attribute) { attribute.data = &accessors[s++]; });
+        prims[p]->indices = &accessors[streams.size() + p];
+    }
+    buffersModified = true;
     return true;
 }
@@ -0,0 +1,233 @@
+/**
+ * Copyright Matthew Oliver
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "GLTFWriter.h"
+#include "Optimiser.h"
+#include "Shared.h"
+#include "SharedCGLTF.h"
+
+#include <span>
+#include <map>
+#include <meshoptimizer.h>
+#include <vector>
+
+using namespace std;
+
+namespace {
+// Sidecar file layout, all values are little endian and every block is 4 byte aligned
+struct MeshletFileHeader
+{
+    char magic[4] = {'G', 'O', 'M', 'L'};
+    uint32_t version = 1;
+    uint32_t primitiveCount = 0;
+    uint32_t reserved = 0;
+};
+
+struct MeshletFileEntry
+{
+    uint32_t mesh = 0;
+    uint32_t primitive = 0;
+    uint32_t meshletCount = 0;
+    uint32_t meshletsOffset = 0;
+    uint32_t vertexCount = 0;
+    uint32_t verticesOffset = 0;
+    uint32_t trianglesSize = 0;
+    uint32_t trianglesOffset = 0;
+};
+
+struct MeshletRecord
+{
+    uint32_t vertexOffset;
+    uint32_t triangleOffset;
+    uint32_t vertexCount;
+    uint32_t triangleCount;
+    float center[3];
+    float radius;
+    float coneAxis[3];
+    float coneCutoff;
+    float coneApex[3];
+    float padding;
+};
+static_assert(sizeof(MeshletRecord) == 64);
+
+bool canBuildMeshlets(const cgltf_primitive& prim) noexcept
+{
+    if (prim.type != cgltf_primitive_type_triangles || prim.indices == nullptr || prim.indices->count < 3 ||
+        getAccessorData(prim.indices) == nullptr) {
+        return false;
+    }
+    const cgltf_attribute* position = findAttribute(prim, cgltf_attribute_type_position);
+    return position != nullptr && position->data->type == cgltf_type_vec3 &&
+        position->data->component_type == cgltf_component_type_r_32f && getAccessorData(position->data) != nullptr;
+}
+} // namespace
+
+void Optimiser::queueMeshlets() noexcept
+{
+    // Results are allocated up front so that jobs can write to them without synchronisation
+    meshlets.clear();
+    for (cgltf_size i = 0; i < dataCGLTF->meshes_count; ++i) {
+        cgltf_mesh& mesh = dataCGLTF->meshes[i];
+        for (cgltf_size j = 0; j < mesh.primitives_count; ++j) {
+            if (canBuildMeshlets(mesh.primitives[j])) {
+                meshlets.push_back({&mesh.primitives[j]});
+            }
+        }
+    }
+
+    // Build meshlets for each primitive in a separate job
+    for (auto& entry : meshlets) {
+        pendingTasks.push_back(pool.submit([this, &entry]() {
+            const cgltf_primitive& prim = *entry.prim;
+            const cgltf_accessor* positions = findAttribute(prim, cgltf_attribute_type_position)->data;
+            const cgltf_size indexCount = prim.indices->count - (prim.indices->count % 3);
+            vector<unsigned int> indices(indexCount);
+            for (cgltf_size i = 0; i < indexCount; ++i) {
+                indices[i] = static_cast<unsigned int>(cgltf_accessor_read_index(prim.indices, i));
+            }
+            const float* positionData = reinterpret_cast<const float*>(getAccessorData(positions));
+            const size_t maxVertices = options.meshletMaxVertices;
+            const size_t maxTriangles = options.meshletMaxTriangles;
+            const size_t maxMeshlets = meshopt_buildMeshletsBound(indexCount, maxVertices, maxTriangles);
+            vector<meshopt_Meshlet> primMeshlets(maxMeshlets);
+            vector<unsigned int> vertices(maxMeshlets * maxVertices);
+            vector<unsigned char> triangles(maxMeshlets * maxTriangles * 3);
+            const size_t meshletCount = meshopt_buildMeshlets(primMeshlets.data(), vertices.data(), triangles.data(),
+                indices.data(), indexCount, positionData, positions->count, positions->stride, maxVertices,
+                maxTriangles, 0.25f);
+            if (meshletCount == 0) {
+                return true;
+            }
+            const meshopt_Meshlet& last = primMeshlets[meshletCount - 1];
+            vertices.resize(last.vertex_offset + last.vertex_count);
+            triangles.resize(last.triangle_offset + ((last.triangle_count * 3 + 3) & ~3));
+
+            // Pack meshlet descriptors with their culling data, followed by vertices and triangles
+            const cgltf_size recordsSize = meshletCount * sizeof(MeshletRecord);
+            const cgltf_size verticesSize = vertices.size() * sizeof(unsigned int);
+            entry.data.resize(recordsSize + verticesSize + triangles.size());
+            for (size_t m = 0; m < meshletCount; ++m) {
+                const meshopt_Meshlet& meshlet = primMeshlets[m];
+                meshopt_optimizeMeshlet(&vertices[meshlet.vertex_offset], &triangles[meshlet.triangle_offset],
+                    meshlet.triangle_count, meshlet.vertex_count);
+                const meshopt_Bounds bounds = meshopt_computeMeshletBounds(&vertices[meshlet.vertex_offset],
+                    &triangles[meshlet.triangle_offset], meshlet.triangle_count, positionData, positions->count,
+                    positions->stride);
+                const MeshletRecord record = {meshlet.vertex_offset, meshlet.triangle_offset, meshlet.vertex_count,
+                    meshlet.triangle_count, {bounds.center[0], bounds.center[1], bounds.center[2]}, bounds.radius,
+                    {bounds.cone_axis[0], bounds.cone_axis[1], bounds.cone_axis[2]}, bounds.cone_cutoff,
+                    {bounds.cone_apex[0], bounds.cone_apex[1], bounds.cone_apex[2]}, 0.0f};
+                memcpy(entry.data.data() + m * sizeof(MeshletRecord), &record, sizeof(MeshletRecord));
+            }
+            memcpy(entry.data.data() + recordsSize, vertices.data(), verticesSize);
+            memcpy(entry.data.data() + recordsSize + verticesSize, triangles.data(), triangles.size());
+            entry.meshletCount = meshletCount;
+            entry.vertexCount = vertices.size();
+            entry.trianglesSize = triangles.size();
+            return true;
+        }));
+    }
+}
+
+bool Optimiser::passMeshlets(const std::string& outputFile) noexcept
+{
+    if (meshlets.empty()) {
+        return true;
+    }
+
+    // Primitives may have been removed since the meshlets were built so only those still in use are written
+    map<const cgltf_primitive*, const Meshlets*> primMeshlets;
+    for (auto& entry : meshlets) {
+        if (entry.meshletCount > 0) {
+            primMeshlets.emplace(entry.prim, &entry);
+        }
+    }
+    vector<MeshletFileEntry> entries;
+    vector<const Meshlets*> entryData;
+    for (cgltf_size i = 0; i < dataCGLTF->meshes_count; ++i) {
+        cgltf_mesh& mesh = dataCGLTF->meshes[i];
+        for (cgltf_size j = 0; j < mesh.primitives_count; ++j) {
+            if (auto found = primMeshlets.find(&mesh.primitives[j]); found != primMeshlets.end()) {
+                MeshletFileEntry entry;
+                entry.mesh = static_cast<uint32_t>(i);
+                entry.primitive = static_cast<uint32_t>(j);
+                entries.push_back(entry);
+                entryData.push_back(found->second);
+            }
+        }
+    }
+    if (entries.empty()) {
+        meshlets.clear();
+        return true;
+    }
+
+    // Calculate location of each primitive's data within the file
+    MeshletFileHeader header;
+    header.primitiveCount = static_cast<uint32_t>(entries.size());
+    cgltf_size offset = sizeof(MeshletFileHeader) + entries.size() * sizeof(MeshletFileEntry);
+    for (cgltf_size e = 0; e < entries.size(); ++e) {
+        const Meshlets& data = *entryData[e];
+        MeshletFileEntry& entry = entries[e];
+        entry.meshletCount = static_cast<uint32_t>(data.meshletCount);
+        entry.meshletsOffset = static_cast<uint32_t>(offset);
+        entry.vertexCount = static_cast<uint32_t>(data.vertexCount);
+        entry.verticesOffset = static_cast<uint32_t>(offset + data.meshletCount * sizeof(MeshletRecord));
+        entry.trianglesSize = static_cast<uint32_t>(data.trianglesSize);
+        entry.trianglesOffset = static_cast<uint32_t>(entry.verticesOffset + data.vertexCount * sizeof(unsigned int));
+        offset += data.data.size();
+    }
+    if (offset > numeric_limits<uint32_t>::max()) {
+        printError("Meshlet data exceeds maximum file size"sv);
+        return false;
+    }
+
+    // Write out sidecar file
+    const string outputFolder = getFolder(outputFile);
+    const string meshletFile = getSidecarFileName(outputFile, ".meshlets.bin"sv);
+    printInfo("Writing output meshlet file: "s + outputFolder + meshletFile);
+    vector<span<const uint8_t>> fileData = {span(reinterpret_cast<const uint8_t*>(&header), sizeof(MeshletFileHeader)),
+        span(reinterpret_cast<const uint8_t*>(entries.data()), entries.size() * sizeof(MeshletFileEntry))};
+    for (auto& data : entryData) {
+        fileData.emplace_back(data->data);
+    }
+    if (!writeOutputFile(outputFolder, meshletFile, fileData)) {
+        printError("Failed writing output meshlet file: "s + outputFolder + meshletFile);
+        return false;
+    }
+
+    // Reference the meshlet data from each primitive
+    for (auto& entry : entries) {
+        cgltf_primitive& prim = dataCGLTF->meshes[entry.mesh].primitives[entry.primitive];
+        const string json = "{\"uri\":\""s + meshletFile + "\",\"meshletCount\":" + to_string(entry.meshletCount) +
+            ",\"meshletsByteOffset\":" + to_string(entry.meshletsOffset) +
+            ",\"vertexCount\":" + to_string(entry.vertexCount) +
+            ",\"verticesByteOffset\":" + to_string(entry.verticesOffset) +
+            ",\"trianglesByteLength\":" + to_string(entry.trianglesSize) +
+            ",\"trianglesByteOffset\":" + to_string(entry.trianglesOffset) +
+            ",\"maxVertices\":" + to_string(options.meshletMaxVertices) +
+            ",\"maxTriangles\":" + to_string(options.meshletMaxTriangles) + "}";
+        if (!cgltf_add_extension(prim.extensions, prim.extensions_count, meshletExtension, json)) {
+            printError("Out of memory"sv);
+            return false;
+        }
+    }
+    if (!cgltf_add_extension_used(dataCGLTF.get(), meshletExtension)) {
+        printError("Out of memory"sv);
+        return false;
+    }
+    meshlets.clear();
+    return true;
+}
@@ -0,0 +1,306 @@
+/**
+ * Copyright Matthew Oliver
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "Optimiser.h"
+#include "Shared.h"
+#include "SharedCGLTF.h"
+
+#include <algorithm>
+#include <cmath>
+#include <set>
+#include <vector>
+
+using namespace std;
+
+namespace {
+bool isZero(const cgltf_accessor* accessor, cgltf_size index, cgltf_float epsilon) noexcept
+{
+    cgltf_float element[16];
+    const cgltf_size components = cgltf_num_components(accessor->type);
+    if (!cgltf_accessor_read_float(accessor, index, element, components)) {
+        return false;
+    }
+    return all_of(element, element + components, [&](cgltf_float value) { return fabsf(value) <= epsilon; });
+}
+
+void freeMorphTarget(cgltf_morph_target& target) noexcept
+{
+    for (cgltf_size k = 0; k < target.attributes_count; ++k) {
+        free(target.attributes[k].name);
+    }
+    free(target.attributes);
+    target = {0};
+}
+
+template<typename T>
+void removeElements(T* elements, cgltf_size& count, const vector<bool>& keep) noexcept
+{
+    cgltf_size newCount = 0;
+    for (cgltf_size i = 0; i < count; ++i) {
+        if (keep[i]) {
+            elements[newCount++] = elements[i];
+        }
+    }
+    count = newCount;
+}
+} // namespace
+
+bool Optimiser::optimiseMorphTargets(cgltf_mesh& mesh) noexcept
+{
+    // All primitives in a mesh must have the same number of morph targets
+    const cgltf_size targetCount = (mesh.primitives_count > 0) ? mesh.primitives[0].targets_count : 0;
+    if (targetCount == 0) {
+        return true;
+    }
+    for (cgltf_size j = 0; j < mesh.primitives_count; ++j) {
+        if (mesh.primitives[j].targets_count != targetCount || mesh.primitives[j].has_draco_mesh_compression) {
+            return true;
+        }
+    }
+
+    // A target can only be removed if its deltas are negligible in every primitive
+    const cgltf_float epsilon = options.morphTargetEpsilon;
+    vector<bool> keep(targetCount, false);
+    for (cgltf_size t = 0; t < targetCount; ++t) {
+        for (cgltf_size j = 0; j < mesh.primitives_count && !keep[t]; ++j) {
+            const cgltf_morph_target& target = mesh.primitives[j].targets[t];
+            for (cgltf_size k = 0; k < target.attributes_count && !keep[t]; ++k) {
+                const cgltf_accessor* accessor = target.attributes[k].data;
+                for (cgltf_size i = 0; i < accessor->count; ++i) {
+                    if (!isZero(accessor, i, epsilon)) {
+                        keep[t] = true;
+                        break;
+                    }
+                }
+            }
+        }
+    }
+    const cgltf_size keptCount = ranges::count(keep, true);
+    if (keptCount != targetCount && !removeMorphTargets(mesh, keep)) {
+        return false;
+    }
+
+    // Convert mostly zero target data to sparse accessors
+    for (cgltf_size j = 0; j < mesh.primitives_count; ++j) {
+        cgltf_primitive& prim = mesh.primitives[j];
+        for (cgltf_size t = 0; t < prim.targets_count; ++t) {
+            cgltf_morph_target& target = prim.targets[t];
+            for (cgltf_size k = 0; k < target.attributes_count; ++k) {
+                if (!convertToSparse(target.attributes[k].data)) {
+                    return false;
+                }
+            }
+        }
+    }
+    return true;
+}
+
+bool Optimiser::removeMorphTargets(cgltf_mesh& mesh, const vector<bool>& keep) noexcept
+{
+    const cgltf_size targetCount = keep.size();
+    const cgltf_size keptCount = ranges::count(keep, true);
+    printInfo("Removed empty morph targets: "s + getName(mesh) + " (" + to_string(targetCount) + " -> " +
+        to_string(keptCount) + ")");
+
+    // Remove targets from each primitive
+    for (cgltf_size j = 0; j < mesh.primitives_count; ++j) {
+        cgltf_primitive& prim = mesh.primitives[j];
+        for (cgltf_size t = 0; t < targetCount; ++t) {
+            if (!keep[t]) {
+                freeMorphTarget(prim.targets[t]);
+            }
+        }
+        removeElements(prim.targets, prim.targets_count, keep);
+    }
+
+    // Remove matching default weights and names
+    if (mesh.weights_count == targetCount) {
+        removeElements(mesh.weights, mesh.weights_count, keep);
+    }
+    if (mesh.target_names_count == targetCount) {
+        for (cgltf_size t = 0; t < targetCount; ++t) {
+            if (!keep[t]) {
+                free(mesh.target_names[t]);
+            }
+        }
+        removeElements(mesh.target_names, mesh.target_names_count, keep);
+    }
+
+    // Remove matching node weights
+    for (cgltf_size i = 0; i < dataCGLTF->nodes_count; ++i) {
+        cgltf_node& node = dataCGLTF->nodes[i];
+        if (node.mesh == &mesh && node.weights_count == targetCount) {
+            removeElements(node.weights, node.weights_count, keep);
+        }
+    }
+
+    // Remove matching weights from animations, each sampler output holds a block of weights per key
+    vector<cgltf_animation_sampler*> updatedSamplers;
+    for (cgltf_size i = 0; i < dataCGLTF->animations_count; ++i) {
+        cgltf_animation& animation = dataCGLTF->animations[i];
+        for (cgltf_size j = animation.channels_count; j-- > 0;) {
+            cgltf_animation_channel& channel = animation.channels[j];
+            if (channel.target_path != cgltf_animation_path_type_weights || channel.target_node == nullptr ||
+                channel.target_node->mesh != &mesh) {
+                continue;
+            }
+            if (keptCount == 0) {
+                // Channels that no longer animate anything are removed along with their samplers
+                cgltf_free_extensions(dataCGLTF.get(), channel.extensions, channel.extensions_count);
+                memmove(&animation.channels[j], &animation.channels[j + 1],
+                    (animation.channels_count - j - 1) * sizeof(cgltf_animation_channel));
+                --animation.channels_count;
+                continue;
+            }
+            if (channel.sampler != nullptr && ranges::find(updatedSamplers, channel.sampler) == updatedSamplers.end()) {
+                updatedSamplers.push_back(channel.sampler);
+            }
+        }
+        if (keptCount == 0) {
+            removeUnusedSamplers(animation);
+        }
+    }
+    if (keptCount == 0) {
+        removeEmptyAnimations();
+    }
+    if (updatedSamplers.empty()) {
+        buffersModified = true;
+        return true;
+    }
+
+    // All rewritten sampler outputs are stored together in a single new buffer
+    cgltf_size valueCount = 0;
+    for (auto& sampler : updatedSamplers) {
+        valueCount += sampler->output->count / targetCount * keptCount;
+    }
+    cgltf_buffer* buffer = cgltf_add_buffer(dataCGLTF.get(), valueCount * sizeof(cgltf_float));
+    cgltf_buffer_view* view = (buffer != nullptr) ? cgltf_add_buffer_views(dataCGLTF.get(), 1) : nullptr;
+    cgltf_accessor* accessors =
+        (view != nullptr) ? cgltf_add_accessors(dataCGLTF.get(), updatedSamplers.size()) : nullptr;
+    if (accessors == nullptr) {
+        printError("Out of memory"sv);
+        return false;
+    }
+    buffer = &dataCGLTF->buffers[dataCGLTF->buffers_count - 1];
+    view->buffer = buffer;
+    view->size = buffer->size;
+    cgltf_float* data = static_cast<cgltf_float*>(buffer->data);
+    cgltf_size written = 0;
+    for (size_t s = 0; s < updatedSamplers.size(); ++s) {
+        const cgltf_accessor* output = updatedSamplers[s]->output;
+        const cgltf_size blocks = output->count / targetCount;
+        cgltf_accessor& accessor = accessors[s];
+        accessor.offset = written * sizeof(cgltf_float);
+        for (cgltf_size b = 0; b < blocks; ++b) {
+            for (cgltf_size t = 0; t < targetCount; ++t) {
+                if (keep[t]) {
+                    cgltf_accessor_read_float(output, b * targetCount + t, &data[written++], 1);
+                }
+            }
+        }
+        accessor.component_type = cgltf_component_type_r_32f;
+        accessor.type = cgltf_type_scalar;
+        accessor.count = blocks * keptCount;
+        accessor.stride = sizeof(cgltf_float);
+        accessor.buffer_view = view;
+        updatedSamplers[s]->output = &accessor;
+    }
+    buffersModified = true;
+    return true;
+}
+
+bool Optimiser::convertToSparse(cgltf_accessor*& accessor) noexcept
+{
+    const uint8_t* source = getAccessorData(accessor);
+    if (source == nullptr || accessor->count == 0) {
+        return true;
+    }
+
+    // Find all non-zero elements and check if sparse storage would be smaller
+    vector<cgltf_size> indices;
+    for (cgltf_size i = 0; i < accessor->count; ++i) {
+        if (!isZero(accessor, i, options.morphTargetEpsilon)) {
+            indices.push_back(i);
+        }
+    }
+    if (indices.empty()) {
+        // Sparse accessors require at least one element
+        indices.push_back(0);
+    }
+    const cgltf_component_type indexType = getIndexType(accessor->count - 1);
+    const cgltf_size elementSize = getElementSize(accessor);
+    const cgltf_size indicesSize = (indices.size() * getComponentSize(indexType) + 3) & ~cgltf_size(3);
+    const cgltf_size valuesSize = indices.size() * elementSize;
+    if (indicesSize + valuesSize >= accessor->count * elementSize) {
+        return true;
+    }
+
+    cgltf_buffer* buffer = cgltf_add_buffer(dataCGLTF.get(), indicesSize + valuesSize);
+    cgltf_buffer_view* views = (buffer != nullptr) ? cgltf_add_buffer_views(dataCGLTF.get(), 2) : nullptr;
+    const cgltf_size accessorPos = accessor - dataCGLTF->accessors;
+    cgltf_accessor* sparse = (views != nullptr) ? cgltf_add_accessors(dataCGLTF.get(), 1) : nullptr;
+    if (sparse == nullptr) {
+        printError("Out of memory"sv);
+        return false;
+    }
+    // Adding accessors may have moved the existing ones
+    const cgltf_accessor* original = &dataCGLTF->accessors[accessorPos];
+    source = getAccessorData(original);
+    buffer = &dataCGLTF->buffers[dataCGLTF->buffers_count - 1];
+    uint8_t* bufferData = static_cast<uint8_t*>(buffer->data);
+    memset(bufferData, 0, buffer->size);
+    for (cgltf_size i = 0; i < indices.size(); ++i) {
+        writeIndex(bufferData, indexType, i, indices[i]);
+        memcpy(bufferData + indicesSize + i * elementSize, source + indices[i] * original->stride, elementSize);
+    }
+    views[0].buffer = buffer;
+    views[0].size = indices.size() * getComponentSize(indexType);
+    views[1].buffer = buffer;
+    views[1].offset = indicesSize;
+    views[1].size = valuesSize;
+
+    sparse->component_type = original->component_type;
+    sparse->normalized = original->normalized;
+    sparse->type = original->type;
+    sparse->count = original->count;
+    sparse->stride = elementSize;
+    sparse->is_sparse = true;
+    sparse->sparse.count = indices.size();
+    sparse->sparse.indices_buffer_view = &views[0];
+    sparse->sparse.indices_component_type = indexType;
+    sparse->sparse.values_buffer_view = &views[1];
+
+    // Bounds must also include the implicit zero elements
+    const cgltf_size components = cgltf_num_components(sparse->type);
+    const bool implicitZero = indices.size() < original->count;
+    for (cgltf_size c = 0; c < components; ++c) {
+        sparse->min[c] = implicitZero ? 0.0f : numeric_limits<cgltf_float>::max();
+        sparse->max[c] = implicitZero ? 0.0f : numeric_limits<cgltf_float>::lowest();
+    }
+    for (auto& index : indices) {
+        cgltf_float element[16];
+        cgltf_accessor_read_float(original, index, element, components);
+        for (cgltf_size c = 0; c < components; ++c) {
+            sparse->min[c] = std::min(sparse->min[c], element[c]);
+            sparse->max[c] = std::max(sparse->max[c], element[c]);
+        }
+    }
+    sparse->has_min = original->has_min || original->component_type == cgltf_component_type_r_32f;
+    sparse->has_max = sparse->has_min;
+    accessor = sparse;
+    buffersModified = true;
+    return true;
+}
@@ -290,3 +290,104 @@ void Optimiser::removeMesh(cgltf_mesh* mesh) noexcept
         }
     }
 }
+
+void Optimiser::removeAccessor(cgltf_accessor* accessor) noexcept
+{
+    // Remove the accessor from the accessors list
+    cgltf_remove_accessor(dataCGLTF.get(), accessor);
+    const cgltf_size accessorPos = accessor - dataCGLTF->accessors;
+    memmove(accessor, accessor + 1, (dataCGLTF->accessors_count - accessorPos - 1) * sizeof(cgltf_accessor));
+    --dataCGLTF->accessors_count;
+    dataCGLTF->accessors[dataCGLTF->accessors_count] = {0};
+
+    // Loop through all accessor users and update pointers to compensate for list change
+    runOverAccessors(*dataCGLTF, [&](cgltf_accessor*& p) {
+        if (p == accessor) {
+            p = nullptr;
+        } else if (p > accessor) {
+            p = p - 1;
+        }
+    });
+    buffersModified = true;
+}
+
+void Optimiser::removeBufferView(cgltf_buffer_view* view) noexcept
+{
+    // Remove the buffer view from the buffer views list
+    cgltf_remove_buffer_view(dataCGLTF.get(), view);
+    const cgltf_size viewPos = view - dataCGLTF->buffer_views;
+    memmove(view, view + 1, (dataCGLTF->buffer_views_count - viewPos - 1) * sizeof(cgltf_buffer_view));
+    --dataCGLTF->buffer_views_count;
+    dataCGLTF->buffer_views[dataCGLTF->buffer_views_count] = {0};
+
+    // Loop through all buffer view users and update pointers to compensate for list change
+    runOverBufferViews(*dataCGLTF, [&](cgltf_buffer_view*& p) {
+        if (p == view) {
+            p = nullptr;
+        } else if (p > view) {
+            p = p - 1;
+        }
+    });
+    buffersModified = true;
+}
+
+void Optimiser::removeBuffer(cgltf_buffer* buffer) noexcept
+{
+    // Remove the buffer from the buffers list
+    cgltf_remove_buffer(dataCGLTF.get(), buffer);
+    const cgltf_size bufferPos = buffer - dataCGLTF->buffers;
+    memmove(buffer, buffer + 1, (dataCGLTF->buffers_count - bufferPos - 1) * sizeof(cgltf_buffer));
+    --dataCGLTF->buffers_count;
+    dataCGLTF->buffers[dataCGLTF->buffers_count] = {0};
+
+    // Loop through all buffer views and update pointers to compensate for list change
+    runOverBuffers(*dataCGLTF, [&](cgltf_buffer*& p) {
+        if (p == buffer) {
+            p = nullptr;
+        } else if (p > buffer) {
+            p = p - 1;
+        }
+    });
+    buffersModified = true;
+}
+
+void Optimiser::removeNode(cgltf_node* node) noexcept
+{
+    // Remove the node from its parents child list
+    auto removeFromList = [&](cgltf_node** list, cgltf_size& count) {
+        for (cgltf_size i = 0; i < count; ++i) {
+            if (list[i] == node) {
+                memmove(&list[i], &list[i + 1], (count - i - 1) * sizeof(cgltf_node*));
+                --count;
+                break;
+            }
+        }
+    };
+    if (node->parent != nullptr) {
+        removeFromList(node->parent->children, node->parent->children_count);
+    }
+    for (cgltf_size i = 0; i < dataCGLTF->scenes_count; ++i) {
+        cgltf_scene& scene = dataCGLTF->scenes[i];
+        removeFromList(scene.nodes, scene.nodes_count);
+    }
+    // Any remaining children are detached from the node
+    for (cgltf_size i = 0; i < node->children_count; ++i) {
+        node->children[i]->parent = nullptr;
+    }
+
+    // Remove the node from the nodes list
+    cgltf_remove_node(dataCGLTF.get(), node);
+    const cgltf_size nodePos = node - dataCGLTF->nodes;
+    memmove(node, node + 1, (dataCGLTF->nodes_count - nodePos - 1) * sizeof(cgltf_node));
+    --dataCGLTF->nodes_count;
+    dataCGLTF->nodes[dataCGLTF->nodes_count] = {0};
+
+    // Loop through all node users and update pointers to compensate for list change
+    runOverNodes(*dataCGLTF, [&](cgltf_node*& p) {
+        if (p == node) {
+            p = nullptr;
+        } else if (p > node) {
+            p = p - 1;
+        }
+    });
+}
@@ -0,0 +1,182 @@
+/**
+ * Copyright Matthew Oliver
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "Optimiser.h"
+#include "Shared.h"
+#include "SharedCGLTF.h"
+
+#include <algorithm>
+#include <array>
+#include <numeric>
+#include <vector>
+
+using namespace std;
+
+namespace {
+uint32_t expandBits(uint32_t value) noexcept
+{
+    // Spread the lower 10 bits so that there are 2 zero bits between each
+    value = (value * 0x00010001u) & 0xFF0000FFu;
+    value = (value * 0x00000101u) & 0x0F00F00Fu;
+    value = (value * 0x00000011u) & 0xC30C30C3u;
+    value = (value * 0x00000005u) & 0x49249249u;
+    return value;
+}
+
+uint32_t getMortonCode(const array<cgltf_float, 3>& position) noexcept
+{
+    uint32_t code = 0;
+    for (uint32_t c = 0; c < 3; ++c) {
+        const auto quantised = static_cast<uint32_t>(std::clamp(position[c] * 1024.0f, 0.0f, 1023.0f));
+        code |= expandBits(quantised) << (2 - c);
+    }
+    return code;
+}
+
+template<typename T, typename RunOver>
+bool reorder(
+    cgltf_data& data, T*& elements, cgltf_size count, const vector<cgltf_size>& order, RunOver runOver) noexcept
+{
+    if (count == 0) {
+        return true;
+    }
+    // Copy elements into their new positions and then update all pointers to them
+    T* newElements = static_cast<T*>(malloc(count * sizeof(T)));
+    if (newElements == nullptr) {
+        return false;
+    }
+    vector<cgltf_size> newPositions(count);
+    for (cgltf_size i = 0; i < count; ++i) {
+        newElements[i] = elements[order[i]];
+        newPositions[order[i]] = i;
+    }
+    T* oldElements = elements;
+    elements = newElements;
+    runOver(data, [&](T*& p) {
+        if (p != nullptr) {
+            p = newElements + newPositions[p - oldElements];
+        }
+    });
+    free(oldElements);
+    return true;
+}
+} // namespace
+
+bool Optimiser::passSpatialSort() noexcept
+{
+    if (dataCGLTF->nodes_count == 0) {
+        return true;
+    }
+
+    // Calculate world space center of each node using the bounds of its mesh
+    vector<array<cgltf_float, 3>> centers(dataCGLTF->nodes_count);
+    array<cgltf_float, 3> sceneMin = {numeric_limits<cgltf_float>::max(), numeric_limits<cgltf_float>::max(),
+        numeric_limits<cgltf_float>::max()};
+    array<cgltf_float, 3> sceneMax = {numeric_limits<cgltf_float>::lowest(), numeric_limits<cgltf_float>::lowest(),
+        numeric_limits<cgltf_float>::lowest()};
+    for (cgltf_size i = 0; i < dataCGLTF->nodes_count; ++i) {
+        const cgltf_node& node = dataCGLTF->nodes[i];
+        array<cgltf_float, 3> boundsMin, boundsMax;
+        if (!getWorldBounds(node, boundsMin, boundsMax)) {
+            // Nodes without geometry are placed at their world space origin
+            array<cgltf_float, 16> world;
+            cgltf_node_transform_world(&node, world.data());
+            boundsMin = {world[12], world[13], world[14]};
+            boundsMax = boundsMin;
+        }
+        for (cgltf_size c = 0; c < 3; ++c) {
+            centers[i][c] = (boundsMin[c] + boundsMax[c]) * 0.5f;
+            sceneMin[c] = std::min(sceneMin[c], centers[i][c]);
+            sceneMax[c] = std::max(sceneMax[c], centers[i][c]);
+        }
+    }
+
+    // Sort nodes along a Morton curve through the scene bounds
+    vector<uint32_t> codes(dataCGLTF->nodes_count);
+    for (cgltf_size i = 0; i < dataCGLTF->nodes_count; ++i) {
+        array<cgltf_float, 3> normalised;
+        for (cgltf_size c = 0; c < 3; ++c) {
+            const cgltf_float extent = sceneMax[c] - sceneMin[c];
+            normalised[c] = (extent > 0.0f) ? (centers[i][c] - sceneMin[c]) / extent : 0.0f;
+        }
+        codes[i] = getMortonCode(normalised);
+    }
+    vector<cgltf_size> nodeOrder(dataCGLTF->nodes_count);
+    iota(nodeOrder.begin(), nodeOrder.end(), 0);
+    ranges::stable_sort(nodeOrder, [&](cgltf_size a, cgltf_size b) { return codes[a] < codes[b]; });
+
+    // Meshes are ordered by the first node that uses them
+    vector<cgltf_size> meshOrder;
+    vector<bool> meshAdded(dataCGLTF->meshes_count, false);
+    for (auto& i : nodeOrder) {
+        const cgltf_mesh* mesh = dataCGLTF->nodes[i].mesh;
+        if (mesh != nullptr && !meshAdded[mesh - dataCGLTF->meshes]) {
+            meshAdded[mesh - dataCGLTF->meshes] = true;
+            meshOrder.push_back(mesh - dataCGLTF->meshes);
+        }
+    }
+    for (cgltf_size i = 0; i < dataCGLTF->meshes_count; ++i) {
+        if (!meshAdded[i]) {
+            meshOrder.push_back(i);
+        }
+    }
+
+    // Buffer views are ordered by the first mesh that uses them so that the repacked buffer follows the same order
+    vector<cgltf_size> viewOrder;
+    vector<bool> viewAdded(dataCGLTF->buffer_views_count, false);
+    auto addView = [&](const cgltf_accessor* accessor) {
+        if (accessor != nullptr && accessor->buffer_view != nullptr &&
+            !viewAdded[accessor->buffer_view - dataCGLTF->buffer_views]) {
+            viewAdded[accessor->buffer_view - dataCGLTF->buffer_views] = true;
+            viewOrder.push_back(accessor->buffer_view - dataCGLTF->buffer_views);
+        }
+    };
+    for (auto& i : meshOrder) {
+        const cgltf_mesh& mesh = dataCGLTF->meshes[i];
+        for (cgltf_size j = 0; j < mesh.primitives_count; ++j) {
+            const cgltf_primitive& prim = mesh.primitives[j];
+            addView(prim.indices);
+            for (cgltf_size k = 0; k < prim.attributes_count; ++k) {
+                addView(prim.attributes[k].data);
+            }
+            for (cgltf_size t = 0; t < prim.targets_count; ++t) {
+                for (cgltf_size k = 0; k < prim.targets[t].attributes_count; ++k) {
+                    addView(prim.targets[t].attributes[k].data);
+                }
+            }
+        }
+    }
+    for (cgltf_size i = 0; i < dataCGLTF->buffer_views_count; ++i) {
+        if (!viewAdded[i]) {
+            viewOrder.push_back(i);
+        }
+    }
+
+    if (!reorder(*dataCGLTF, dataCGLTF->nodes, dataCGLTF->nodes_count, nodeOrder, [](auto& data, auto function) {
+            runOverNodes(data, function);
+        }) ||
+        !reorder(*dataCGLTF, dataCGLTF->meshes, dataCGLTF->meshes_count, meshOrder, [](auto& data, auto function) {
+            runOverMeshes(data, function);
+        }) ||
+        !reorder(*dataCGLTF, dataCGLTF->buffer_views, dataCGLTF->buffer_views_count, viewOrder,
+            [](auto& data, auto function) { runOverBufferViews(data, function); })) {
+        printError("Out of memory"sv);
+        return false;
+    }
+    printInfo("Spatially sorted nodes: "s + to_string(dataCGLTF->nodes_count));
+    buffersModified = true;
+    return true;
+}
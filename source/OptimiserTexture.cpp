@@ -17,29 +17,213 @@
 #include "Optimiser.h"
 #include "Shared.h"
 #include "SharedCGLTF.h"
+#include "TextureCache.h"
 #include "TextureLoad.h"
+#include "TextureManifest.h"
 
+#include <algorithm>
+#include <filesystem>
 #include <fstream>
+#include <functional>
 #include <map>
+#include <optional>
 #include <ranges>
 #include <set>
+#include <span>
+#include <stb_image.h>
 #include <vector>
 
 using namespace std;
 
+namespace {
+vector<string> getImageKeys(const string& imageFile, span<const uint8_t> source, bool memorySource) noexcept
+{
+    // Images are identified by both their resolved path and their contents so that copies in other folders match, the
+    // path also includes the modification time so that edited files are not matched by long running processes. Cache
+    // matches are also checked against the source data so a hash collision can not return another image's result.
+    vector<string> keys;
+    if (!memorySource) {
+        error_code ec;
+        const filesystem::path path = filesystem::weakly_canonical(imageFile, ec);
+        const auto modified = filesystem::last_write_time(imageFile, ec).time_since_epoch().count();
+        keys.push_back("path:"s + (ec ? imageFile : path.string()) + ":" + to_string(modified));
+    }
+    if (!source.empty()) {
+        keys.push_back("hash:"s + getDataHash(source));
+    }
+    return keys;
+}
+
+uint64_t getTextureCost(const string& imageFile, span<const uint8_t> source, bool normalMap, bool split) noexcept
+{
+    // Only the image header is read, unknown sizes are treated as small
+    int width = 0, height = 0, channels = 0;
+    const int found = source.empty() ?
+        stbi_info(imageFile.c_str(), &width, &height, &channels) :
+        stbi_info_from_memory(source.data(), static_cast<int>(source.size()), &width, &height, &channels);
+    if (found == 0) {
+        return 0;
+    }
+
+    // Compression time is roughly proportional to the number of texels in the full mip chain (4/3 of the top level)
+    const uint64_t texels = static_cast<uint64_t>(width) * static_cast<uint64_t>(height) * 4 / 3;
+    uint64_t cost = texels * static_cast<uint64_t>(std::max(channels, 1));
+    if (normalMap) {
+        // Each mip level is also normalised
+        cost *= 2;
+    }
+    if (split) {
+        // Metallicity and roughness are compressed as two additional single channel textures
+        cost += texels * 2;
+    }
+    return cost;
+}
+
+string getEncodeSettings(bool sRGB, bool normalMap) noexcept
+{
+    return string(sRGB ? "srgb" : "linear") + (normalMap ? ":normal" : "");
+}
+
+vector<string> getEncodeKeys(const vector<string>& imageKeys, bool sRGB, bool normalMap) noexcept
+{
+    const string settings = getEncodeSettings(sRGB, normalMap) + ":";
+    vector<string> keys;
+    for (auto& key : imageKeys) {
+        keys.push_back(settings + key);
+    }
+    return keys;
+}
+} // namespace
+
 bool Optimiser::passTextures() noexcept
 {
+    if (!options.textureManifest.empty()) {
+        return true;
+    }
+    if ((options.outputGLB || memoryOutput != nullptr) && options.splitMetalRoughTextures) {
+        printWarning("Split metallicity/roughness textures are not written when outputting a glb or to memory"sv);
+    }
+
     // Convert all textures
+    convertedImages.clear();
+    textureTasks.clear();
     set<cgltf_texture*> images;
+    bool converted = true;
     for (size_t i = 0; i < dataCGLTF->materials_count; ++i) {
         cgltf_material& material = dataCGLTF->materials[i];
         runOverMaterialTextures(material, [&](cgltf_texture*& p, bool sRGB, bool normalMap, bool split = false) {
-            if (images.find(p) == images.end()) {
-                convertTexture(p, sRGB, normalMap, split);
+            if (images.find(p) == images.end() && (converted || options.continueOnError)) {
+                if (!convertTexture(p, sRGB, normalMap, split)) {
+                    printError("Failed converting texture: "s + getName(*p));
+                    converted = false;
+                }
                 images.insert(p);
             }
         });
     }
+    if (!converted && !options.continueOnError) {
+        textureTasks.clear();
+        return false;
+    }
+
+    // Largest textures are started first so that a large texture found last does not run alone after all others
+    ranges::stable_sort(textureTasks, [](auto& a, auto& b) { return a.cost > b.cost; });
+    for (auto& task : textureTasks) {
+        pendingTasks.push_back(pool.submit([this, run = std::move(task.run)]() { return runTask(run); }));
+    }
+    textureTasks.clear();
+    return converted;
+}
+
+bool Optimiser::passTextureManifest() noexcept
+{
+    // Only external image files are exported, embedded images are converted when the results are merged
+    vector<TextureJob> jobs;
+    set<string> outputs;
+    for (size_t i = 0; i < dataCGLTF->materials_count; ++i) {
+        cgltf_material& material = dataCGLTF->materials[i];
+        runOverMaterialTextures(material, [&](cgltf_texture*& p, bool sRGB, bool normalMap, bool = false) {
+            if (p == nullptr || p->image == nullptr) {
+                return;
+            }
+            const cgltf_image& image = *p->image;
+            if (image.buffer_view != nullptr || image.uri == nullptr || strncmp(image.uri, "data:", 5) == 0) {
+                return;
+            }
+            string imageFile = rootFolder + image.uri;
+            imageFile.resize(cgltf_decode_uri(imageFile.data()));
+            string outputFile = imageFile;
+            if (const size_t fileExt = outputFile.rfind('.'); fileExt != string::npos) {
+                outputFile.erase(fileExt);
+            }
+            outputFile += ".ktx2";
+
+            // Images used by several textures use the settings of the first one, as when converting directly
+            if ((!options.replaceCompressedTextures && ifstream(outputFile).good()) ||
+                !outputs.insert(outputFile).second) {
+                return;
+            }
+            TextureJob job;
+            job.hash = getFileHash(imageFile);
+            if (job.hash.empty()) {
+                printWarning("Failed to open texture, it will not be added to the manifest: "s + imageFile);
+                return;
+            }
+            error_code ec;
+            job.inputFile = filesystem::absolute(imageFile, ec).string();
+            job.outputFile = filesystem::absolute(outputFile, ec).string();
+            job.sRGB = sRGB;
+            job.normalMap = normalMap;
+            jobs.push_back(std::move(job));
+        });
+    }
+    printInfo("Exported texture jobs: "s + to_string(jobs.size()));
+    return writeTextureManifest(options.textureManifest, jobs);
+}
+
+bool Optimiser::passEmbeddedImages() noexcept
+{
+    bool sourcesReplaced = false;
+    for (auto& embedded : embeddedImages) {
+        cgltf_image& image = dataCGLTF->images[embedded->image];
+        sourcesReplaced = sourcesReplaced || embedded->embeddedSource;
+        if (embedded->data.empty()) {
+            if (image.uri == nullptr) {
+                printError("Failed compressing embedded image: "s + getName(image));
+                return false;
+            }
+            continue;
+        }
+        if (options.outputGLB) {
+            // Written directly from memory into the output glb
+            continue;
+        }
+        if (memoryOutput != nullptr && image.uri != nullptr) {
+            // Returned alongside the in memory output document
+            memoryOutput->files[image.uri] = std::move(embedded->data);
+            continue;
+        }
+
+        // Store compressed data in its own buffer, this is then packed with all other buffers on output
+        cgltf_buffer* buffer = cgltf_add_buffer(dataCGLTF.get(), embedded->data.size());
+        cgltf_buffer_view* view = (buffer != nullptr) ? cgltf_add_buffer_views(dataCGLTF.get(), 1) : nullptr;
+        if (view == nullptr) {
+            printError("Out of memory"sv);
+            return false;
+        }
+        memcpy(buffer->data, embedded->data.data(), embedded->data.size());
+        view->buffer = buffer;
+        view->size = buffer->size;
+        image.buffer_view = view;
+        embedded->data.clear();
+        buffersModified = true;
+    }
+
+    // Remove the buffer views that held the original encoded images
+    if (sourcesReplaced) {
+        checkUnusedBufferViews();
+        checkUnusedBuffers();
+    }
     return true;
 }
 
@@ -55,75 +239,189 @@ bool Optimiser::convertTexture(cgltf_texture* texture, bool sRGB, bool normalMap
         return false;
     }
 
-    // Get image file
-    string imageFileName = rootFolder + image->uri;
-    const vector<pair<string_view, string_view>> substitutions = {{"%20", " "}, {"%21", "!"}, {"%23", "#"},
-        {"%24", "$"}, {"%26", "&"}, {"%2B", "+"}, {"%2D", "-"}, {"%3D", "="}, {"%40", "@"}, {"%7E", "~"}};
-    for (const auto& i : substitutions) {
-        size_t pos = 0;
-        string_view search = i.first;
-        string_view replace = i.second;
-        while ((pos = imageFileName.find(search, pos)) != string::npos) {
-            imageFileName.replace(pos, search.length(), replace);
-            pos += replace.length();
+    // Images shared by several textures are only converted once
+    if (auto pos = convertedImages.find(image - dataCGLTF->images); pos != convertedImages.end()) {
+        texture->basisu_image = &dataCGLTF->images[pos->second];
+        texture->has_basisu = true;
+        if (!options.keepOriginalTextures) {
+            texture->image = nullptr;
+        }
+        return true;
+    }
+    const cgltf_size sourceImage = image - dataCGLTF->images;
+
+    // Embedded images are decoded directly from memory, data uris are decoded once here and shared with the task
+    span<const uint8_t> source;
+    shared_ptr<void> sourceData;
+    const bool embeddedSource =
+        image->buffer_view != nullptr || (image->uri != nullptr && strncmp(image->uri, "data:", 5) == 0);
+    if (image->buffer_view != nullptr) {
+        if (!requireBuffers()) {
+            return false;
+        }
+        const cgltf_buffer_view* view = image->buffer_view;
+        if (view->buffer->data == nullptr) {
+            printError("Missing buffer data for embedded image: "s + getName(*image));
+            return false;
+        }
+        source = span(static_cast<const uint8_t*>(view->buffer->data) + view->offset, view->size);
+    } else if (embeddedSource) {
+        const char* base64 = strstr(image->uri, ";base64,");
+        if (base64 == nullptr) {
+            printError("Unsupported data uri encoding for image: "s + getName(*image));
+            return false;
+        }
+        base64 += 8;
+        const size_t length = strlen(base64);
+        const size_t padding = (length > 0 && base64[length - 1] == '=') + (length > 1 && base64[length - 2] == '=');
+        const cgltf_size size = length / 4 * 3 - padding;
+        void* decoded = nullptr;
+        cgltf_options optionsCGLTF = {};
+        if (cgltf_load_buffer_base64(&optionsCGLTF, size, base64, &decoded) != cgltf_result_success) {
+            printError("Failed to decode data uri for image: "s + getName(*image));
+            return false;
         }
+        sourceData = shared_ptr<void>(decoded, [](auto p) { free(p); });
+        source = span(static_cast<const uint8_t*>(decoded), size);
+    } else if (image->uri == nullptr || strlen(image->uri) == 0) {
+        return false;
+    }
+
+    // Get image file, embedded images have no file so their name is only used for messages
+    string imageFileName = embeddedSource ? string(getName(*image)) : rootFolder + image->uri;
+    if (!embeddedSource) {
+        imageFileName.resize(cgltf_decode_uri(imageFileName.data()));
     }
-    const size_t fileExt = imageFileName.rfind('.');
     const string imageFile = imageFileName;
-    imageFileName.erase(fileExt);
+    if (const size_t fileExt = imageFileName.rfind('.'); !embeddedSource && fileExt != string::npos) {
+        imageFileName.erase(fileExt);
+    }
+
+    // Split textures are external files that a glb or embedded image can not reference
+    split = split && !options.outputGLB && !embeddedSource && memoryOutput == nullptr;
 
-    // Check for existing basisu texture
-    if (texture->basisu_image != nullptr && !options.replaceCompressedTextures) {
+    // Check for existing basisu texture, an incremental run recompresses it if its recorded source has changed.
+    // Outputs from before the manifest was used are assumed to be up to date with their source and are recorded.
+    if (texture->basisu_image != nullptr && !options.replaceCompressedTextures && !embeddedSource) {
         string fileName = imageFileName + ".ktx2";
-        if (split && options.splitMetalRoughTextures) {
+        const string settings = getEncodeSettings(sRGB, normalMap);
+        const bool recorded = sourceManifest.isLoaded() && sourceManifest.contains(fileName);
+        const bool outdated = recorded && !sourceManifest.isUnchanged(imageFile, fileName, settings);
+        if (!outdated && split && options.splitMetalRoughTextures) {
             // Check for split textures
             const string metallicityFile = imageFileName + ".metallicity.ktx2";
             const string roughnessFile = imageFileName + ".roughness.ktx2";
             if (ifstream(fileName).good() && ifstream(metallicityFile).good() && ifstream(roughnessFile).good()) {
+                if (sourceManifest.isLoaded() && !recorded) {
+                    sourceManifest.record(imageFile, fileName, settings);
+                }
                 return true;
             }
         }
-        if (ifstream(fileName).good()) {
+        if (!outdated && ifstream(fileName).good()) {
+            if (sourceManifest.isLoaded() && !recorded) {
+                sourceManifest.record(imageFile, fileName, settings);
+            }
             return true;
         }
     }
 
-    // Load in existing texture
-    if (image->uri == nullptr || strlen(image->uri) == 0) {
-        return false;
+    // Compressed textures are kept in memory when they are to be embedded in the output or returned in memory
+    EmbeddedImage* embedded = nullptr;
+    if (options.outputGLB || embeddedSource || memoryOutput != nullptr) {
+        embeddedImages.push_back(make_unique<EmbeddedImage>());
+        embedded = embeddedImages.back().get();
+        embedded->embeddedSource = embeddedSource;
     }
 
-    // Run texture conversion in thread
-    pool.push_task(
-        [this](std::string imageFile, string imageFileName, bool sRGB, bool normalMap, bool split) {
-            TextureLoad imageData(imageFile);
-            if (imageData.data.get() == nullptr) {
-                return false;
-            }
-            imageData.sRGB = sRGB;
-            imageData.normalMap = normalMap;
+    // Texture conversion is queued to run in a thread once all textures have been found, the source data is only
+    // bound to keep any decoded data uri alive while the job reads from it
+    auto task = bind(
+        [this](std::string imageFile, string imageFileName, span<const uint8_t> source,
+            [[maybe_unused]] shared_ptr<void> sourceData, bool sRGB, bool normalMap, bool split,
+            EmbeddedImage* embedded) {
+            // The image is only decoded once it is known that it needs to be encoded
+            const bool memorySource = embedded != nullptr && embedded->embeddedSource;
+            optional<TextureLoad> imageData;
+            vector<string> imageKeys;
+            MappedFile sourceFile;
+            span<const uint8_t> sourceBytes = memorySource ? source : span<const uint8_t>();
+            auto getKeys = [&]() -> const vector<string>& {
+                if (imageKeys.empty()) {
+                    if (!memorySource && sourceFile.open(imageFile)) {
+                        sourceBytes = span(static_cast<const uint8_t*>(sourceFile.data()), sourceFile.size());
+                    }
+                    imageKeys = getImageKeys(imageFile, sourceBytes, memorySource);
+                }
+                return imageKeys;
+            };
+            auto decode = [&]() {
+                auto decoded = memorySource ? make_shared<TextureLoad>(source.data(), source.size(), imageFile) :
+                                              make_shared<TextureLoad>(imageFile);
+                return (decoded->data.get() != nullptr) ? decoded : nullptr;
+            };
+            auto loadImage = [&]() {
+                if (imageData.has_value()) {
+                    return imageData->data.get() != nullptr;
+                }
+                if (decodedCache == nullptr && memorySource) {
+                    imageData.emplace(source.data(), source.size(), imageFile);
+                } else if (decodedCache == nullptr) {
+                    imageData.emplace(imageFile);
+                } else {
+                    // Compression modifies the image data so each job works on its own copy of the shared image
+                    const vector<string>& keys = getKeys();
+                    const DecodedTextureCache::Result decoded = decodedCache->get(keys, decode, sourceBytes);
+                    if (decoded == nullptr) {
+                        return false;
+                    }
+                    imageData.emplace(
+                        decoded->imageWidth, decoded->imageHeight, decoded->channelCount, decoded->bytesPerChannel);
+                    if (imageData->data.get() == nullptr) {
+                        printError("Out of memory"sv);
+                        return false;
+                    }
+                    memcpy(imageData->data.get(), decoded->data.get(), getCacheSize(*decoded));
+                }
+                imageData->sRGB = sRGB;
+                imageData->normalMap = normalMap;
+                return imageData->data.get() != nullptr;
+            };
+
+            // With an incremental manifest existing outputs are only reused if their recorded source is unchanged,
+            // outputs without an entry were created before the manifest was used so are reused and recorded
+            string fileName = imageFileName + ".ktx2";
+            const string settings = getEncodeSettings(sRGB, normalMap);
+            const bool incremental = embedded == nullptr && sourceManifest.isLoaded();
+            const bool recorded = incremental && sourceManifest.contains(fileName);
+            const bool unchanged = recorded && sourceManifest.isUnchanged(imageFile, fileName, settings);
+            const bool outdated = recorded && !unchanged;
+            const bool reuseExisting = (unchanged || !options.replaceCompressedTextures) && !outdated;
 
             // Convert
             if (split && options.splitMetalRoughTextures) {
                 const string metallicityFile = imageFileName + ".metallicity.ktx2";
                 const string roughnessFile = imageFileName + ".roughness.ktx2";
-                bool metalicityFound = !options.replaceCompressedTextures && ifstream(metallicityFile).good();
-                bool roughnessFound = !options.replaceCompressedTextures && ifstream(roughnessFile).good();
+                bool metalicityFound = reuseExisting && ifstream(metallicityFile).good();
+                bool roughnessFound = reuseExisting && ifstream(roughnessFile).good();
                 if (!metalicityFound || !roughnessFound) {
+                    if (!loadImage()) {
+                        return false;
+                    }
                     printInfo("Splitting texture: "s + imageFile);
                     // Assumes we only want to split when metallicity/roughness
                     uint32_t metalIndex = 2; // blue channel
                     uint32_t roughIndex = 1; // green channel
-                    if (imageData.channelCount == 2) {
+                    if (imageData->channelCount == 2) {
                         metalIndex = 0;
                         roughIndex = 1;
-                    } else if (imageData.channelCount != 3 && imageData.channelCount != 4) {
+                    } else if (imageData->channelCount != 3 && imageData->channelCount != 4) {
                         printError("Unexpected channel count when splitting texture '" + imageFile + "'");
                         return false;
                     }
 
                     // Split the files
-                    TextureLoad imageDataMetal(imageData, metalIndex);
+                    TextureLoad imageDataMetal(*imageData, metalIndex);
                     if (imageDataMetal.isUniqueTexture()) {
                         if (metalicityFound) {
                             printInfo("Using existing found metallicity texture '" + metallicityFile + "'");
@@ -133,7 +431,11 @@ bool Optimiser::convertTexture(cgltf_texture* texture, bool sRGB, bool normalMap
                     } else {
                         printWarning("Skipping output of redundant split metallicity texture '" + imageFile + "'");
                     }
-                    TextureLoad imageDataRough(imageData, roughIndex);
+                    // Each encode is slow so a cancelled pass stops between them, skipped work is not a failure
+                    if (cancelled) {
+                        return true;
+                    }
+                    TextureLoad imageDataRough(*imageData, roughIndex);
                     if (imageDataRough.isUniqueTexture()) {
                         if (roughnessFound) {
                             printInfo("Using existing found roughness texture '" + roughnessFile + "'");
@@ -147,16 +449,74 @@ bool Optimiser::convertTexture(cgltf_texture* texture, bool sRGB, bool normalMap
                     printInfo("Using existing metallicity and roughness textures '" + metallicityFile + ", " +
                         roughnessFile + "'");
                 }
+                if (cancelled) {
+                    return true;
+                }
             }
-            string fileName = imageFileName + ".ktx2";
-            if (!options.replaceCompressedTextures && ifstream(fileName).good()) {
+            if (unchanged) {
+                printInfo("Using unchanged texture '" + fileName + "'");
+                return true;
+            }
+            // Hashing the source is only needed to check a resumed journal or to record an encoded texture
+            const bool journaled = embedded == nullptr && journal.isOpen();
+            string parameters;
+            auto getParameters = [&]() -> const string& {
+                if (parameters.empty()) {
+                    parameters = settings + ":" + getFileHash(imageFile);
+                }
+                return parameters;
+            };
+            if (journaled && options.resume && !outdated && journal.isComplete(fileName, getParameters())) {
+                printInfo("Using journaled texture '" + fileName + "'");
+                if (incremental) {
+                    sourceManifest.record(imageFile, fileName, settings);
+                }
+                return true;
+            }
+            if (!memorySource && reuseExisting && ifstream(fileName).good()) {
+                // Existing files are embedded directly from disk when writing a glb
                 printInfo("Using existing found texture '" + fileName + "'");
-            } else if (!imageData.writeKTX(fileName)) {
+                if (incremental) {
+                    sourceManifest.record(imageFile, fileName, settings);
+                }
+                return true;
+            }
+
+            // Textures shared with other assets are only encoded once
+            auto encode = [&]() -> TextureCache::Result {
+                auto output = make_shared<vector<uint8_t>>();
+                if (!loadImage() || !imageData->writeKTX(*output, fileName)) {
+                    return nullptr;
+                }
+                return output;
+            };
+            const vector<string> keys = (textureCache != nullptr) ? getEncodeKeys(getKeys(), sRGB, normalMap) :
+                                                                     vector<string>();
+            const TextureCache::Result result =
+                (textureCache != nullptr) ? textureCache->get(keys, encode, sourceBytes) : encode();
+            if (result == nullptr) {
+                return false;
+            }
+            reportProgress("Compressed texture: "s + imageFile);
+            if (embedded != nullptr) {
+                embedded->data = *result;
+                return true;
+            }
+            printInfo("Writing compressed texture: "s + fileName);
+            if (!writeFile(fileName, {*result})) {
+                printError("Failed writing ktx texture '"s + fileName + "'");
                 return false;
             }
+            if (journaled) {
+                journal.record(fileName, getParameters(), *result);
+            }
+            if (incremental) {
+                sourceManifest.record(imageFile, fileName, settings);
+            }
             return true;
         },
-        imageFile, imageFileName, sRGB, normalMap, split);
+        imageFile, imageFileName, source, sourceData, sRGB, normalMap, split, embedded);
+    textureTasks.push_back({getTextureCost(imageFile, source, normalMap, split), std::move(task)});
 
     // Update texture with new image
     cgltf_image* newImage = nullptr;
@@ -189,7 +549,9 @@ bool Optimiser::convertTexture(cgltf_texture* texture, bool sRGB, bool normalMap
         newImage = &dataCGLTF->images[dataCGLTF->images_count];
         *newImage = {0};
         string_view basisu = "/basisu"sv;
-        const char* name = image->name != nullptr ? image->name : image->uri != nullptr ? image->uri : "";
+        const char* name = image->name != nullptr    ? image->name :
+            (image->uri != nullptr && !embeddedSource) ? image->uri :
+                                                         "";
         newImage->name = static_cast<char*>(malloc(strlen(name) + basisu.length() + 1));
         if (newImage->name != nullptr) {
             strcpy(newImage->name, name);
@@ -200,21 +562,33 @@ bool Optimiser::convertTexture(cgltf_texture* texture, bool sRGB, bool normalMap
         // Reuse existing image allocation
         newImage = image;
 
-        // Remove old texture file
-        printInfo("Removing old texture: "s + imageFile);
-        remove(imageFile.c_str());
+        // Remove old texture file once it has been converted, a glb or in memory output does not reference any
+        // external files so the inputs are left untouched
+        if (!options.outputGLB && !embeddedSource && memoryOutput == nullptr) {
+            removedFiles.push_back(imageFile);
+        }
         texture->image = nullptr;
     }
-    string newFile = imageFileName.substr(rootFolder.length()) + ".ktx2";
-    auto newMemory = realloc(newImage->uri, newFile.length() + 1);
-    if (newMemory == nullptr) {
-        printError("Out of memory"sv);
-        return false;
+    if (embedded != nullptr) {
+        embedded->image = newImage - dataCGLTF->images;
+        newImage->buffer_view = nullptr;
+    }
+    if (embeddedSource) {
+        // The compressed data is stored in a buffer view once it is available
+        free(newImage->uri);
+        newImage->uri = nullptr;
+    } else {
+        string newFile = imageFileName.substr(rootFolder.length()) + ".ktx2";
+        auto newMemory = realloc(newImage->uri, newFile.length() + 1);
+        if (newMemory == nullptr) {
+            printError("Out of memory"sv);
+            return false;
+        }
+        newImage->uri = static_cast<char*>(newMemory);
+        std::strcpy(newImage->uri, newFile.data());
     }
-    newImage->uri = static_cast<char*>(newMemory);
-    std::strcpy(newImage->uri, newFile.data());
     string_view mimeType = "image/ktx2"sv;
-    newMemory = realloc(newImage->mime_type, mimeType.length() + 1);
+    auto newMemory = realloc(newImage->mime_type, mimeType.length() + 1);
     if (newMemory == nullptr) {
         printError("Out of memory"sv);
         return false;
@@ -223,6 +597,7 @@ bool Optimiser::convertTexture(cgltf_texture* texture, bool sRGB, bool normalMap
     std::strcpy(newImage->mime_type, mimeType.data());
     texture->basisu_image = newImage;
     texture->has_basisu = true;
+    convertedImages[sourceImage] = newImage - dataCGLTF->images;
 
     return true;
 }
@@ -0,0 +1,474 @@
+/**
+ * Copyright Matthew Oliver
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "GLTFWriter.h"
+#include "Optimiser.h"
+#include "Shared.h"
+#include "SharedCGLTF.h"
+
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <map>
+#include <span>
+#include <sstream>
+#include <vector>
+
+using namespace std;
+
+namespace {
+struct TileNode
+{
+    cgltf_node* node;
+    array<cgltf_float, 3> boundsMin;
+    array<cgltf_float, 3> boundsMax;
+};
+
+struct Tile
+{
+    array<cgltf_float, 3> boundsMin;
+    array<cgltf_float, 3> boundsMax;
+    vector<cgltf_node*> nodes;
+    vector<cgltf_size> children;
+    string content;
+};
+
+cgltf_size buildTiles(vector<Tile>& tiles, span<TileNode> nodes, cgltf_size maxNodes) noexcept
+{
+    const cgltf_size index = tiles.size();
+    tiles.emplace_back();
+    array<cgltf_float, 3> centerMin, centerMax;
+    tiles[index].boundsMin.fill(numeric_limits<cgltf_float>::max());
+    tiles[index].boundsMax.fill(numeric_limits<cgltf_float>::lowest());
+    centerMin.fill(numeric_limits<cgltf_float>::max());
+    centerMax.fill(numeric_limits<cgltf_float>::lowest());
+    for (auto& node : nodes) {
+        for (cgltf_size c = 0; c < 3; ++c) {
+            tiles[index].boundsMin[c] = std::min(tiles[index].boundsMin[c], node.boundsMin[c]);
+            tiles[index].boundsMax[c] = std::max(tiles[index].boundsMax[c], node.boundsMax[c]);
+            const cgltf_float center = (node.boundsMin[c] + node.boundsMax[c]) * 0.5f;
+            centerMin[c] = std::min(centerMin[c], center);
+            centerMax[c] = std::max(centerMax[c], center);
+        }
+    }
+    if (nodes.size() <= maxNodes) {
+        for (auto& node : nodes) {
+            tiles[index].nodes.push_back(node.node);
+        }
+        return index;
+    }
+
+    // Split the nodes in half along the axis with the largest spread of node centers
+    cgltf_size axis = 0;
+    for (cgltf_size c = 1; c < 3; ++c) {
+        if (centerMax[c] - centerMin[c] > centerMax[axis] - centerMin[axis]) {
+            axis = c;
+        }
+    }
+    const cgltf_size half = nodes.size() / 2;
+    ranges::nth_element(nodes, nodes.begin() + half, [axis](const TileNode& a, const TileNode& b) {
+        return a.boundsMin[axis] + a.boundsMax[axis] < b.boundsMin[axis] + b.boundsMax[axis];
+    });
+    const cgltf_size left = buildTiles(tiles, nodes.first(half), maxNodes);
+    const cgltf_size right = buildTiles(tiles, nodes.subspan(half), maxNodes);
+    tiles[index].children = {left, right};
+    return index;
+}
+
+template<typename T>
+struct Subset
+{
+    void add(const T* element) noexcept
+    {
+        if (element != nullptr && indices.try_emplace(element, elements.size()).second) {
+            elements.push_back(*element);
+        }
+    }
+
+    T* remap(const T* element) noexcept
+    {
+        return (element != nullptr) ? &elements[indices.at(element)] : nullptr;
+    }
+
+    vector<T> elements;
+    map<const T*, cgltf_size> indices;
+};
+
+bool writeTile(const cgltf_data& data, const vector<cgltf_node*>& nodes, const string& outputFolder,
+    const string& tileFile, const vector<string>& imageFiles) noexcept
+{
+    // Collect everything referenced by the tile's nodes, the tile only holds copies of the source objects so all
+    // strings and extension data remain shared with the source
+    Subset<cgltf_mesh> meshes;
+    Subset<cgltf_material> materials;
+    Subset<cgltf_texture> textures;
+    Subset<cgltf_image> images;
+    Subset<cgltf_sampler> samplers;
+    Subset<cgltf_accessor> accessors;
+    Subset<cgltf_buffer_view> views;
+    for (auto& node : nodes) {
+        meshes.add(node->mesh);
+        for (cgltf_size k = 0; node->has_mesh_gpu_instancing && k < node->mesh_gpu_instancing.attributes_count; ++k) {
+            accessors.add(node->mesh_gpu_instancing.attributes[k].data);
+        }
+    }
+    for (auto& mesh : meshes.elements) {
+        for (cgltf_size j = 0; j < mesh.primitives_count; ++j) {
+            const cgltf_primitive& prim = mesh.primitives[j];
+            materials.add(prim.material);
+            accessors.add(prim.indices);
+            for (cgltf_size k = 0; k < prim.attributes_count; ++k) {
+                accessors.add(prim.attributes[k].data);
+            }
+            for (cgltf_size t = 0; t < prim.targets_count; ++t) {
+                for (cgltf_size k = 0; k < prim.targets[t].attributes_count; ++k) {
+                    accessors.add(prim.targets[t].attributes[k].data);
+                }
+            }
+        }
+    }
+    for (auto& material : materials.elements) {
+        runOverMaterialTextureViews(material, [&](cgltf_texture_view& view) { textures.add(view.texture); });
+    }
+    for (auto& texture : textures.elements) {
+        images.add(texture.image);
+        images.add(texture.basisu_image);
+        samplers.add(texture.sampler);
+    }
+    for (auto& accessor : accessors.elements) {
+        views.add(accessor.buffer_view);
+        if (accessor.is_sparse) {
+            views.add(accessor.sparse.indices_buffer_view);
+            views.add(accessor.sparse.values_buffer_view);
+        }
+    }
+    // Embedded images are shared by all tiles through files written once, instead of being copied into each tile
+    for (auto& [source, index] : images.indices) {
+        const string& imageFile = imageFiles[source - data.images];
+        cgltf_image& image = images.elements[index];
+        if (!imageFile.empty()) {
+            image.uri = const_cast<char*>(imageFile.c_str());
+            image.buffer_view = nullptr;
+        }
+        views.add(image.buffer_view);
+    }
+
+    // Pack all used buffer views into a single buffer for the tile
+    cgltf_size packedSize = 0;
+    for (auto& view : views.elements) {
+        packedSize = ((packedSize + 3) & ~cgltf_size(3)) + view.size;
+    }
+    vector<uint8_t> packedData(packedSize, 0);
+    const string bufferFile = getSidecarFileName(tileFile, ".bin"sv);
+    cgltf_buffer buffer = {0};
+    buffer.uri = const_cast<char*>(bufferFile.c_str());
+    buffer.size = packedSize;
+    cgltf_size offset = 0;
+    for (auto& view : views.elements) {
+        offset = (offset + 3) & ~cgltf_size(3);
+        memcpy(packedData.data() + offset, static_cast<const uint8_t*>(view.buffer->data) + view.offset, view.size);
+        view.buffer = &buffer;
+        view.offset = offset;
+        offset += view.size;
+    }
+
+    // Update all copied objects to reference the tile's copies
+    for (auto& accessor : accessors.elements) {
+        accessor.buffer_view = views.remap(accessor.buffer_view);
+        if (accessor.is_sparse) {
+            accessor.sparse.indices_buffer_view = views.remap(accessor.sparse.indices_buffer_view);
+            accessor.sparse.values_buffer_view = views.remap(accessor.sparse.values_buffer_view);
+        }
+    }
+    for (auto& image : images.elements) {
+        image.buffer_view = views.remap(image.buffer_view);
+    }
+    for (auto& texture : textures.elements) {
+        texture.image = images.remap(texture.image);
+        texture.basisu_image = images.remap(texture.basisu_image);
+        texture.sampler = samplers.remap(texture.sampler);
+    }
+    for (auto& material : materials.elements) {
+        runOverMaterialTextureViews(
+            material, [&](cgltf_texture_view& view) { view.texture = textures.remap(view.texture); });
+    }
+    vector<vector<cgltf_primitive>> primitives;
+    vector<vector<cgltf_attribute>> attributes;
+    vector<vector<cgltf_morph_target>> targets;
+    vector<vector<cgltf_extension>> extensions;
+    auto copyAttributes = [&](cgltf_attribute*& source, cgltf_size count) {
+        attributes.emplace_back(source, source + count);
+        for (auto& attribute : attributes.back()) {
+            attribute.data = accessors.remap(attribute.data);
+        }
+        source = attributes.back().data();
+    };
+    for (auto& mesh : meshes.elements) {
+        primitives.emplace_back(mesh.primitives, mesh.primitives + mesh.primitives_count);
+        for (auto& prim : primitives.back()) {
+            prim.material = materials.remap(prim.material);
+            prim.indices = accessors.remap(prim.indices);
+            copyAttributes(prim.attributes, prim.attributes_count);
+            targets.emplace_back(prim.targets, prim.targets + prim.targets_count);
+            for (auto& target : targets.back()) {
+                copyAttributes(target.attributes, target.attributes_count);
+            }
+            prim.targets = targets.back().data();
+            // Material variants are not carried across to tiles
+            prim.mappings = nullptr;
+            prim.mappings_count = 0;
+            // Meshlet data is indexed by the source file's meshes so is not valid for the tile
+            auto& primExtensions = extensions.emplace_back();
+            for (cgltf_size k = 0; k < prim.extensions_count; ++k) {
+                if (prim.extensions[k].name == nullptr || prim.extensions[k].name != meshletExtension) {
+                    primExtensions.push_back(prim.extensions[k]);
+                }
+            }
+            prim.extensions = primExtensions.data();
+            prim.extensions_count = primExtensions.size();
+        }
+        mesh.primitives = primitives.back().data();
+    }
+
+    // Nodes are added to the tile as roots with their hierarchy baked into their transform
+    vector<cgltf_node> tileNodes;
+    vector<cgltf_node*> rootNodes;
+    tileNodes.reserve(nodes.size());
+    for (auto& node : nodes) {
+        cgltf_node& copy = tileNodes.emplace_back(*node);
+        cgltf_node_transform_world(node, copy.matrix);
+        copy.has_matrix = true;
+        copy.has_translation = false;
+        copy.has_rotation = false;
+        copy.has_scale = false;
+        copy.parent = nullptr;
+        copy.children = nullptr;
+        copy.children_count = 0;
+        copy.skin = nullptr;
+        copy.camera = nullptr;
+        copy.light = nullptr;
+        copy.mesh = meshes.remap(copy.mesh);
+        if (copy.has_mesh_gpu_instancing) {
+            copy.mesh_gpu_instancing.buffer_view = views.remap(copy.mesh_gpu_instancing.buffer_view);
+            copyAttributes(copy.mesh_gpu_instancing.attributes, copy.mesh_gpu_instancing.attributes_count);
+        }
+        rootNodes.push_back(&copy);
+    }
+    cgltf_scene scene = {0};
+    scene.nodes = rootNodes.data();
+    scene.nodes_count = rootNodes.size();
+
+    // Build a view of the source data that only contains the tile's objects
+    cgltf_data tile = {};
+    tile.file_type = cgltf_file_type_gltf;
+    tile.asset = data.asset;
+    tile.json = data.json;
+    tile.json_size = data.json_size;
+    // Only list the extensions created by this tool that the tile still contains, other extensions are listed by the
+    // writer based on what it writes
+    vector<char*> extensionsUsed;
+    for (cgltf_size i = 0; i < data.extensions_used_count; ++i) {
+        const string_view name = data.extensions_used[i];
+        const bool used = ranges::any_of(extensions, [&](const auto& primExtensions) {
+            return ranges::any_of(primExtensions, [&](const auto& extension) {
+                return extension.name != nullptr && extension.name == name;
+            });
+        });
+        if (used) {
+            extensionsUsed.push_back(data.extensions_used[i]);
+        }
+    }
+    tile.extensions_used = extensionsUsed.data();
+    tile.extensions_used_count = extensionsUsed.size();
+    tile.meshes = meshes.elements.data();
+    tile.meshes_count = meshes.elements.size();
+    tile.materials = materials.elements.data();
+    tile.materials_count = materials.elements.size();
+    tile.accessors = accessors.elements.data();
+    tile.accessors_count = accessors.elements.size();
+    tile.buffer_views = views.elements.data();
+    tile.buffer_views_count = views.elements.size();
+    tile.buffers = (packedSize > 0) ? &buffer : nullptr;
+    tile.buffers_count = (packedSize > 0) ? 1 : 0;
+    tile.images = images.elements.data();
+    tile.images_count = images.elements.size();
+    tile.textures = textures.elements.data();
+    tile.textures_count = textures.elements.size();
+    tile.samplers = samplers.elements.data();
+    tile.samplers_count = samplers.elements.size();
+    tile.nodes = tileNodes.data();
+    tile.nodes_count = tileNodes.size();
+    tile.scenes = &scene;
+    tile.scenes_count = 1;
+    tile.scene = &scene;
+
+    // Write out tile buffer and gltf
+    if (packedSize > 0) {
+        ofstream file(outputFolder + bufferFile, ios::binary);
+        if (!file.write(reinterpret_cast<const char*>(packedData.data()), static_cast<streamsize>(packedSize))
+                 .good()) {
+            printError("Failed writing output tile buffer file: "s + outputFolder + bufferFile);
+            return false;
+        }
+    }
+    return GLTFWriter(tile).writeGLTF(outputFolder + tileFile);
+}
+
+cgltf_float getDiagonal(const Tile& tile) noexcept
+{
+    cgltf_float lengthSquared = 0.0f;
+    for (cgltf_size c = 0; c < 3; ++c) {
+        lengthSquared += (tile.boundsMax[c] - tile.boundsMin[c]) * (tile.boundsMax[c] - tile.boundsMin[c]);
+    }
+    return sqrtf(lengthSquared);
+}
+
+void writeTileJson(ostream& json, const vector<Tile>& tiles, cgltf_size index) noexcept
+{
+    // Tilesets are z-up so the gltf y-up bounds are rotated into place
+    const Tile& tile = tiles[index];
+    array<cgltf_float, 3> center, extent;
+    for (cgltf_size c = 0; c < 3; ++c) {
+        center[c] = (tile.boundsMin[c] + tile.boundsMax[c]) * 0.5f;
+        extent[c] = (tile.boundsMax[c] - tile.boundsMin[c]) * 0.5f;
+    }
+    // Only leaf tiles have content so parent tiles must always be refined
+    const cgltf_float error = tile.children.empty() ? 0.0f : getDiagonal(tile);
+    json << "{\"boundingVolume\":{\"box\":[" << center[0] << ',' << -center[2] << ',' << center[1] << ',' << extent[0]
+         << ",0,0,0," << extent[2] << ",0,0,0," << extent[1] << "]},\"geometricError\":" << error
+         << ",\"refine\":\"ADD\"";
+    if (!tile.content.empty()) {
+        json << ",\"content\":{\"uri\":\"" << tile.content << "\"}";
+    }
+    if (!tile.children.empty()) {
+        json << ",\"children\":[";
+        for (cgltf_size i = 0; i < tile.children.size(); ++i) {
+            json << ((i > 0) ? "," : "");
+            writeTileJson(json, tiles, tile.children[i]);
+        }
+        json << ']';
+    }
+    json << '}';
+}
+} // namespace
+
+bool Optimiser::passTiles(const std::string& outputFile) noexcept
+{
+    if (!requireBuffers()) {
+        return false;
+    }
+
+    // Gather all mesh nodes in the default scene along with their world space bounds
+    vector<TileNode> tileNodes;
+    vector<cgltf_node*> stack;
+    if (const cgltf_scene* scene = (dataCGLTF->scene != nullptr) ? dataCGLTF->scene : dataCGLTF->scenes;
+        scene != nullptr) {
+        stack.assign(scene->nodes, scene->nodes + scene->nodes_count);
+    }
+    while (!stack.empty()) {
+        cgltf_node* node = stack.back();
+        stack.pop_back();
+        stack.insert(stack.end(), node->children, node->children + node->children_count);
+        TileNode tileNode = {node};
+        if (!getWorldBounds(*node, tileNode.boundsMin, tileNode.boundsMax)) {
+            continue;
+        }
+        for (cgltf_size j = 0; j < node->mesh->primitives_count; ++j) {
+            if (node->mesh->primitives[j].has_draco_mesh_compression) {
+                printError("Tiled output does not support Draco compressed meshes"sv);
+                return false;
+            }
+        }
+        tileNodes.push_back(tileNode);
+    }
+    for (cgltf_size i = 0; i < dataCGLTF->buffer_views_count; ++i) {
+        const cgltf_buffer_view& view = dataCGLTF->buffer_views[i];
+        if (view.has_meshopt_compression || view.buffer == nullptr || view.buffer->data == nullptr) {
+            printError("Buffer data missing when creating tiles for buffer view: "s + to_string(i));
+            return false;
+        }
+    }
+    if (tileNodes.empty()) {
+        printError("No mesh nodes found to create tiles from"sv);
+        return false;
+    }
+    if (dataCGLTF->skins_count > 0 || dataCGLTF->animations_count > 0) {
+        printWarning("Skins and animations are not included in tiled output"sv);
+    }
+    if (options.generateMeshlets) {
+        printWarning("Meshlets are not included in tiled output"sv);
+    }
+
+    // Write embedded images to separate files that every tile using them can reference
+    const string outputFolder = getFolder(outputFile);
+    vector<string> imageFiles(dataCGLTF->images_count);
+    for (cgltf_size i = 0; i < dataCGLTF->images_count; ++i) {
+        const cgltf_image& image = dataCGLTF->images[i];
+        if (image.buffer_view == nullptr) {
+            continue;
+        }
+        const string_view mimeType = (image.mime_type != nullptr) ? image.mime_type : "";
+        const string_view extension = (mimeType == "image/ktx2"sv) ? ".ktx2"sv :
+            (mimeType == "image/png"sv)                            ? ".png"sv :
+            (mimeType == "image/jpeg"sv)                           ? ".jpg"sv :
+                                                                     ".bin"sv;
+        imageFiles[i] = getSidecarFileName(outputFile, "_image"s + to_string(i) + string(extension));
+        const cgltf_buffer_view& view = *image.buffer_view;
+        if (!writeFile(outputFolder + imageFiles[i],
+                {span(static_cast<const uint8_t*>(view.buffer->data) + view.offset, view.size)})) {
+            printError("Failed writing output tile image file: "s + outputFolder + imageFiles[i]);
+            return false;
+        }
+    }
+
+    // Sort nodes into a k-d tree where each leaf becomes a tile
+    vector<Tile> tiles;
+    buildTiles(tiles, tileNodes, options.tileMaxNodes);
+
+    // Write each tile in a separate job
+    vector<future<bool>> jobs;
+    cgltf_size tileCount = 0;
+    for (auto& tile : tiles) {
+        if (!tile.nodes.empty()) {
+            tile.content = getSidecarFileName(outputFile, "_tile"s + to_string(tileCount++) + ".gltf");
+            jobs.push_back(pool.submit([this, &tile, &outputFolder, &imageFiles]() {
+                return writeTile(*dataCGLTF, tile.nodes, outputFolder, tile.content, imageFiles);
+            }));
+        }
+    }
+    bool success = true;
+    for (auto& job : jobs) {
+        success = job.get() && success;
+    }
+    if (!success) {
+        return false;
+    }
+
+    // Write out tileset index describing the bounds of each tile
+    const string tilesetFile = getSidecarFileName(outputFile, ".tileset.json"sv);
+    printInfo("Writing output tileset file: "s + outputFolder + tilesetFile + " (" + to_string(tileCount) + " tiles)");
+    ostringstream json;
+    json.precision(9);
+    json << "{\"asset\":{\"version\":\"1.1\"},\"geometricError\":" << getDiagonal(tiles[0]) << ",\"root\":";
+    writeTileJson(json, tiles, 0);
+    json << "}";
+    ofstream file(outputFolder + tilesetFile);
+    if (!(file << json.str()).good()) {
+        printError("Failed writing output tileset file: "s + outputFolder + tilesetFile);
+        return false;
+    }
+    return true;
+}
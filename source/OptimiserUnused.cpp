@@ -18,11 +18,93 @@
 #include "Shared.h"
 #include "SharedCGLTF.h"
 
+#include <algorithm>
+#include <cstring>
+#include <map>
 #include <ranges>
 #include <set>
+#include <string>
+#include <vector>
 
 using namespace std;
 
+namespace {
+set<cgltf_int> getMaterialTexcoords(cgltf_material& material) noexcept
+{
+    set<cgltf_int> texcoords;
+    runOverMaterialTextureViews(material, [&](const cgltf_texture_view& view) {
+        if (view.texture != nullptr) {
+            texcoords.insert(
+                (view.has_transform && view.transform.has_texcoord) ? view.transform.texcoord : view.texcoord);
+        }
+    });
+    return texcoords;
+}
+
+map<cgltf_int, cgltf_int> getSetRemap(
+    const cgltf_primitive& prim, cgltf_attribute_type type, const set<cgltf_int>& removed) noexcept
+{
+    // Remaining sets are numbered in order starting from 0
+    set<cgltf_int> kept;
+    for (cgltf_size i = 0; i < prim.attributes_count; ++i) {
+        if (prim.attributes[i].type == type && !removed.contains(prim.attributes[i].index)) {
+            kept.insert(prim.attributes[i].index);
+        }
+    }
+    map<cgltf_int, cgltf_int> remap;
+    cgltf_int next = 0;
+    for (auto& index : kept) {
+        remap[index] = next++;
+    }
+    return remap;
+}
+
+void removeAttribute(cgltf_attribute* attributes, cgltf_size& count, cgltf_size index) noexcept
+{
+    free(attributes[index].name);
+    memmove(&attributes[index], &attributes[index + 1], (count - index - 1) * sizeof(cgltf_attribute));
+    --count;
+}
+
+void removePrimitiveAttribute(cgltf_primitive& prim, cgltf_size index) noexcept
+{
+    // Any matching morph target attributes are removed as well
+    for (cgltf_size t = 0; t < prim.targets_count; ++t) {
+        cgltf_morph_target& target = prim.targets[t];
+        if (const cgltf_attribute* found =
+                findAttribute(target.attributes, target.attributes_count, prim.attributes[index]);
+            found != nullptr) {
+            removeAttribute(target.attributes, target.attributes_count, found - target.attributes);
+        }
+    }
+    removeAttribute(prim.attributes, prim.attributes_count, index);
+}
+
+void renameAttribute(cgltf_attribute& attribute, cgltf_int index) noexcept
+{
+    // Set attributes are named by their semantic followed by the set index (e.g. TEXCOORD_1)
+    const string_view name = attribute.name;
+    const string newName = string(name.substr(0, name.rfind('_') + 1)) + to_string(index);
+    if (auto newMemory = static_cast<char*>(realloc(attribute.name, newName.length() + 1)); newMemory != nullptr) {
+        attribute.name = newMemory;
+        strcpy(attribute.name, newName.c_str());
+        attribute.index = index;
+    }
+}
+
+void renamePrimitiveAttribute(cgltf_primitive& prim, cgltf_attribute& attribute, cgltf_int index) noexcept
+{
+    for (cgltf_size t = 0; t < prim.targets_count; ++t) {
+        cgltf_morph_target& target = prim.targets[t];
+        if (const cgltf_attribute* found = findAttribute(target.attributes, target.attributes_count, attribute);
+            found != nullptr) {
+            renameAttribute(target.attributes[found - target.attributes], index);
+        }
+    }
+    renameAttribute(attribute, index);
+}
+} // namespace
+
 void Optimiser::checkUnusedImages() noexcept
 {
     // Loop through all textures and check for unused images
@@ -49,7 +131,7 @@ void Optimiser::checkUnusedImages() noexcept
     // Remove any found unused images
     for (auto& i : removedImages | views::reverse) {
         printWarning("Removed unused image: "s + getName(*i));
-        if (i->uri != nullptr) {
+        if (i->uri != nullptr && strncmp(i->uri, "data:", 5) != 0) {
             // Delete file from disk
             string imageFile = rootFolder + i->uri;
             remove(imageFile.c_str());
@@ -120,8 +202,25 @@ void Optimiser::checkUnusedMaterials() noexcept
 void Optimiser::checkUnusedMeshes() noexcept
 {
     // Loop through all nodes and check for unused meshes
+    set<cgltf_mesh*> validMeshes;
+    for (cgltf_size i = 0; i < dataCGLTF->nodes_count; ++i) {
+        cgltf_node& node = dataCGLTF->nodes[i];
+        if (node.mesh != nullptr) {
+            validMeshes.insert(node.mesh);
+        }
+    }
+
+    // Loop through all meshes and compare against the found ones
     set<cgltf_mesh*> removedMeshes;
-    // TODO
+    if (dataCGLTF->nodes_count > 0) {
+        // Files without any nodes only contain loose meshes so these are left untouched
+        for (cgltf_size i = 0; i < dataCGLTF->meshes_count; ++i) {
+            cgltf_mesh* mesh = &dataCGLTF->meshes[i];
+            if (!validMeshes.contains(mesh)) {
+                removedMeshes.insert(mesh);
+            }
+        }
+    }
 
     // Remove any found invalid meshes
     for (auto& i : removedMeshes | views::reverse) {
@@ -130,6 +229,235 @@ void Optimiser::checkUnusedMeshes() noexcept
     }
 }
 
+void Optimiser::checkUnusedAttributes() noexcept
+{
+    // Find all meshes that are drawn with a skin
+    set<const cgltf_mesh*> skinnedMeshes;
+    for (cgltf_size i = 0; i < dataCGLTF->nodes_count; ++i) {
+        cgltf_node& node = dataCGLTF->nodes[i];
+        if (node.mesh != nullptr && node.skin != nullptr) {
+            skinnedMeshes.insert(node.mesh);
+        }
+    }
+
+    // Texture coordinate sets are only removed once it is known that the remaining sets can be renumbered
+    struct Usage
+    {
+        cgltf_primitive* prim = nullptr;
+        vector<cgltf_material*> materials;
+        set<cgltf_int> removedTexcoords;
+    };
+    vector<Usage> usages;
+    cgltf_size removedAttributes = 0;
+    for (cgltf_size i = 0; i < dataCGLTF->meshes_count; ++i) {
+        cgltf_mesh& mesh = dataCGLTF->meshes[i];
+        // Files without any nodes only contain loose meshes so skinning data is left untouched
+        const bool skinned = dataCGLTF->nodes_count == 0 || skinnedMeshes.contains(&mesh);
+        for (cgltf_size j = 0; j < mesh.primitives_count; ++j) {
+            cgltf_primitive& prim = mesh.primitives[j];
+            if (prim.has_draco_mesh_compression) {
+                continue;
+            }
+
+            // Collect the attributes read by every material the primitive can be drawn with
+            Usage usage = {&prim};
+            set<cgltf_int> texcoords;
+            bool allTexcoords = false;
+            bool tangents = false;
+            auto addMaterial = [&](cgltf_material* material) {
+                if (material == nullptr) {
+                    return;
+                }
+                usage.materials.push_back(material);
+                // Unknown material extensions may read any texture coordinate set
+                allTexcoords = allTexcoords || material->extensions_count > 0;
+                texcoords.merge(getMaterialTexcoords(*material));
+                tangents = tangents || material->normal_texture.texture != nullptr ||
+                    (material->has_clearcoat && material->clearcoat.clearcoat_normal_texture.texture != nullptr);
+            };
+            addMaterial(prim.material);
+            for (cgltf_size k = 0; k < prim.mappings_count; ++k) {
+                addMaterial(prim.mappings[k].material);
+            }
+            auto isUsed = [&](const cgltf_attribute& attribute) {
+                switch (attribute.type) {
+                    case cgltf_attribute_type_tangent:
+                        return tangents;
+                    case cgltf_attribute_type_color:
+                        // Only the first vertex color set is used by materials
+                        return attribute.index == 0;
+                    case cgltf_attribute_type_joints:
+                    case cgltf_attribute_type_weights:
+                        return skinned;
+                    default:
+                        return true;
+                }
+            };
+
+            // Remove unused attributes along with any matching morph target attributes
+            for (cgltf_size k = prim.attributes_count; k-- > 0;) {
+                const cgltf_attribute& attribute = prim.attributes[k];
+                if (attribute.type == cgltf_attribute_type_texcoord && !allTexcoords &&
+                    !texcoords.contains(attribute.index)) {
+                    usage.removedTexcoords.insert(attribute.index);
+                } else if (!isUsed(attribute)) {
+                    removePrimitiveAttribute(prim, k);
+                    ++removedAttributes;
+                }
+            }
+            usages.push_back(std::move(usage));
+        }
+    }
+
+    // Materials shared by several primitives must see the same renumbered sets from each of them, any primitive that
+    // conflicts keeps all of its texture coordinates until every remaining material has a single consistent mapping
+    map<cgltf_material*, map<cgltf_int, cgltf_int>> materialRemaps;
+    for (bool conflict = true; conflict;) {
+        conflict = false;
+        materialRemaps.clear();
+        set<cgltf_material*> conflicted;
+        for (auto& usage : usages) {
+            const map<cgltf_int, cgltf_int> remap =
+                getSetRemap(*usage.prim, cgltf_attribute_type_texcoord, usage.removedTexcoords);
+            for (auto& material : usage.materials) {
+                auto& materialRemap = materialRemaps[material];
+                for (auto& texcoord : getMaterialTexcoords(*material)) {
+                    if (auto pos = remap.find(texcoord); pos != remap.end()) {
+                        if (auto [current, added] = materialRemap.try_emplace(texcoord, pos->second);
+                            !added && current->second != pos->second) {
+                            conflicted.insert(material);
+                        }
+                    }
+                }
+            }
+        }
+        for (auto& usage : usages) {
+            if (!usage.removedTexcoords.empty() &&
+                ranges::any_of(usage.materials, [&](auto material) { return conflicted.contains(material); })) {
+                usage.removedTexcoords.clear();
+                conflict = true;
+            }
+        }
+    }
+
+    // Remove unused texture coordinate sets and renumber the remaining sets of each type so that they are contiguous
+    for (auto& usage : usages) {
+        cgltf_primitive& prim = *usage.prim;
+        for (cgltf_size k = prim.attributes_count; k-- > 0;) {
+            if (prim.attributes[k].type == cgltf_attribute_type_texcoord &&
+                usage.removedTexcoords.contains(prim.attributes[k].index)) {
+                removePrimitiveAttribute(prim, k);
+                ++removedAttributes;
+            }
+        }
+        for (auto type : {cgltf_attribute_type_texcoord, cgltf_attribute_type_color}) {
+            // Sets are renamed in ascending order so that a new name never matches a set that is yet to be renamed
+            for (auto& [from, to] : getSetRemap(prim, type, {})) {
+                if (from != to) {
+                    renamePrimitiveAttribute(prim, *findAttribute(prim, type, from), to);
+                }
+            }
+        }
+    }
+    for (auto& [material, remap] : materialRemaps) {
+        runOverMaterialTextureViews(*material, [&](cgltf_texture_view& view) {
+            if (auto pos = remap.find(view.texcoord); pos != remap.end()) {
+                view.texcoord = pos->second;
+            }
+            if (view.has_transform && view.transform.has_texcoord) {
+                if (auto pos = remap.find(view.transform.texcoord); pos != remap.end()) {
+                    view.transform.texcoord = pos->second;
+                }
+            }
+        });
+    }
+    if (removedAttributes > 0) {
+        printInfo("Removed unused vertex attributes: "s + to_string(removedAttributes));
+    }
+}
+
+void Optimiser::checkUnusedAccessors() noexcept
+{
+    // Loop through all accessor users and check for unused accessors
+    set<cgltf_accessor*> validAccessors;
+    runOverAccessors(*dataCGLTF, [&](cgltf_accessor*& p) {
+        if (p != nullptr) {
+            validAccessors.insert(p);
+        }
+    });
+
+    // Loop through all accessors and compare against the found ones
+    set<cgltf_accessor*> removedAccessors;
+    for (cgltf_size i = 0; i < dataCGLTF->accessors_count; ++i) {
+        cgltf_accessor* accessor = &dataCGLTF->accessors[i];
+        if (!validAccessors.contains(accessor)) {
+            removedAccessors.insert(accessor);
+        }
+    }
+
+    // Remove any found unused accessors
+    for (auto& i : removedAccessors | views::reverse) {
+        removeAccessor(i);
+    }
+    if (!removedAccessors.empty()) {
+        printInfo("Removed unused accessors: "s + to_string(removedAccessors.size()));
+    }
+}
+
+void Optimiser::checkUnusedBufferViews() noexcept
+{
+    // Loop through all buffer view users and check for unused buffer views
+    set<cgltf_buffer_view*> validViews;
+    runOverBufferViews(*dataCGLTF, [&](cgltf_buffer_view*& p) {
+        if (p != nullptr) {
+            validViews.insert(p);
+        }
+    });
+
+    // Loop through all buffer views and compare against the found ones
+    set<cgltf_buffer_view*> removedViews;
+    for (cgltf_size i = 0; i < dataCGLTF->buffer_views_count; ++i) {
+        cgltf_buffer_view* view = &dataCGLTF->buffer_views[i];
+        if (!validViews.contains(view)) {
+            removedViews.insert(view);
+        }
+    }
+
+    // Remove any found unused buffer views
+    for (auto& i : removedViews | views::reverse) {
+        removeBufferView(i);
+    }
+    if (!removedViews.empty()) {
+        printInfo("Removed unused buffer views: "s + to_string(removedViews.size()));
+    }
+}
+
+void Optimiser::checkUnusedBuffers() noexcept
+{
+    // Loop through all buffer views and check for unused buffers
+    set<cgltf_buffer*> validBuffers;
+    runOverBuffers(*dataCGLTF, [&](cgltf_buffer*& p) {
+        if (p != nullptr) {
+            validBuffers.insert(p);
+        }
+    });
+
+    // Loop through all buffers and compare against the found ones
+    set<cgltf_buffer*> removedBuffers;
+    for (cgltf_size i = 0; i < dataCGLTF->buffers_count; ++i) {
+        cgltf_buffer* buffer = &dataCGLTF->buffers[i];
+        if (!validBuffers.contains(buffer)) {
+            removedBuffers.insert(buffer);
+        }
+    }
+
+    // Remove any found unused buffers
+    for (auto& i : removedBuffers | views::reverse) {
+        printWarning("Removed unused buffer: "s + ((i->uri != nullptr) ? i->uri : "unnamed"));
+        removeBuffer(i);
+    }
+}
+
 void Optimiser::passUnused() noexcept
 {
     // Order of operations must be performed bottom up
@@ -137,4 +465,8 @@ void Optimiser::passUnused() noexcept
     checkUnusedMaterials();
     checkUnusedTextures();
     checkUnusedImages();
+    checkUnusedAttributes();
+    checkUnusedAccessors();
+    checkUnusedBufferViews();
+    checkUnusedBuffers();
 }
@@ -0,0 +1,435 @@
+/**
+ * Copyright Matthew Oliver
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "Server.h"
+
+#include "Shared.h"
+#include "TextureCache.h"
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <charconv>
+#include <chrono>
+#include <condition_variable>
+#include <cstring>
+#include <filesystem>
+#include <mutex>
+#include <semaphore>
+#include <thread>
+
+#ifndef _WIN32
+#    include <cerrno>
+#    include <csignal>
+#    include <poll.h>
+#    include <sys/socket.h>
+#    include <sys/stat.h>
+#    include <sys/un.h>
+#    include <unistd.h>
+#endif
+
+using namespace std;
+
+#ifndef _WIN32
+namespace {
+atomic<bool> stopServer = false;
+
+void handleSignal(int) noexcept
+{
+    stopServer = true;
+}
+
+/**
+ * Run a function over every option along with its name. Requests send each option as a 'name=value' line.
+ */
+template<typename Function>
+void runOverOptions(Optimiser::Options& options, Function function) noexcept
+{
+    function("keepOriginalTextures"sv, options.keepOriginalTextures);
+    function("replaceCompressedTextures"sv, options.replaceCompressedTextures);
+    function("splitMetalRoughTextures"sv, options.splitMetalRoughTextures);
+    function("flattenStaticNodes"sv, options.flattenStaticNodes);
+    function("instancingMinimum"sv, options.instancingMinimum);
+    function("dracoCompressMeshes"sv, options.dracoCompressMeshes);
+    function("generateMeshlets"sv, options.generateMeshlets);
+    function("meshletMaxVertices"sv, options.meshletMaxVertices);
+    function("meshletMaxTriangles"sv, options.meshletMaxTriangles);
+    function("morphTargetEpsilon"sv, options.morphTargetEpsilon);
+    function("animationTolerance"sv, options.animationTolerance);
+    function("quantiseRotations"sv, options.quantiseRotations);
+    function("spatialSort"sv, options.spatialSort);
+    function("tileMaxNodes"sv, options.tileMaxNodes);
+    function("texturesOnly"sv, options.texturesOnly);
+    function("outputGLB"sv, options.outputGLB);
+    function("resume"sv, options.resume);
+    function("incremental"sv, options.incremental);
+    function("continueOnError"sv, options.continueOnError);
+    function("textureManifest"sv, options.textureManifest);
+}
+
+template<typename T>
+string toString(const T& value) noexcept
+{
+    if constexpr (is_same_v<T, bool>) {
+        return value ? "1"s : "0"s;
+    } else if constexpr (is_same_v<T, string>) {
+        return value;
+    } else {
+        // Floats are written using the shortest representation that reads back to the same value
+        array<char, 32> buffer;
+        const auto result = to_chars(buffer.data(), buffer.data() + buffer.size(), value);
+        return string(buffer.data(), result.ptr);
+    }
+}
+
+template<typename T>
+bool fromString(const string_view& text, T& value) noexcept
+{
+    if constexpr (is_same_v<T, bool>) {
+        value = (text == "1"sv);
+        return text == "1"sv || text == "0"sv;
+    } else if constexpr (is_same_v<T, string>) {
+        value = text;
+        return true;
+    } else {
+        const auto result = from_chars(text.data(), text.data() + text.size(), value);
+        return result.ec == errc() && result.ptr == text.data() + text.size();
+    }
+}
+
+class Connection
+{
+public:
+    Connection(int socket) noexcept
+        : handle(socket)
+    {}
+
+    ~Connection() noexcept
+    {
+        if (handle >= 0) {
+            ::close(handle);
+        }
+    }
+
+    Connection(const Connection&) = delete;
+
+    Connection& operator=(const Connection&) = delete;
+
+    /**
+     * Read the next line.
+     * @param line    Receives the line without its line ending.
+     * @param timeout (Optional) Fail if no data is received for this long or the server is stopped, zero waits
+     *  indefinitely.
+     * @return True if it succeeds, false if it fails.
+     */
+    [[nodiscard]] bool readLine(string& line, chrono::milliseconds timeout = chrono::milliseconds::zero()) noexcept
+    {
+        while (true) {
+            if (const size_t end = buffer.find('\n'); end != string::npos) {
+                line = buffer.substr(0, end);
+                buffer.erase(0, end + 1);
+                return true;
+            }
+            if (buffer.size() > maxLineSize) {
+                return false;
+            }
+            if (timeout > chrono::milliseconds::zero()) {
+                // Wait in short steps so that an idle client can neither hold a connection open nor block shutdown
+                pollfd request = {handle, POLLIN, 0};
+                const auto start = chrono::steady_clock::now();
+                int ready = 0;
+                while (ready == 0 && !stopServer && chrono::steady_clock::now() - start < timeout) {
+                    ready = poll(&request, 1, 250);
+                }
+                if (ready < 0 && errno == EINTR) {
+                    continue;
+                }
+                if (ready <= 0) {
+                    return false;
+                }
+            }
+            array<char, 4096> data;
+            const ssize_t count = ::read(handle, data.data(), data.size());
+            if (count < 0 && errno == EINTR) {
+                continue;
+            }
+            if (count <= 0) {
+                return false;
+            }
+            buffer.append(data.data(), static_cast<size_t>(count));
+        }
+    }
+
+    bool writeLine(const string& line) noexcept
+    {
+        // Progress may be reported from several pool threads at once
+        lock_guard<mutex> guard(writeLock);
+        const string data = line + '\n';
+        for (size_t written = 0; written < data.size();) {
+            const ssize_t count = ::write(handle, data.data() + written, data.size() - written);
+            if (count < 0 && errno == EINTR) {
+                continue;
+            }
+            if (count <= 0) {
+                return false;
+            }
+            written += static_cast<size_t>(count);
+        }
+        return true;
+    }
+
+private:
+    static constexpr size_t maxLineSize = 64 * 1024;
+    int handle = -1;
+    string buffer;
+    mutex writeLock;
+};
+
+bool openSocket(const string& socketPath, sockaddr_un& address, int& handle) noexcept
+{
+    if (socketPath.length() >= sizeof(address.sun_path)) {
+        printError("Socket path is too long: "s + socketPath);
+        return false;
+    }
+    address = {};
+    address.sun_family = AF_UNIX;
+    strcpy(address.sun_path, socketPath.c_str());
+    handle = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (handle < 0) {
+        printError("Failed to create socket: "s + strerror(errno));
+        return false;
+    }
+    return true;
+}
+
+/** Time a client may take to send each line of its request */
+constexpr chrono::seconds requestTimeout(30);
+
+void runJob(Connection& connection, BS::thread_pool& pool, TextureCache& textures, DecodedTextureCache& decoded,
+    counting_semaphore<>& jobSlots) noexcept
+{
+    // Read request, terminated by an empty line
+    string inputFile, outputFile, line;
+    Optimiser::Options options;
+    bool valid = true;
+    while (true) {
+        if (!connection.readLine(line, requestTimeout)) {
+            return;
+        }
+        if (line.empty()) {
+            break;
+        }
+        const size_t split = line.find('=');
+        if (split == string::npos) {
+            valid = false;
+            continue;
+        }
+        const string_view name = string_view(line).substr(0, split);
+        const string_view value = string_view(line).substr(split + 1);
+        if (name == "input"sv) {
+            inputFile = value;
+        } else if (name == "output"sv) {
+            outputFile = value;
+        } else {
+            bool found = false;
+            runOverOptions(options, [&](const string_view& option, auto& current) {
+                if (option == name) {
+                    found = fromString(value, current);
+                }
+            });
+            valid = valid && found;
+        }
+    }
+    if (!valid || inputFile.empty()) {
+        printError("Invalid job request received"sv);
+        connection.writeLine("failed"s);
+        return;
+    }
+
+    // Each job runs on its own thread waiting for its pool jobs, the number of active jobs is limited so that one
+    // large burst of requests does not hold every asset in memory at once
+    jobSlots.acquire();
+    printInfo("Starting job: "s + inputFile);
+    Optimiser optimiser(options, pool, textures, &decoded);
+    atomic<bool> disconnected = false;
+    optimiser.setProgressCallback([&](const string& stage) {
+        // Nobody is waiting on the result once the client has disconnected
+        if (!connection.writeLine("progress "s + stage)) {
+            disconnected = true;
+            optimiser.cancel();
+        }
+    });
+    const bool succeeded = optimiser.pass(inputFile, outputFile.empty() ? inputFile : outputFile);
+    jobSlots.release();
+    if (!succeeded && disconnected) {
+        printWarning("Cancelled job as the client disconnected: "s + inputFile);
+    } else if (!succeeded) {
+        printError("Failed job: "s + inputFile);
+    }
+    connection.writeLine(succeeded ? "done"s : "failed"s);
+}
+} // namespace
+
+bool runServer(const string& socketPath, uint32_t jobs, size_t cacheSize) noexcept
+{
+    sockaddr_un address;
+    int handle = -1;
+    if (!openSocket(socketPath, address, handle)) {
+        return false;
+    }
+    Connection server(handle);
+
+    // Replace a socket left behind by a previous server, any other type of file is left alone
+    struct stat status;
+    if (lstat(socketPath.c_str(), &status) == 0) {
+        if (!S_ISSOCK(status.st_mode)) {
+            printError("Socket path already exists and is not a socket: "s + socketPath);
+            return false;
+        }
+        unlink(socketPath.c_str());
+    }
+    // Jobs read and write files as the server's user so only that user may connect, the socket is created without
+    // any group or other permissions rather than changing them after it is already accepting connections
+    const mode_t mask = umask(0077);
+    const bool bound = bind(handle, reinterpret_cast<sockaddr*>(&address), sizeof(address)) == 0;
+    umask(mask);
+    if (!bound || listen(handle, SOMAXCONN) != 0) {
+        printError("Failed to listen on socket '"s + socketPath + "': " + strerror(errno));
+        return false;
+    }
+
+    // Stop cleanly when interrupted, a client disconnecting must not terminate the server
+    struct sigaction action = {};
+    action.sa_handler = handleSignal;
+    sigemptyset(&action.sa_mask);
+    sigaction(SIGINT, &action, nullptr);
+    sigaction(SIGTERM, &action, nullptr);
+    signal(SIGPIPE, SIG_IGN);
+
+    // The pool and caches persist for the lifetime of the server
+    BS::thread_pool pool;
+    TextureCache textures(cacheSize);
+    DecodedTextureCache decoded(cacheSize);
+    counting_semaphore<> jobSlots(std::max(jobs, 1U));
+    mutex activeLock;
+    condition_variable activeChanged;
+    uint32_t activeConnections = 0;
+    printInfo("Listening for jobs on: "s + socketPath);
+    while (!stopServer) {
+        // Poll with a timeout so that the stop request is seen regardless of which thread received the signal
+        pollfd request = {handle, POLLIN, 0};
+        const int ready = poll(&request, 1, 250);
+        if (ready < 0 && errno != EINTR) {
+            printError("Failed waiting for connections: "s + strerror(errno));
+            break;
+        }
+        if (ready <= 0) {
+            continue;
+        }
+        const int client = accept(handle, nullptr, nullptr);
+        if (client < 0) {
+            continue;
+        }
+        {
+            lock_guard<mutex> guard(activeLock);
+            ++activeConnections;
+        }
+        thread([&, client]() {
+            {
+                Connection connection(client);
+                runJob(connection, pool, textures, decoded, jobSlots);
+            }
+            lock_guard<mutex> guard(activeLock);
+            --activeConnections;
+            activeChanged.notify_all();
+        }).detach();
+    }
+
+    // Running jobs use the pool and caches so must complete before they are destroyed
+    printInfo("Stopping server, waiting for running jobs"sv);
+    unlink(socketPath.c_str());
+    unique_lock<mutex> guard(activeLock);
+    activeChanged.wait(guard, [&]() { return activeConnections == 0; });
+    return true;
+}
+
+bool submitJob(const string& socketPath, const string& inputFile, const string& outputFile,
+    const Optimiser::Options& options) noexcept
+{
+    sockaddr_un address;
+    int handle = -1;
+    if (!openSocket(socketPath, address, handle)) {
+        return false;
+    }
+    Connection connection(handle);
+    if (connect(handle, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0) {
+        printError("Failed to connect to server '"s + socketPath + "': " + strerror(errno));
+        return false;
+    }
+
+    // The server may run in a different working directory so all paths are sent as absolute paths
+    error_code ec;
+    const string input = filesystem::absolute(inputFile, ec).string();
+    const string output = filesystem::absolute(outputFile, ec).string();
+    Optimiser::Options sent = options;
+    if (!sent.textureManifest.empty()) {
+        sent.textureManifest = filesystem::absolute(sent.textureManifest, ec).string();
+    }
+    if (input.find('\n') != string::npos || output.find('\n') != string::npos ||
+        sent.textureManifest.find('\n') != string::npos) {
+        printError("File names containing new lines are not supported"sv);
+        return false;
+    }
+    string request = "input="s + input + "\noutput=" + output + '\n';
+    runOverOptions(sent, [&](const string_view& name, auto& value) {
+        request += string(name) + '=' + toString(value) + '\n';
+    });
+    signal(SIGPIPE, SIG_IGN);
+    // The line ending added when writing terminates the request with an empty line
+    if (!connection.writeLine(request)) {
+        printError("Failed sending job to server"sv);
+        return false;
+    }
+
+    // Print progress until the job completes
+    string line;
+    while (connection.readLine(line)) {
+        if (line.starts_with("progress "sv)) {
+            printInfo(line.substr(9));
+        } else if (line == "done"sv) {
+            printInfo("Job completed: "s + inputFile);
+            return true;
+        } else {
+            printError("Job failed: "s + inputFile);
+            return false;
+        }
+    }
+    printError("Lost connection to server"sv);
+    return false;
+}
+#else
+bool runServer(const string&, uint32_t, size_t) noexcept
+{
+    printError("Server mode is not supported on this platform"sv);
+    return false;
+}
+
+bool submitJob(const string&, const string&, const string&, const Optimiser::Options&) noexcept
+{
+    printError("Server mode is not supported on this platform"sv);
+    return false;
+}
+#endif
@@ -0,0 +1,43 @@
+/**
+ * Copyright Matthew Oliver
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#pragma once
+
+#include "Optimiser.h"
+
+#include <string>
+
+/**
+ * Run a server that optimises files submitted over a local (Unix domain) socket until interrupted. All jobs share a
+ * single thread pool along with caches of decoded and compressed textures so that repeated small jobs avoid the
+ * startup and texture processing costs of separate runs.
+ * @param socketPath Path of the socket to listen on, any existing socket at this path is replaced.
+ * @param jobs       Number of jobs that are optimised at the same time.
+ * @param cacheSize  Maximum size in bytes of each texture cache, 0 for no limit.
+ * @return True if the server ran and shut down cleanly, false if it failed.
+ */
+[[nodiscard]] bool runServer(const std::string& socketPath, uint32_t jobs, size_t cacheSize) noexcept;
+
+/**
+ * Submit a job to a running server and wait for it to complete. Progress reported by the server is printed as it is
+ * received.
+ * @param socketPath Path of the socket the server is listening on.
+ * @param inputFile  The input file.
+ * @param outputFile The output file.
+ * @param options    Optimiser options for the job.
+ * @return True if the job succeeded, false if it failed.
+ */
+[[nodiscard]] bool submitJob(const std::string& socketPath, const std::string& inputFile,
+    const std::string& outputFile, const Optimiser::Options& options) noexcept;
@@ -18,6 +18,29 @@
 
 #include "BS_thread_pool.hpp"
 
+#include <array>
+#include <atomic>
+#include <charconv>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <random>
+
+#ifdef _WIN32
+#    ifndef NOMINMAX
+#        define NOMINMAX
+#    endif
+#    ifndef WIN32_LEAN_AND_MEAN
+#        define WIN32_LEAN_AND_MEAN
+#    endif
+#    include <windows.h>
+#else
+#    include <fcntl.h>
+#    include <sys/mman.h>
+#    include <sys/stat.h>
+#    include <unistd.h>
+#endif
+
 static BS::synced_stream sout;
 
 void printError(const std::string_view& message) noexcept
@@ -49,3 +72,154 @@ void printInfo(const std::string& message) noexcept
 {
     sout.println("Info: ", message);
 }
+
+std::string getFolder(const std::string& file) noexcept
+{
+    const size_t folderPos = file.find_last_of("/\\");
+    return (folderPos != std::string::npos) ? std::string(file, 0, folderPos + 1) : "";
+}
+
+std::string getSidecarFileName(const std::string& file, const std::string_view& extension) noexcept
+{
+    // Sidecar files are named after the file they belong to and are placed in the same folder
+    const size_t folderPos = file.find_last_of("/\\");
+    std::string sidecarFile = (folderPos != std::string::npos) ? std::string(file, folderPos + 1) : file;
+    if (const size_t fileExt = sidecarFile.rfind('.'); fileExt != std::string::npos) {
+        sidecarFile.erase(fileExt);
+    }
+    sidecarFile += extension;
+    return sidecarFile;
+}
+
+std::string getDataHash(std::span<const uint8_t> data) noexcept
+{
+    // 64bit FNV-1a
+    uint64_t hash = 0xcbf29ce484222325ULL;
+    for (const uint8_t byte : data) {
+        hash = (hash ^ byte) * 0x100000001b3ULL;
+    }
+    std::array<char, 16> text;
+    const auto result = std::to_chars(text.data(), text.data() + text.size(), hash, 16);
+    return std::to_string(data.size()) + ":" + std::string(text.data(), result.ptr);
+}
+
+std::string getFileHash(const std::string& file) noexcept
+{
+    MappedFile mapped;
+    if (!mapped.open(file)) {
+        return {};
+    }
+    return getDataHash(std::span(static_cast<const uint8_t*>(mapped.data()), mapped.size()));
+}
+
+std::string getTempFileName(const std::string& file) noexcept
+{
+    // Several threads or processes (possibly on other hosts sharing the folder) may write the same output at once, so
+    // each writer uses its own temporary file and the last completed one is moved into place
+    static const uint64_t processToken = []() {
+        std::random_device random;
+#ifdef _WIN32
+        const uint64_t process = GetCurrentProcessId();
+#else
+        const uint64_t process = static_cast<uint64_t>(getpid());
+#endif
+        return (static_cast<uint64_t>(random()) << 32) ^ random() ^ process;
+    }();
+    static std::atomic<uint64_t> counter = 0;
+    std::array<char, 16> text;
+    const auto result = std::to_chars(text.data(), text.data() + text.size(), processToken, 16);
+    return file + "." + std::string(text.data(), result.ptr) + "." + std::to_string(counter++) + ".tmp";
+}
+
+bool replaceFile(const std::string& tempFile, const std::string& file) noexcept
+{
+    std::error_code ec;
+    std::filesystem::rename(tempFile, file, ec);
+    if (ec) {
+        printError("Failed to replace file '" + file + "': " + ec.message());
+        remove(tempFile.c_str());
+        return false;
+    }
+    return true;
+}
+
+bool writeFile(const std::string& file, const std::vector<std::span<const uint8_t>>& data) noexcept
+{
+    const std::string tempFile = getTempFileName(file);
+    std::ofstream output(tempFile, std::ios::binary);
+    for (auto& i : data) {
+        output.write(reinterpret_cast<const char*>(i.data()), static_cast<std::streamsize>(i.size()));
+    }
+    output.close();
+    if (output.fail()) {
+        remove(tempFile.c_str());
+        return false;
+    }
+    return replaceFile(tempFile, file);
+}
+
+MappedFile::~MappedFile() noexcept
+{
+    close();
+}
+
+bool MappedFile::open(const std::string& file) noexcept
+{
+    close();
+#ifdef _WIN32
+    HANDLE handle = CreateFileA(file.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+        FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (handle == INVALID_HANDLE_VALUE) {
+        return false;
+    }
+    LARGE_INTEGER fileSize;
+    if (!GetFileSizeEx(handle, &fileSize) || fileSize.QuadPart == 0) {
+        CloseHandle(handle);
+        return false;
+    }
+    HANDLE mapping = CreateFileMappingA(handle, nullptr, PAGE_WRITECOPY, 0, 0, nullptr);
+    CloseHandle(handle);
+    if (mapping == nullptr) {
+        return false;
+    }
+    // The view keeps the file open so the handles are no longer needed
+    mapped = MapViewOfFile(mapping, FILE_MAP_COPY, 0, 0, 0);
+    CloseHandle(mapping);
+    if (mapped == nullptr) {
+        return false;
+    }
+    length = static_cast<size_t>(fileSize.QuadPart);
+#else
+    const int handle = ::open(file.c_str(), O_RDONLY);
+    if (handle == -1) {
+        return false;
+    }
+    struct stat fileStat;
+    if (fstat(handle, &fileStat) != 0 || fileStat.st_size == 0) {
+        ::close(handle);
+        return false;
+    }
+    void* view = mmap(nullptr, static_cast<size_t>(fileStat.st_size), PROT_READ | PROT_WRITE, MAP_PRIVATE, handle, 0);
+    ::close(handle);
+    if (view == MAP_FAILED) {
+        return false;
+    }
+    mapped = view;
+    length = static_cast<size_t>(fileStat.st_size);
+#endif
+    return true;
+}
+
+void MappedFile::close() noexcept
+{
+    if (mapped == nullptr) {
+        return;
+    }
+#ifdef _WIN32
+    UnmapViewOfFile(mapped);
+#else
+    munmap(mapped, length);
+#endif
+    mapped = nullptr;
+    length = 0;
+}
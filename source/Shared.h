@@ -15,8 +15,12 @@
  */
 #pragma once
 
+#include <cstdint>
 #include <memory>
+#include <span>
+#include <string>
 #include <string_view>
+#include <vector>
 
 void printError(const std::string_view& message) noexcept;
 
@@ -29,3 +33,82 @@ void printWarning(const std::string& message) noexcept;
 void printInfo(const std::string_view& message) noexcept;
 
 void printInfo(const std::string& message) noexcept;
+
+std::string getFolder(const std::string& file) noexcept;
+
+std::string getSidecarFileName(const std::string& file, const std::string_view& extension) noexcept;
+
+/**
+ * Get a content hash of some data that is stable across processes and platforms.
+ * @param data The data to hash.
+ * @return The hash, which also includes the data size.
+ */
+std::string getDataHash(std::span<const uint8_t> data) noexcept;
+
+/**
+ * Get a content hash of a file that is stable across processes and platforms.
+ * @param file The file.
+ * @return The hash, empty if the file could not be read.
+ */
+std::string getFileHash(const std::string& file) noexcept;
+
+/**
+ * Get the name of a temporary file used while writing a file, each call returns a new name so that concurrent
+ * writers of the same file never share a temporary file.
+ * @param file The final file name.
+ * @return The temporary file name.
+ */
+std::string getTempFileName(const std::string& file) noexcept;
+
+/**
+ * Move a completed temporary file into place, replacing any existing file. Other processes either see the old file
+ * or the complete new one, never a partially written file.
+ * @param tempFile The completed temporary file, this is removed if the move fails.
+ * @param file     The final file name.
+ * @return True if it succeeds, false if it fails.
+ */
+bool replaceFile(const std::string& tempFile, const std::string& file) noexcept;
+
+/**
+ * Write a file by writing a temporary file and then moving it into place.
+ * @param file The file to write.
+ * @param data The file contents, each entry is written in order.
+ * @return True if it succeeds, false if it fails.
+ */
+bool writeFile(const std::string& file, const std::vector<std::span<const uint8_t>>& data) noexcept;
+
+class MappedFile
+{
+public:
+    MappedFile() noexcept = default;
+
+    ~MappedFile() noexcept;
+
+    MappedFile(const MappedFile&) = delete;
+
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    /**
+     * Map a file into memory. Pages are only read from disk when first accessed and any writes are private to this
+     * process (copy-on-write).
+     * @param file The file to map.
+     * @return True if it succeeds, false if it fails.
+     */
+    [[nodiscard]] bool open(const std::string& file) noexcept;
+
+    void close() noexcept;
+
+    [[nodiscard]] void* data() const noexcept
+    {
+        return mapped;
+    }
+
+    [[nodiscard]] size_t size() const noexcept
+    {
+        return length;
+    }
+
+private:
+    void* mapped = nullptr;
+    size_t length = 0;
+};
@@ -16,7 +16,11 @@
 
 #include "SharedCGLTF.h"
 
+#include <algorithm>
+#include <fstream>
+#include <functional>
 #include <iostream>
+#include <set>
 
 using namespace std;
 
@@ -57,7 +61,9 @@ bool requiresGLTFExtension(const shared_ptr<cgltf_data>& data, const string_view
 
 bool operator==(const cgltf_image& a, const cgltf_image& b) noexcept
 {
-    if (a.uri == b.uri && a.buffer_view == b.buffer_view) {
+    // Data uris are compared by content so that identical embedded images are only decoded once
+    const bool sameURI = (a.uri == b.uri) || (a.uri != nullptr && b.uri != nullptr && strcmp(a.uri, b.uri) == 0);
+    if (sameURI && a.buffer_view == b.buffer_view) {
         return true;
     }
     return false;
@@ -95,6 +101,81 @@ bool operator==(const cgltf_material& a, const cgltf_material& b) noexcept
     return false;
 }
 
+bool operator==(const cgltf_accessor& a, const cgltf_accessor& b) noexcept
+{
+    if (a.component_type != b.component_type || a.type != b.type || a.normalized != b.normalized ||
+        a.count != b.count || a.has_min != b.has_min || a.has_max != b.has_max) {
+        return false;
+    }
+    if (memcmp(a.min, b.min, sizeof(a.min)) != 0 || memcmp(a.max, b.max, sizeof(a.max)) != 0) {
+        return false;
+    }
+    const uint8_t* aData = getAccessorData(&a);
+    const uint8_t* bData = getAccessorData(&b);
+    if (aData == nullptr || bData == nullptr) {
+        return false;
+    }
+    const cgltf_size elementSize = getElementSize(&a);
+    for (cgltf_size i = 0; i < a.count; ++i) {
+        if (memcmp(aData + i * a.stride, bData + i * b.stride, elementSize) != 0) {
+            return false;
+        }
+    }
+    return true;
+}
+
+static bool operator==(const cgltf_morph_target& a, const cgltf_morph_target& b) noexcept
+{
+    if (a.attributes_count != b.attributes_count) {
+        return false;
+    }
+    for (cgltf_size i = 0; i < a.attributes_count; ++i) {
+        const cgltf_attribute* match = findAttribute(b.attributes, b.attributes_count, a.attributes[i]);
+        if (match == nullptr || match->data != a.attributes[i].data) {
+            return false;
+        }
+    }
+    return true;
+}
+
+static bool operator==(const cgltf_primitive& a, const cgltf_primitive& b) noexcept
+{
+    if (a.type != b.type || a.material != b.material || a.indices != b.indices ||
+        a.has_draco_mesh_compression || b.has_draco_mesh_compression || a.mappings_count != 0 ||
+        b.mappings_count != 0 || a.extensions_count != 0 || b.extensions_count != 0 ||
+        a.targets_count != b.targets_count) {
+        return false;
+    }
+    cgltf_morph_target aAttributes = {a.attributes, a.attributes_count};
+    cgltf_morph_target bAttributes = {b.attributes, b.attributes_count};
+    if (!(aAttributes == bAttributes)) {
+        return false;
+    }
+    for (cgltf_size i = 0; i < a.targets_count; ++i) {
+        if (!(a.targets[i] == b.targets[i])) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool operator==(const cgltf_mesh& a, const cgltf_mesh& b) noexcept
+{
+    if (a.primitives_count != b.primitives_count || a.weights_count != b.weights_count ||
+        a.extensions_count != 0 || b.extensions_count != 0) {
+        return false;
+    }
+    if (a.weights_count != 0 && memcmp(a.weights, b.weights, a.weights_count * sizeof(cgltf_float)) != 0) {
+        return false;
+    }
+    for (cgltf_size i = 0; i < a.primitives_count; ++i) {
+        if (!(a.primitives[i] == b.primitives[i])) {
+            return false;
+        }
+    }
+    return true;
+}
+
 const char* getName(const cgltf_material& material) noexcept
 {
     return (material.name != nullptr) ? material.name : "unnamed";
@@ -116,11 +197,20 @@ const char* getName(const cgltf_mesh& mesh) noexcept
     return (mesh.name != nullptr) ? mesh.name : "unnamed";
 }
 
+const char* getName(const cgltf_node& node) noexcept
+{
+    return (node.name != nullptr) ? node.name : "unnamed";
+}
+
+const char* getName(const cgltf_animation& animation) noexcept
+{
+    return (animation.name != nullptr) ? animation.name : "unnamed";
+}
+
 bool isValid(const cgltf_image* image) noexcept
 {
-    // TODO: support packed textures
     if (image != nullptr) {
-        return image->uri != nullptr;
+        return image->uri != nullptr || image->buffer_view != nullptr;
     }
     return false;
 }
@@ -150,39 +240,490 @@ bool isValid(const cgltf_mesh* mesh) noexcept
     return false;
 }
 
-void cgltf_remove_mesh(cgltf_data* data, cgltf_mesh* mesh) noexcept
+vector<cgltf_node*> getStaticNodes(cgltf_data& data, const cgltf_scene& scene) noexcept
 {
-    data->memory.free_func(data->memory.user_data, mesh->name);
+    // Find all nodes that are animated or used for skinning, these and their children must remain dynamic
+    set<cgltf_node*> dynamicNodes;
+    for (cgltf_size i = 0; i < data.animations_count; ++i) {
+        cgltf_animation& animation = data.animations[i];
+        for (cgltf_size j = 0; j < animation.channels_count; ++j) {
+            dynamicNodes.insert(animation.channels[j].target_node);
+        }
+    }
+    for (cgltf_size i = 0; i < data.skins_count; ++i) {
+        cgltf_skin& skin = data.skins[i];
+        for (cgltf_size j = 0; j < skin.joints_count; ++j) {
+            dynamicNodes.insert(skin.joints[j]);
+        }
+    }
+    for (cgltf_size i = 0; i < data.nodes_count; ++i) {
+        cgltf_node* node = &data.nodes[i];
+        if (node->skin != nullptr || node->has_mesh_gpu_instancing) {
+            dynamicNodes.insert(node);
+        }
+    }
 
-    for (cgltf_size j = 0; j < mesh->primitives_count; ++j) {
-        for (cgltf_size k = 0; k < mesh->primitives[j].attributes_count; ++k) {
-            data->memory.free_func(data->memory.user_data, mesh->primitives[j].attributes[k].name);
+    // Walk the scene hierarchy to find all static nodes
+    vector<cgltf_node*> staticNodes;
+    function<void(cgltf_node*, bool)> walkNodes = [&](cgltf_node* node, bool dynamic) {
+        dynamic = dynamic || dynamicNodes.contains(node);
+        if (!dynamic) {
+            staticNodes.push_back(node);
+        }
+        for (cgltf_size i = 0; i < node->children_count; ++i) {
+            walkNodes(node->children[i], dynamic);
+        }
+    };
+    for (cgltf_size i = 0; i < scene.nodes_count; ++i) {
+        walkNodes(scene.nodes[i], false);
+    }
+    return staticNodes;
+}
+
+bool getWorldBounds(const cgltf_node& node, array<cgltf_float, 3>& boundsMin, array<cgltf_float, 3>& boundsMax) noexcept
+{
+    // Combine the position bounds of every primitive in the node's mesh
+    array<cgltf_float, 3> localMin, localMax;
+    bool found = false;
+    for (cgltf_size j = 0; node.mesh != nullptr && j < node.mesh->primitives_count; ++j) {
+        const cgltf_attribute* position = findAttribute(node.mesh->primitives[j], cgltf_attribute_type_position);
+        if (position == nullptr || !position->data->has_min || !position->data->has_max) {
+            continue;
+        }
+        for (cgltf_size c = 0; c < 3; ++c) {
+            localMin[c] = found ? std::min(localMin[c], position->data->min[c]) : position->data->min[c];
+            localMax[c] = found ? std::max(localMax[c], position->data->max[c]) : position->data->max[c];
+        }
+        found = true;
+    }
+    if (!found) {
+        return false;
+    }
+
+    // GPU instanced nodes place a copy of the mesh at each instance transform
+    constexpr const char* instanceNames[3] = {"TRANSLATION", "ROTATION", "SCALE"};
+    const cgltf_accessor* instanceTransform[3] = {nullptr, nullptr, nullptr};
+    cgltf_size instanceCount = 1;
+    for (cgltf_size k = 0; node.has_mesh_gpu_instancing && k < node.mesh_gpu_instancing.attributes_count; ++k) {
+        const cgltf_attribute& attribute = node.mesh_gpu_instancing.attributes[k];
+        for (cgltf_size t = 0; t < 3; ++t) {
+            if (strcmp(attribute.name, instanceNames[t]) == 0) {
+                instanceTransform[t] = attribute.data;
+                instanceCount = attribute.data->count;
+            }
+        }
+    }
+
+    // Transform each corner of the local bounds into world space
+    array<cgltf_float, 16> world;
+    cgltf_node_transform_world(&node, world.data());
+    boundsMin.fill(numeric_limits<cgltf_float>::max());
+    boundsMax.fill(numeric_limits<cgltf_float>::lowest());
+    for (cgltf_size i = 0; i < instanceCount; ++i) {
+        array<cgltf_float, 16> transform = world;
+        if (node.has_mesh_gpu_instancing) {
+            cgltf_node instance = {0};
+            instance.has_translation = instanceTransform[0] != nullptr &&
+                cgltf_accessor_read_float(instanceTransform[0], i, instance.translation, 3);
+            instance.rotation[3] = 1.0f;
+            instance.has_rotation = instanceTransform[1] != nullptr &&
+                cgltf_accessor_read_float(instanceTransform[1], i, instance.rotation, 4);
+            std::fill_n(instance.scale, 3, 1.0f);
+            instance.has_scale = instanceTransform[2] != nullptr &&
+                cgltf_accessor_read_float(instanceTransform[2], i, instance.scale, 3);
+            array<cgltf_float, 16> local;
+            cgltf_node_transform_local(&instance, local.data());
+            for (cgltf_size column = 0; column < 4; ++column) {
+                for (cgltf_size row = 0; row < 4; ++row) {
+                    transform[column * 4 + row] = world[row] * local[column * 4] +
+                        world[4 + row] * local[column * 4 + 1] + world[8 + row] * local[column * 4 + 2] +
+                        world[12 + row] * local[column * 4 + 3];
+                }
+            }
         }
+        for (uint32_t corner = 0; corner < 8; ++corner) {
+            const array<cgltf_float, 3> local = {(corner & 1) ? localMax[0] : localMin[0],
+                (corner & 2) ? localMax[1] : localMin[1], (corner & 4) ? localMax[2] : localMin[2]};
+            for (cgltf_size c = 0; c < 3; ++c) {
+                const cgltf_float value = transform[c] * local[0] + transform[4 + c] * local[1] +
+                    transform[8 + c] * local[2] + transform[12 + c];
+                boundsMin[c] = std::min(boundsMin[c], value);
+                boundsMax[c] = std::max(boundsMax[c], value);
+            }
+        }
+    }
+    return instanceCount > 0;
+}
+
+cgltf_size getComponentSize(cgltf_component_type type) noexcept
+{
+    switch (type) {
+        case cgltf_component_type_r_8:
+        case cgltf_component_type_r_8u:
+            return 1;
+        case cgltf_component_type_r_16:
+        case cgltf_component_type_r_16u:
+            return 2;
+        case cgltf_component_type_r_32u:
+        case cgltf_component_type_r_32f:
+            return 4;
+        default:
+            return 0;
+    }
+}
+
+cgltf_size getElementSize(const cgltf_accessor* accessor) noexcept
+{
+    return cgltf_num_components(accessor->type) * getComponentSize(accessor->component_type);
+}
 
-        data->memory.free_func(data->memory.user_data, mesh->primitives[j].attributes);
+const uint8_t* getAccessorData(const cgltf_accessor* accessor) noexcept
+{
+    // Sparse and unbacked accessors have no contiguous data that can be directly read
+    if (accessor == nullptr || accessor->is_sparse || accessor->buffer_view == nullptr) {
+        return nullptr;
+    }
+    const cgltf_buffer_view* view = accessor->buffer_view;
+    if (view->data != nullptr) {
+        // Use decompressed data if available
+        return static_cast<const uint8_t*>(view->data) + accessor->offset;
+    }
+    if (view->buffer == nullptr || view->buffer->data == nullptr) {
+        return nullptr;
+    }
+    return static_cast<const uint8_t*>(view->buffer->data) + view->offset + accessor->offset;
+}
 
-        for (cgltf_size k = 0; k < mesh->primitives[j].targets_count; ++k) {
-            for (cgltf_size m = 0; m < mesh->primitives[j].targets[k].attributes_count; ++m) {
-                data->memory.free_func(data->memory.user_data, mesh->primitives[j].targets[k].attributes[m].name);
+bool canMerge(const cgltf_primitive& prim) noexcept
+{
+    // Only list topologies can be concatenated without changing the rendered result
+    if (prim.type != cgltf_primitive_type_triangles && prim.type != cgltf_primitive_type_lines &&
+        prim.type != cgltf_primitive_type_points) {
+        return false;
+    }
+    if (prim.attributes_count == 0 || prim.has_draco_mesh_compression || prim.mappings_count != 0 ||
+        prim.extensions_count != 0 || prim.extras.start_offset != prim.extras.end_offset) {
+        return false;
+    }
+    if (prim.attributes[0].data == nullptr || prim.attributes[0].data->count == 0) {
+        return false;
+    }
+    if (prim.indices != nullptr && getAccessorData(prim.indices) == nullptr) {
+        return false;
+    }
+    auto checkAttributes = [](const cgltf_attribute* attributes, cgltf_size count) {
+        for (cgltf_size i = 0; i < count; ++i) {
+            const cgltf_accessor* accessor = attributes[i].data;
+            if (accessor == nullptr || getAccessorData(accessor) == nullptr || getElementSize(accessor) == 0 ||
+                accessor->type >= cgltf_type_mat2) {
+                return false;
             }
+        }
+        return true;
+    };
+    if (!checkAttributes(prim.attributes, prim.attributes_count)) {
+        return false;
+    }
+    for (cgltf_size i = 0; i < prim.targets_count; ++i) {
+        if (!checkAttributes(prim.targets[i].attributes, prim.targets[i].attributes_count)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+const cgltf_attribute* findAttribute(
+    const cgltf_attribute* attributes, cgltf_size count, const cgltf_attribute& match) noexcept
+{
+    for (cgltf_size i = 0; i < count; ++i) {
+        if (strcmp(attributes[i].name, match.name) == 0) {
+            return &attributes[i];
+        }
+    }
+    return nullptr;
+}
+
+cgltf_attribute* findAttribute(const cgltf_primitive& prim, cgltf_attribute_type type, cgltf_int index) noexcept
+{
+    for (cgltf_size i = 0; i < prim.attributes_count; ++i) {
+        if (prim.attributes[i].type == type && prim.attributes[i].index == index) {
+            return &prim.attributes[i];
+        }
+    }
+    return nullptr;
+}
+
+static bool isCompatibleAttributes(
+    const cgltf_attribute* a, cgltf_size aCount, const cgltf_attribute* b, cgltf_size bCount) noexcept
+{
+    if (aCount != bCount) {
+        return false;
+    }
+    for (cgltf_size i = 0; i < aCount; ++i) {
+        const cgltf_attribute* match = findAttribute(b, bCount, a[i]);
+        if (match == nullptr || match->data->type != a[i].data->type ||
+            match->data->component_type != a[i].data->component_type ||
+            match->data->normalized != a[i].data->normalized) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool isCompatible(const cgltf_primitive& a, const cgltf_primitive& b) noexcept
+{
+    if (a.material != b.material || a.type != b.type || a.targets_count != b.targets_count) {
+        return false;
+    }
+    if (!isCompatibleAttributes(a.attributes, a.attributes_count, b.attributes, b.attributes_count)) {
+        return false;
+    }
+    for (cgltf_size i = 0; i < a.targets_count; ++i) {
+        if (!isCompatibleAttributes(a.targets[i].attributes, a.targets[i].attributes_count, b.targets[i].attributes,
+                b.targets[i].attributes_count)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+cgltf_component_type getIndexType(cgltf_size maxIndex) noexcept
+{
+    // Largest value of each type is reserved for primitive restart
+    if (maxIndex < 0xFF) {
+        return cgltf_component_type_r_8u;
+    }
+    if (maxIndex < 0xFFFF) {
+        return cgltf_component_type_r_16u;
+    }
+    return cgltf_component_type_r_32u;
+}
+
+void writeIndex(uint8_t* data, cgltf_component_type type, cgltf_size index, cgltf_size value) noexcept
+{
+    if (type == cgltf_component_type_r_8u) {
+        data[index] = static_cast<uint8_t>(value);
+    } else if (type == cgltf_component_type_r_16u) {
+        reinterpret_cast<uint16_t*>(data)[index] = static_cast<uint16_t>(value);
+    } else {
+        reinterpret_cast<uint32_t*>(data)[index] = static_cast<uint32_t>(value);
+    }
+}
 
-            data->memory.free_func(data->memory.user_data, mesh->primitives[j].targets[k].attributes);
+cgltf_result cgltf_parse_file_json(
+    const cgltf_options* options, const char* path, cgltf_data** outData, cgltf_size* binOffset) noexcept
+{
+    *binOffset = 0;
+    ifstream file(path, ios::binary | ios::ate);
+    if (!file.is_open()) {
+        return cgltf_result_file_not_found;
+    }
+    const cgltf_size fileSize = static_cast<cgltf_size>(file.tellg());
+    file.seekg(0);
+
+    // Only the header and JSON chunk of a glb file are read, the binary chunk is loaded separately with the buffers
+    cgltf_size readSize = fileSize;
+    uint32_t header[5];
+    if (fileSize >= sizeof(header) && file.read(reinterpret_cast<char*>(header), sizeof(header)).good() &&
+        header[0] == 0x46546C67 && header[4] == 0x4E4F534A) {
+        readSize = std::min(fileSize, sizeof(header) + header[3]);
+        uint32_t chunkHeader[2];
+        const cgltf_size chunkOffset = (readSize + 3) & ~cgltf_size(3);
+        if (chunkOffset + sizeof(chunkHeader) <= fileSize && file.seekg(static_cast<streamoff>(chunkOffset)) &&
+            file.read(reinterpret_cast<char*>(chunkHeader), sizeof(chunkHeader)).good() &&
+            chunkHeader[1] == 0x004E4942) {
+            *binOffset = chunkOffset + sizeof(chunkHeader);
         }
+    }
+    file.seekg(0);
+    auto fileData = static_cast<uint8_t*>(malloc(readSize));
+    if (fileData == nullptr) {
+        return cgltf_result_out_of_memory;
+    }
+    if (!file.read(reinterpret_cast<char*>(fileData), static_cast<streamsize>(readSize)).good()) {
+        free(fileData);
+        return cgltf_result_io_error;
+    }
+    if (readSize < fileSize) {
+        // Update the total length so that cgltf accepts the truncated file
+        const uint32_t length = static_cast<uint32_t>(readSize);
+        memcpy(fileData + 8, &length, sizeof(length));
+    }
+    const cgltf_result result = cgltf_parse(options, fileData, readSize, outData);
+    if (result != cgltf_result_success) {
+        free(fileData);
+        return result;
+    }
+    // The parsed data references the JSON so it is released along with the data
+    (*outData)->file_data = fileData;
+    return cgltf_result_success;
+}
+
+cgltf_buffer* cgltf_add_buffer(cgltf_data* data, cgltf_size size) noexcept
+{
+    auto newMemory =
+        static_cast<cgltf_buffer*>(realloc(data->buffers, (data->buffers_count + 1) * sizeof(cgltf_buffer)));
+    if (newMemory == nullptr) {
+        return nullptr;
+    }
+    // Check if pointers have moved
+    if (newMemory != data->buffers) {
+        runOverBuffers(*data, [&](cgltf_buffer*& p) {
+            if (p != nullptr) {
+                p = (p - data->buffers) + newMemory;
+            }
+        });
+    }
+    data->buffers = newMemory;
+    cgltf_buffer* buffer = &data->buffers[data->buffers_count];
+    *buffer = {0};
+    buffer->data = malloc(size);
+    if (buffer->data == nullptr) {
+        return nullptr;
+    }
+    buffer->size = size;
+    buffer->data_free_method = cgltf_data_free_method_memory_free;
+    ++data->buffers_count;
+    return buffer;
+}
+
+cgltf_buffer_view* cgltf_add_buffer_views(cgltf_data* data, cgltf_size count) noexcept
+{
+    auto newMemory = static_cast<cgltf_buffer_view*>(
+        realloc(data->buffer_views, (data->buffer_views_count + count) * sizeof(cgltf_buffer_view)));
+    if (newMemory == nullptr) {
+        return nullptr;
+    }
+    // Check if pointers have moved
+    if (newMemory != data->buffer_views) {
+        runOverBufferViews(*data, [&](cgltf_buffer_view*& p) {
+            if (p != nullptr) {
+                p = (p - data->buffer_views) + newMemory;
+            }
+        });
+    }
+    data->buffer_views = newMemory;
+    cgltf_buffer_view* views = &data->buffer_views[data->buffer_views_count];
+    for (cgltf_size i = 0; i < count; ++i) {
+        views[i] = {0};
+    }
+    data->buffer_views_count += count;
+    return views;
+}
+
+cgltf_accessor* cgltf_add_accessors(cgltf_data* data, cgltf_size count) noexcept
+{
+    auto newMemory = static_cast<cgltf_accessor*>(
+        realloc(data->accessors, (data->accessors_count + count) * sizeof(cgltf_accessor)));
+    if (newMemory == nullptr) {
+        return nullptr;
+    }
+    // Check if pointers have moved
+    if (newMemory != data->accessors) {
+        runOverAccessors(*data, [&](cgltf_accessor*& p) {
+            if (p != nullptr) {
+                p = (p - data->accessors) + newMemory;
+            }
+        });
+    }
+    data->accessors = newMemory;
+    cgltf_accessor* accessors = &data->accessors[data->accessors_count];
+    for (cgltf_size i = 0; i < count; ++i) {
+        accessors[i] = {0};
+    }
+    data->accessors_count += count;
+    return accessors;
+}
 
-        data->memory.free_func(data->memory.user_data, mesh->primitives[j].targets);
+cgltf_mesh* cgltf_add_meshes(cgltf_data* data, cgltf_size count) noexcept
+{
+    auto newMemory =
+        static_cast<cgltf_mesh*>(realloc(data->meshes, (data->meshes_count + count) * sizeof(cgltf_mesh)));
+    if (newMemory == nullptr) {
+        return nullptr;
+    }
+    // Check if pointers have moved
+    if (newMemory != data->meshes) {
+        runOverMeshes(*data, [&](cgltf_mesh*& p) {
+            if (p != nullptr) {
+                p = (p - data->meshes) + newMemory;
+            }
+        });
+    }
+    data->meshes = newMemory;
+    cgltf_mesh* meshes = &data->meshes[data->meshes_count];
+    for (cgltf_size i = 0; i < count; ++i) {
+        meshes[i] = {0};
+    }
+    data->meshes_count += count;
+    return meshes;
+}
 
-        if (mesh->primitives[j].has_draco_mesh_compression) {
-            for (cgltf_size k = 0; k < mesh->primitives[j].draco_mesh_compression.attributes_count; ++k) {
-                data->memory.free_func(
-                    data->memory.user_data, mesh->primitives[j].draco_mesh_compression.attributes[k].name);
+cgltf_node* cgltf_add_nodes(cgltf_data* data, cgltf_size count) noexcept
+{
+    auto newMemory =
+        static_cast<cgltf_node*>(realloc(data->nodes, (data->nodes_count + count) * sizeof(cgltf_node)));
+    if (newMemory == nullptr) {
+        return nullptr;
+    }
+    // Check if pointers have moved
+    if (newMemory != data->nodes) {
+        runOverNodes(*data, [&](cgltf_node*& p) {
+            if (p != nullptr) {
+                p = (p - data->nodes) + newMemory;
             }
+        });
+    }
+    data->nodes = newMemory;
+    cgltf_node* nodes = &data->nodes[data->nodes_count];
+    for (cgltf_size i = 0; i < count; ++i) {
+        nodes[i] = {0};
+        nodes[i].rotation[3] = 1.0f;
+        nodes[i].scale[0] = 1.0f;
+        nodes[i].scale[1] = 1.0f;
+        nodes[i].scale[2] = 1.0f;
+    }
+    data->nodes_count += count;
+    return nodes;
+}
+
+void cgltf_remove_primitive(cgltf_data* data, cgltf_primitive* primitive) noexcept
+{
+    for (cgltf_size k = 0; k < primitive->attributes_count; ++k) {
+        data->memory.free_func(data->memory.user_data, primitive->attributes[k].name);
+    }
+
+    data->memory.free_func(data->memory.user_data, primitive->attributes);
+
+    for (cgltf_size k = 0; k < primitive->targets_count; ++k) {
+        for (cgltf_size m = 0; m < primitive->targets[k].attributes_count; ++m) {
+            data->memory.free_func(data->memory.user_data, primitive->targets[k].attributes[m].name);
+        }
+
+        data->memory.free_func(data->memory.user_data, primitive->targets[k].attributes);
+    }
+
+    data->memory.free_func(data->memory.user_data, primitive->targets);
 
-            data->memory.free_func(data->memory.user_data, mesh->primitives[j].draco_mesh_compression.attributes);
+    if (primitive->has_draco_mesh_compression) {
+        for (cgltf_size k = 0; k < primitive->draco_mesh_compression.attributes_count; ++k) {
+            data->memory.free_func(data->memory.user_data, primitive->draco_mesh_compression.attributes[k].name);
         }
 
-        data->memory.free_func(data->memory.user_data, mesh->primitives[j].mappings);
+        data->memory.free_func(data->memory.user_data, primitive->draco_mesh_compression.attributes);
+    }
+
+    data->memory.free_func(data->memory.user_data, primitive->mappings);
+
+    cgltf_free_extensions(data, primitive->extensions, primitive->extensions_count);
+}
+
+void cgltf_remove_mesh(cgltf_data* data, cgltf_mesh* mesh) noexcept
+{
+    data->memory.free_func(data->memory.user_data, mesh->name);
 
-        cgltf_free_extensions(data, mesh->primitives[j].extensions, mesh->primitives[j].extensions_count);
+    for (cgltf_size j = 0; j < mesh->primitives_count; ++j) {
+        cgltf_remove_primitive(data, &mesh->primitives[j]);
     }
 
     data->memory.free_func(data->memory.user_data, mesh->primitives);
@@ -269,3 +810,125 @@ void cgltf_remove_texture(cgltf_data* data, cgltf_texture* texture) noexcept
     data->memory.free_func(data->memory.user_data, texture->name);
     cgltf_free_extensions(data, texture->extensions, texture->extensions_count);
 }
+
+void cgltf_remove_accessor(cgltf_data* data, cgltf_accessor* accessor) noexcept
+{
+    data->memory.free_func(data->memory.user_data, accessor->name);
+
+    if (accessor->is_sparse) {
+        cgltf_free_extensions(data, accessor->sparse.extensions, accessor->sparse.extensions_count);
+        cgltf_free_extensions(data, accessor->sparse.indices_extensions, accessor->sparse.indices_extensions_count);
+        cgltf_free_extensions(data, accessor->sparse.values_extensions, accessor->sparse.values_extensions_count);
+    }
+
+    cgltf_free_extensions(data, accessor->extensions, accessor->extensions_count);
+}
+
+void cgltf_remove_buffer_view(cgltf_data* data, cgltf_buffer_view* view) noexcept
+{
+    data->memory.free_func(data->memory.user_data, view->name);
+    data->memory.free_func(data->memory.user_data, view->data);
+
+    cgltf_free_extensions(data, view->extensions, view->extensions_count);
+}
+
+void cgltf_remove_buffer(cgltf_data* data, cgltf_buffer* buffer) noexcept
+{
+    data->memory.free_func(data->memory.user_data, buffer->name);
+
+    if (buffer->data_free_method == cgltf_data_free_method_file_release) {
+        if (data->file.release != nullptr) {
+            data->file.release(&data->memory, &data->file, buffer->data);
+        } else {
+            data->memory.free_func(data->memory.user_data, buffer->data);
+        }
+    } else if (buffer->data_free_method == cgltf_data_free_method_memory_free) {
+        data->memory.free_func(data->memory.user_data, buffer->data);
+    }
+
+    data->memory.free_func(data->memory.user_data, buffer->uri);
+
+    cgltf_free_extensions(data, buffer->extensions, buffer->extensions_count);
+}
+
+void cgltf_remove_node(cgltf_data* data, cgltf_node* node) noexcept
+{
+    data->memory.free_func(data->memory.user_data, node->name);
+    data->memory.free_func(data->memory.user_data, node->children);
+    data->memory.free_func(data->memory.user_data, node->weights);
+
+    if (node->has_mesh_gpu_instancing) {
+        for (cgltf_size j = 0; j < node->mesh_gpu_instancing.attributes_count; ++j) {
+            data->memory.free_func(data->memory.user_data, node->mesh_gpu_instancing.attributes[j].name);
+        }
+
+        data->memory.free_func(data->memory.user_data, node->mesh_gpu_instancing.attributes);
+    }
+
+    cgltf_free_extensions(data, node->extensions, node->extensions_count);
+}
+
+void cgltf_remove_animation(cgltf_data* data, cgltf_animation* animation) noexcept
+{
+    data->memory.free_func(data->memory.user_data, animation->name);
+
+    for (cgltf_size j = 0; j < animation->samplers_count; ++j) {
+        cgltf_free_extensions(data, animation->samplers[j].extensions, animation->samplers[j].extensions_count);
+    }
+    data->memory.free_func(data->memory.user_data, animation->samplers);
+
+    for (cgltf_size j = 0; j < animation->channels_count; ++j) {
+        cgltf_free_extensions(data, animation->channels[j].extensions, animation->channels[j].extensions_count);
+    }
+    data->memory.free_func(data->memory.user_data, animation->channels);
+
+    cgltf_free_extensions(data, animation->extensions, animation->extensions_count);
+}
+
+bool cgltf_add_extension(cgltf_extension*& extensions, cgltf_size& extensionsCount, const std::string_view& name,
+    const std::string_view& json) noexcept
+{
+    auto newMemory =
+        static_cast<cgltf_extension*>(realloc(extensions, (extensionsCount + 1) * sizeof(cgltf_extension)));
+    if (newMemory == nullptr) {
+        return false;
+    }
+    extensions = newMemory;
+    cgltf_extension& extension = extensions[extensionsCount];
+    extension.name = static_cast<char*>(malloc(name.length() + 1));
+    extension.data = static_cast<char*>(malloc(json.length() + 1));
+    if (extension.name == nullptr || extension.data == nullptr) {
+        free(extension.name);
+        free(extension.data);
+        return false;
+    }
+    memcpy(extension.name, name.data(), name.length());
+    extension.name[name.length()] = '\0';
+    memcpy(extension.data, json.data(), json.length());
+    extension.data[json.length()] = '\0';
+    ++extensionsCount;
+    return true;
+}
+
+bool cgltf_add_extension_used(cgltf_data* data, const std::string_view& name) noexcept
+{
+    for (cgltf_size i = 0; i < data->extensions_used_count; ++i) {
+        if (name == data->extensions_used[i]) {
+            return true;
+        }
+    }
+    auto newMemory =
+        static_cast<char**>(realloc(data->extensions_used, (data->extensions_used_count + 1) * sizeof(char*)));
+    if (newMemory == nullptr) {
+        return false;
+    }
+    data->extensions_used = newMemory;
+    char* extensionName = static_cast<char*>(malloc(name.length() + 1));
+    if (extensionName == nullptr) {
+        return false;
+    }
+    memcpy(extensionName, name.data(), name.length());
+    extensionName[name.length()] = '\0';
+    data->extensions_used[data->extensions_used_count++] = extensionName;
+    return true;
+}
@@ -15,9 +15,11 @@
  */
 #pragma once
 
+#include <array>
 #include <cgltf.h>
 #include <memory>
 #include <string>
+#include <vector>
 
 std::string getCGLTFError(const cgltf_result result, const std::shared_ptr<cgltf_data>& data) noexcept;
 
@@ -29,6 +31,10 @@ bool operator==(const cgltf_texture& a, const cgltf_texture& b) noexcept;
 
 bool operator==(const cgltf_material& a, const cgltf_material& b) noexcept;
 
+bool operator==(const cgltf_accessor& a, const cgltf_accessor& b) noexcept;
+
+bool operator==(const cgltf_mesh& a, const cgltf_mesh& b) noexcept;
+
 const char* getName(const cgltf_material& material) noexcept;
 
 const char* getName(const cgltf_image& image) noexcept;
@@ -37,6 +43,10 @@ const char* getName(const cgltf_texture& texture) noexcept;
 
 const char* getName(const cgltf_mesh& mesh) noexcept;
 
+const char* getName(const cgltf_node& node) noexcept;
+
+const char* getName(const cgltf_animation& animation) noexcept;
+
 bool isValid(const cgltf_image* image) noexcept;
 
 bool isValid(const cgltf_texture* texture) noexcept;
@@ -84,8 +94,206 @@ void runOverMaterialTextures(cgltf_material& material, Func function) noexcept
     }
 }
 
+template<typename Func>
+void runOverMaterialTextureViews(cgltf_material& material, Func function) noexcept
+{
+    if (material.has_pbr_metallic_roughness) {
+        function(material.pbr_metallic_roughness.base_color_texture);
+        function(material.pbr_metallic_roughness.metallic_roughness_texture);
+    }
+    function(material.emissive_texture);
+    function(material.normal_texture);
+    function(material.occlusion_texture);
+    if (material.has_specular) {
+        function(material.specular.specular_color_texture);
+        function(material.specular.specular_texture);
+    }
+    if (material.has_clearcoat) {
+        function(material.clearcoat.clearcoat_texture);
+        function(material.clearcoat.clearcoat_normal_texture);
+        function(material.clearcoat.clearcoat_roughness_texture);
+    }
+    if (material.has_sheen) {
+        function(material.sheen.sheen_color_texture);
+        function(material.sheen.sheen_roughness_texture);
+    }
+    if (material.has_transmission) {
+        function(material.transmission.transmission_texture);
+    }
+    if (material.has_pbr_specular_glossiness) {
+        function(material.pbr_specular_glossiness.diffuse_texture);
+        function(material.pbr_specular_glossiness.specular_glossiness_texture);
+    }
+    if (material.has_volume) {
+        function(material.volume.thickness_texture);
+    }
+    if (material.has_iridescence) {
+        function(material.iridescence.iridescence_texture);
+        function(material.iridescence.iridescence_thickness_texture);
+    }
+}
+
+template<typename Func>
+void runOverAccessors(cgltf_data& data, Func function) noexcept
+{
+    for (cgltf_size i = 0; i < data.meshes_count; ++i) {
+        cgltf_mesh& mesh = data.meshes[i];
+        for (cgltf_size j = 0; j < mesh.primitives_count; ++j) {
+            cgltf_primitive& prim = mesh.primitives[j];
+            function(prim.indices);
+            for (cgltf_size k = 0; k < prim.attributes_count; ++k) {
+                function(prim.attributes[k].data);
+            }
+            for (cgltf_size k = 0; k < prim.targets_count; ++k) {
+                cgltf_morph_target& target = prim.targets[k];
+                for (cgltf_size m = 0; m < target.attributes_count; ++m) {
+                    function(target.attributes[m].data);
+                }
+            }
+        }
+    }
+    for (cgltf_size i = 0; i < data.skins_count; ++i) {
+        function(data.skins[i].inverse_bind_matrices);
+    }
+    for (cgltf_size i = 0; i < data.animations_count; ++i) {
+        cgltf_animation& animation = data.animations[i];
+        for (cgltf_size j = 0; j < animation.samplers_count; ++j) {
+            function(animation.samplers[j].input);
+            function(animation.samplers[j].output);
+        }
+    }
+    for (cgltf_size i = 0; i < data.nodes_count; ++i) {
+        cgltf_node& node = data.nodes[i];
+        if (node.has_mesh_gpu_instancing) {
+            for (cgltf_size j = 0; j < node.mesh_gpu_instancing.attributes_count; ++j) {
+                function(node.mesh_gpu_instancing.attributes[j].data);
+            }
+        }
+    }
+}
+
+template<typename Func>
+void runOverBufferViews(cgltf_data& data, Func function) noexcept
+{
+    for (cgltf_size i = 0; i < data.accessors_count; ++i) {
+        cgltf_accessor& accessor = data.accessors[i];
+        function(accessor.buffer_view);
+        if (accessor.is_sparse) {
+            function(accessor.sparse.indices_buffer_view);
+            function(accessor.sparse.values_buffer_view);
+        }
+    }
+    for (cgltf_size i = 0; i < data.images_count; ++i) {
+        function(data.images[i].buffer_view);
+    }
+    for (cgltf_size i = 0; i < data.meshes_count; ++i) {
+        cgltf_mesh& mesh = data.meshes[i];
+        for (cgltf_size j = 0; j < mesh.primitives_count; ++j) {
+            cgltf_primitive& prim = mesh.primitives[j];
+            if (prim.has_draco_mesh_compression) {
+                function(prim.draco_mesh_compression.buffer_view);
+            }
+        }
+    }
+}
+
+template<typename Func>
+void runOverBuffers(cgltf_data& data, Func function) noexcept
+{
+    for (cgltf_size i = 0; i < data.buffer_views_count; ++i) {
+        cgltf_buffer_view& view = data.buffer_views[i];
+        function(view.buffer);
+        if (view.has_meshopt_compression) {
+            function(view.meshopt_compression.buffer);
+        }
+    }
+}
+
+template<typename Func>
+void runOverMeshes(cgltf_data& data, Func function) noexcept
+{
+    for (cgltf_size i = 0; i < data.nodes_count; ++i) {
+        function(data.nodes[i].mesh);
+    }
+}
+
+template<typename Func>
+void runOverNodes(cgltf_data& data, Func function) noexcept
+{
+    for (cgltf_size i = 0; i < data.nodes_count; ++i) {
+        cgltf_node& node = data.nodes[i];
+        function(node.parent);
+        for (cgltf_size j = 0; j < node.children_count; ++j) {
+            function(node.children[j]);
+        }
+    }
+    for (cgltf_size i = 0; i < data.scenes_count; ++i) {
+        cgltf_scene& scene = data.scenes[i];
+        for (cgltf_size j = 0; j < scene.nodes_count; ++j) {
+            function(scene.nodes[j]);
+        }
+    }
+    for (cgltf_size i = 0; i < data.skins_count; ++i) {
+        cgltf_skin& skin = data.skins[i];
+        for (cgltf_size j = 0; j < skin.joints_count; ++j) {
+            function(skin.joints[j]);
+        }
+        function(skin.skeleton);
+    }
+    for (cgltf_size i = 0; i < data.animations_count; ++i) {
+        cgltf_animation& animation = data.animations[i];
+        for (cgltf_size j = 0; j < animation.channels_count; ++j) {
+            function(animation.channels[j].target_node);
+        }
+    }
+}
+
+std::vector<cgltf_node*> getStaticNodes(cgltf_data& data, const cgltf_scene& scene) noexcept;
+
+bool getWorldBounds(const cgltf_node& node, std::array<cgltf_float, 3>& boundsMin,
+    std::array<cgltf_float, 3>& boundsMax) noexcept;
+
+cgltf_size getComponentSize(cgltf_component_type type) noexcept;
+
+cgltf_size getElementSize(const cgltf_accessor* accessor) noexcept;
+
+const uint8_t* getAccessorData(const cgltf_accessor* accessor) noexcept;
+
+bool canMerge(const cgltf_primitive& prim) noexcept;
+
+const cgltf_attribute* findAttribute(
+    const cgltf_attribute* attributes, cgltf_size count, const cgltf_attribute& match) noexcept;
+
+cgltf_attribute* findAttribute(const cgltf_primitive& prim, cgltf_attribute_type type, cgltf_int index = 0) noexcept;
+
+bool isCompatible(const cgltf_primitive& a, const cgltf_primitive& b) noexcept;
+
+cgltf_component_type getIndexType(cgltf_size maxIndex) noexcept;
+
+void writeIndex(uint8_t* data, cgltf_component_type type, cgltf_size index, cgltf_size value) noexcept;
+
 extern void cgltf_free_extensions(cgltf_data* data, cgltf_extension* extensions, cgltf_size extensions_count);
 
+cgltf_result cgltf_parse_file_json(
+    const cgltf_options* options, const char* path, cgltf_data** outData, cgltf_size* binOffset) noexcept;
+
+cgltf_buffer* cgltf_add_buffer(cgltf_data* data, cgltf_size size) noexcept;
+
+cgltf_buffer_view* cgltf_add_buffer_views(cgltf_data* data, cgltf_size count) noexcept;
+
+cgltf_accessor* cgltf_add_accessors(cgltf_data* data, cgltf_size count) noexcept;
+
+cgltf_mesh* cgltf_add_meshes(cgltf_data* data, cgltf_size count) noexcept;
+
+cgltf_node* cgltf_add_nodes(cgltf_data* data, cgltf_size count) noexcept;
+
+bool cgltf_add_extension(cgltf_extension*& extensions, cgltf_size& extensionsCount, const std::string_view& name,
+    const std::string_view& json) noexcept;
+
+bool cgltf_add_extension_used(cgltf_data* data, const std::string_view& name) noexcept;
+
+void cgltf_remove_primitive(cgltf_data* data, cgltf_primitive* primitive) noexcept;
+
 void cgltf_remove_mesh(cgltf_data* data, cgltf_mesh* mesh) noexcept;
 
 void cgltf_remove_material(cgltf_data* data, cgltf_material* material) noexcept;
@@ -93,3 +301,13 @@ void cgltf_remove_material(cgltf_data* data, cgltf_material* material) noexcept;
 void cgltf_remove_image(cgltf_data* data, cgltf_image* image) noexcept;
 
 void cgltf_remove_texture(cgltf_data* data, cgltf_texture* texture) noexcept;
+
+void cgltf_remove_accessor(cgltf_data* data, cgltf_accessor* accessor) noexcept;
+
+void cgltf_remove_buffer_view(cgltf_data* data, cgltf_buffer_view* view) noexcept;
+
+void cgltf_remove_buffer(cgltf_data* data, cgltf_buffer* buffer) noexcept;
+
+void cgltf_remove_node(cgltf_data* data, cgltf_node* node) noexcept;
+
+void cgltf_remove_animation(cgltf_data* data, cgltf_animation* animation) noexcept;
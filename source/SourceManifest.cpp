@@ -0,0 +1,139 @@
+/**
+ * Copyright Matthew Oliver
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "SourceManifest.h"
+
+#include "Shared.h"
+
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+
+using namespace std;
+
+namespace {
+constexpr string_view manifestHeader =
+    "# GLTFOptimiser sources: parameters, source size, source time, source hash, output size, output time, output"sv;
+} // namespace
+
+bool SourceManifest::getFileState(const string& file, FileState& state) noexcept
+{
+    error_code ec;
+    state.size = filesystem::file_size(file, ec);
+    if (ec) {
+        return false;
+    }
+    state.modified = static_cast<int64_t>(filesystem::last_write_time(file, ec).time_since_epoch().count());
+    return !ec;
+}
+
+bool SourceManifest::load(const string& fileName) noexcept
+{
+    lock_guard<mutex> guard(lock);
+    manifestFile = fileName;
+    entries.clear();
+    modified = false;
+    ifstream file(fileName);
+    if (!file.is_open()) {
+        return true;
+    }
+    string line;
+    while (getline(file, line)) {
+        if (line.empty() || line.front() == '#') {
+            continue;
+        }
+        // The output file is last as it may contain spaces
+        istringstream fields(line);
+        Entry entry;
+        string outputFile;
+        fields >> entry.parameters >> entry.source.size >> entry.source.modified >> entry.sourceHash >>
+            entry.output.size >> entry.output.modified;
+        if (fields.fail() || fields.get() != '\t' || !getline(fields, outputFile) || outputFile.empty()) {
+            printWarning("Ignoring invalid source manifest entry: "s + line);
+            continue;
+        }
+        entries[outputFile] = std::move(entry);
+    }
+    return true;
+}
+
+bool SourceManifest::save() noexcept
+{
+    lock_guard<mutex> guard(lock);
+    if (!modified) {
+        return true;
+    }
+    string text = string(manifestHeader) + '\n';
+    for (auto& [outputFile, entry] : entries) {
+        text += entry.parameters + '\t' + to_string(entry.source.size) + '\t' + to_string(entry.source.modified) +
+            '\t' + entry.sourceHash + '\t' + to_string(entry.output.size) + '\t' + to_string(entry.output.modified) +
+            '\t' + outputFile + '\n';
+    }
+    if (!writeFile(manifestFile, {span(reinterpret_cast<const uint8_t*>(text.data()), text.size())})) {
+        printError("Failed writing source manifest: "s + manifestFile);
+        return false;
+    }
+    modified = false;
+    return true;
+}
+
+bool SourceManifest::contains(const string& outputFile) noexcept
+{
+    lock_guard<mutex> guard(lock);
+    return entries.contains(outputFile);
+}
+
+bool SourceManifest::isUnchanged(const string& sourceFile, const string& outputFile, const string& parameters) noexcept
+{
+    Entry entry;
+    {
+        lock_guard<mutex> guard(lock);
+        const auto found = entries.find(outputFile);
+        if (found == entries.end()) {
+            return false;
+        }
+        entry = found->second;
+    }
+    FileState source, output;
+    if (entry.parameters != parameters || !getFileState(sourceFile, source) || !getFileState(outputFile, output) ||
+        output != entry.output || source.size != entry.source.size) {
+        return false;
+    }
+    if (source.modified != entry.source.modified) {
+        // Files that have been saved again without changes are only detected by their contents
+        if (getFileHash(sourceFile) != entry.sourceHash) {
+            return false;
+        }
+        lock_guard<mutex> guard(lock);
+        entries[outputFile].source = source;
+        modified = true;
+    }
+    return true;
+}
+
+void SourceManifest::record(const string& sourceFile, const string& outputFile, const string& parameters) noexcept
+{
+    Entry entry;
+    entry.parameters = parameters;
+    entry.sourceHash = getFileHash(sourceFile);
+    if (entry.sourceHash.empty() || !getFileState(sourceFile, entry.source) ||
+        !getFileState(outputFile, entry.output)) {
+        return;
+    }
+    lock_guard<mutex> guard(lock);
+    entries[outputFile] = std::move(entry);
+    modified = true;
+}
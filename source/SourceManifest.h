@@ -0,0 +1,105 @@
+/**
+ * Copyright Matthew Oliver
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#pragma once
+
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <string>
+
+/**
+ * Record of the source image and settings used to create each compressed texture. This is kept between runs so that
+ * textures are only recompressed when their source image or settings change.
+ */
+class SourceManifest
+{
+public:
+    SourceManifest() noexcept = default;
+
+    ~SourceManifest() noexcept = default;
+
+    SourceManifest(const SourceManifest&) = delete;
+
+    SourceManifest& operator=(const SourceManifest&) = delete;
+
+    /**
+     * Load an existing manifest, a missing manifest is treated as empty.
+     * @param fileName The manifest file.
+     * @return True if it succeeds, false if it fails.
+     */
+    [[nodiscard]] bool load(const std::string& fileName) noexcept;
+
+    /**
+     * Write the manifest back to the file it was loaded from.
+     * @return True if it succeeds, false if it fails.
+     */
+    [[nodiscard]] bool save() noexcept;
+
+    [[nodiscard]] bool isLoaded() const noexcept
+    {
+        return !manifestFile.empty();
+    }
+
+    /**
+     * Check if an output has been recorded.
+     * @param outputFile The compressed output texture.
+     * @return True if it has an entry, false if it was not created by a run using this manifest.
+     */
+    [[nodiscard]] bool contains(const std::string& outputFile) noexcept;
+
+    /**
+     * Check if an output is up to date with its source. Sizes and modification times are checked first so that
+     * unchanged files are never read, the source contents are only hashed when its modification time has changed.
+     * @param sourceFile The source image.
+     * @param outputFile The compressed output texture.
+     * @param parameters The settings used to compress the texture.
+     * @return True if the output is up to date, false if it must be recreated.
+     */
+    [[nodiscard]] bool isUnchanged(
+        const std::string& sourceFile, const std::string& outputFile, const std::string& parameters) noexcept;
+
+    /**
+     * Record a newly created or reused output.
+     * @param sourceFile The source image.
+     * @param outputFile The compressed output texture, this should already have been written.
+     * @param parameters The settings used to compress the texture.
+     */
+    void record(const std::string& sourceFile, const std::string& outputFile, const std::string& parameters) noexcept;
+
+private:
+    struct FileState
+    {
+        uint64_t size = 0;
+        int64_t modified = 0;
+
+        bool operator==(const FileState&) const noexcept = default;
+    };
+
+    struct Entry
+    {
+        std::string parameters;
+        FileState source;
+        std::string sourceHash;
+        FileState output;
+    };
+
+    static bool getFileState(const std::string& file, FileState& state) noexcept;
+
+    std::mutex lock;
+    std::string manifestFile;
+    std::map<std::string, Entry> entries;
+    bool modified = false;
+};
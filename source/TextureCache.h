@@ -0,0 +1,171 @@
+/**
+ * Copyright Matthew Oliver
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#pragma once
+
+#include "TextureLoad.h"
+
+#include <algorithm>
+#include <functional>
+#include <future>
+#include <list>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <span>
+#include <string>
+#include <vector>
+
+inline size_t getCacheSize(const std::vector<uint8_t>& data) noexcept
+{
+    return data.size();
+}
+
+inline size_t getCacheSize(const TextureLoad& image) noexcept
+{
+    return static_cast<size_t>(image.imageWidth) * image.imageHeight * image.channelCount * image.bytesPerChannel;
+}
+
+/**
+ * Shares texture results between optimiser instances so that a texture used by several assets is only processed once.
+ * Completed results are evicted in least recently used order once the cache grows beyond its capacity.
+ */
+template<typename T>
+class SharedCache
+{
+public:
+    using Result = std::shared_ptr<const T>;
+
+    /**
+     * Constructor.
+     * @param maxSize Maximum size in bytes of all cached results, 0 for no limit.
+     */
+    SharedCache(size_t maxSize = 0) noexcept
+        : capacity(maxSize)
+    {}
+
+    ~SharedCache() noexcept = default;
+
+    SharedCache(const SharedCache&) = delete;
+
+    SharedCache& operator=(const SharedCache&) = delete;
+
+    /**
+     * Get the result for a texture, creating it if no other job has already done so. If another job is currently
+     * creating the result then this waits for it to complete.
+     * @param keys   Keys that identify the texture (e.g. resolved path and content hash), a match on any of these
+     *  returns the existing result and all keys then refer to it.
+     * @param create Function used to create the result when no existing result is found.
+     * @param source (Optional) Source data the result is created from. Keys are only trusted to identify the texture
+     *  so a match is only used if it was created from identical source data, the data is copied into the cache.
+     * @return The texture result, nullptr if creation failed.
+     */
+    [[nodiscard]] Result get(const std::vector<std::string>& keys, const std::function<Result()>& create,
+        std::span<const uint8_t> source = {}) noexcept
+    {
+        std::promise<Result> newResult;
+        std::shared_future<Result> existing;
+        typename std::list<Entry>::iterator entry;
+        {
+            std::lock_guard<std::mutex> guard(lock);
+            for (auto& key : keys) {
+                if (auto pos = lookup.find(key); pos != lookup.end()) {
+                    // A key collision between different sources must never return another texture's result
+                    const std::vector<uint8_t>& cached = pos->second->source;
+                    if (!source.empty() && !cached.empty() && !std::ranges::equal(source, cached)) {
+                        continue;
+                    }
+                    entry = pos->second;
+                    existing = entry->result;
+                    break;
+                }
+            }
+            if (existing.valid()) {
+                // Any new keys refer to the existing result so that later lookups can match on them directly
+                entries.splice(entries.begin(), entries, entry);
+                for (auto& key : keys) {
+                    if (lookup.try_emplace(key, entry).second) {
+                        entry->keys.push_back(key);
+                    }
+                }
+            } else {
+                // Keys already used by a different source are left referring to that source
+                entries.push_front({newResult.get_future().share(), {}, {source.begin(), source.end()}});
+                entry = entries.begin();
+                for (auto& key : keys) {
+                    if (lookup.try_emplace(key, entry).second) {
+                        entry->keys.push_back(key);
+                    }
+                }
+            }
+        }
+        if (existing.valid()) {
+            return existing.get();
+        }
+
+        // The result is created in the calling job, any other jobs requesting the same texture wait on it
+        Result result = create();
+        newResult.set_value(result);
+        std::lock_guard<std::mutex> guard(lock);
+        entry->ready = true;
+        if (result == nullptr) {
+            // Failures are not kept so that a later request can retry
+            remove(entry);
+            return result;
+        }
+        entry->size = getCacheSize(*result) + entry->source.size();
+        usedSize += entry->size;
+
+        // Pending entries can not be evicted as other jobs may be about to wait on them
+        for (auto i = entries.end(); capacity > 0 && usedSize > capacity && i != entries.begin();) {
+            --i;
+            if (i->ready) {
+                i = remove(i);
+            }
+        }
+        return result;
+    }
+
+private:
+    struct Entry
+    {
+        std::shared_future<Result> result;
+        std::vector<std::string> keys;
+        std::vector<uint8_t> source;
+        size_t size = 0;
+        bool ready = false;
+    };
+
+    typename std::list<Entry>::iterator remove(typename std::list<Entry>::iterator entry) noexcept
+    {
+        for (auto& key : entry->keys) {
+            lookup.erase(key);
+        }
+        usedSize -= entry->size;
+        return entries.erase(entry);
+    }
+
+    std::mutex lock;
+    std::list<Entry> entries;
+    std::map<std::string, typename std::list<Entry>::iterator> lookup;
+    size_t capacity = 0;
+    size_t usedSize = 0;
+};
+
+/** Compressed ktx2 texture data */
+using TextureCache = SharedCache<std::vector<uint8_t>>;
+
+/** Decoded source images, shared between different compression settings of the same image */
+using DecodedTextureCache = SharedCache<TextureLoad>;
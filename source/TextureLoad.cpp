@@ -21,8 +21,10 @@
 
 #include <array>
 #include <bit>
+#include <cstdio>
 #include <fstream>
 #include <ktx.h>
+#include <limits>
 #include <stb_image.h>
 #include <stb_image_resize.h>
 #include <thread>
@@ -54,6 +56,32 @@ TextureLoad::TextureLoad(const string& fileName) noexcept
     data = shared_ptr<uint8_t>(imageData, [](auto p) { stbi_image_free(p); });
 }
 
+TextureLoad::TextureLoad(const uint8_t* memory, size_t size, const string& name) noexcept
+{
+    // Decode directly from memory without copying the encoded image
+    uint8_t* imageData = nullptr;
+    bytesPerChannel = 2;
+    int32_t width = 0;
+    int32_t height = 0;
+    int32_t channels = 0;
+    const int32_t length = static_cast<int32_t>(std::min<size_t>(size, numeric_limits<int32_t>::max()));
+    if (stbi_is_16_bit_from_memory(memory, length))
+        imageData =
+            reinterpret_cast<uint8_t*>(stbi_load_16_from_memory(memory, length, &width, &height, &channels, 0));
+    if (imageData == nullptr) {
+        imageData = stbi_load_from_memory(memory, length, &width, &height, &channels, 0);
+        bytesPerChannel = 1;
+    }
+    if (imageData == nullptr) {
+        printError("Unable to load image '"s + name + "': " + stbi_failure_reason());
+        return;
+    }
+    imageWidth = static_cast<uint32_t>(width);
+    imageHeight = static_cast<uint32_t>(height);
+    channelCount = static_cast<uint32_t>(channels);
+    data = shared_ptr<uint8_t>(imageData, [](auto p) { stbi_image_free(p); });
+}
+
 TextureLoad::TextureLoad(const TextureLoad& other, uint32_t channel) noexcept
 {
     // Create a new object by splitting out the texture channels
@@ -99,12 +127,59 @@ TextureLoad::TextureLoad(uint32_t width, uint32_t height, uint32_t channels, uin
 }
 
 bool TextureLoad::writeKTX(const string& fileName) noexcept
+{
+    printInfo("Writing compressed texture: "s + fileName);
+    const shared_ptr<ktxTexture2> texture = compressKTX(fileName);
+    if (texture == nullptr) {
+        return false;
+    }
+
+    // Write out to disk, the texture is only moved into place once complete so an interrupted write is never mistaken
+    // for an existing texture
+    const string tempFile = getTempFileName(fileName);
+    KTX_error_code result = ktxTexture_WriteToNamedFile((ktxTexture*)texture.get(), tempFile.c_str());
+    if (result != KTX_SUCCESS) {
+        printError("Failed writing ktx texture '"s + fileName + "'" + ": " + ktxErrorString(result));
+        remove(tempFile.c_str());
+        return false;
+    }
+    // Double check file exists
+    if (!ifstream(tempFile).good()) {
+        printError("Failed writing ktx texture '"s + fileName + "'" + ": Unknown error saving to disk");
+        remove(tempFile.c_str());
+        return false;
+    }
+    return replaceFile(tempFile, fileName);
+}
+
+bool TextureLoad::writeKTX(vector<uint8_t>& output, const string& name) noexcept
+{
+    printInfo("Compressing texture: "s + name);
+    const shared_ptr<ktxTexture2> texture = compressKTX(name);
+    if (texture == nullptr) {
+        return false;
+    }
+
+    // Write out to memory
+    ktx_uint8_t* bytes = nullptr;
+    ktx_size_t size = 0;
+    KTX_error_code result = ktxTexture_WriteToMemory((ktxTexture*)texture.get(), &bytes, &size);
+    if (result != KTX_SUCCESS) {
+        printError("Failed writing ktx texture '"s + name + "'" + ": " + ktxErrorString(result));
+        return false;
+    }
+    output.assign(bytes, bytes + size);
+    free(bytes);
+    return true;
+}
+
+shared_ptr<ktxTexture2> TextureLoad::compressKTX(const string& fileName) noexcept
 {
     // Check if texture is in a supported format
     if (bytesPerChannel != 1) {
         printWarning("Converting image to 8bit '"s + fileName + "'");
         if (!convertTo8bit()) {
-            return false;
+            return nullptr;
         }
     }
 
@@ -112,11 +187,10 @@ bool TextureLoad::writeKTX(const string& fileName) noexcept
         printInfo("Normalising image data '"s + fileName + "'");
         // Normalise all data
         if (!normalise()) {
-            return false;
+            return nullptr;
         }
     }
 
-    printInfo("Writing compressed texture: "s + fileName);
     // Check number of required mips for full pyramid
     uint32_t maxSize = std::max(imageWidth, imageHeight);
     uint32_t numLevels = std::max(std::bit_width(maxSize), 1);
@@ -162,14 +236,14 @@ bool TextureLoad::writeKTX(const string& fileName) noexcept
     ;
     if (result != KTX_SUCCESS) {
         printError("Failed creating ktx texture '"s + fileName + "'" + ": " + ktxErrorString(result));
-        return false;
+        return nullptr;
     }
 
     // Copy across existing image data into ktx texture
     result = ktxTexture_SetImageFromMemory(ktxTexture(texture.get()), 0, 0, 0, data.get(), getSize());
     if (result != KTX_SUCCESS) {
         printError("Failed initialising ktx texture '"s + fileName + "'" + ": " + ktxErrorString(result));
-        return false;
+        return nullptr;
     }
 
     // Generate the mip maps
@@ -179,7 +253,7 @@ bool TextureLoad::writeKTX(const string& fileName) noexcept
             std::max(imageWidth >> mip, 1U), std::max(imageHeight >> mip, 1U), channelCount, bytesPerChannel);
         if (mipTexture.data.get() == nullptr) {
             printError("Out of memory"sv);
-            return false;
+            return nullptr;
         }
         stbir_datatype dataType = (bytesPerChannel == 1) ? STBIR_TYPE_UINT8 :
             (bytesPerChannel == 2)                       ? STBIR_TYPE_UINT16 :
@@ -191,13 +265,13 @@ bool TextureLoad::writeKTX(const string& fileName) noexcept
             STBIR_FILTER_MITCHELL, STBIR_FILTER_MITCHELL, colourSpace, nullptr);
         if (res != 1) {
             printError("Failed generating ktx texture mip '"s + fileName + "'");
-            return false;
+            return nullptr;
         }
 
         if (normalMap && channelCount >= 3) {
             // Normalise all data
             if (!mipTexture.normalise()) {
-                return false;
+                return nullptr;
             }
         }
 
@@ -206,7 +280,7 @@ bool TextureLoad::writeKTX(const string& fileName) noexcept
             ktxTexture(texture.get()), mip, 0, 0, mipTexture.data.get(), mipTexture.getSize());
         if (result != KTX_SUCCESS) {
             printError("Failed setting ktx texture mip '"s + fileName + "'" + ": " + ktxErrorString(result));
-            return false;
+            return nullptr;
         }
     }
 
@@ -227,28 +301,17 @@ bool TextureLoad::writeKTX(const string& fileName) noexcept
     result = ktxTexture2_CompressBasisEx(texture.get(), &params);
     if (result != KTX_SUCCESS) {
         printError("Failed encoding ktx texture '"s + fileName + "'" + ": " + ktxErrorString(result));
-        return false;
+        return nullptr;
     }
 
     // Apply zstd supercompression
     result = ktxTexture2_DeflateZstd(texture.get(), 22);
     if (result != KTX_SUCCESS) {
         printError("Failed compressing ktx texture '"s + fileName + "'" + ": " + ktxErrorString(result));
-        return false;
+        return nullptr;
     }
 
-    // Write out to disk
-    result = ktxTexture_WriteToNamedFile((ktxTexture*)texture.get(), fileName.c_str());
-    if (result != KTX_SUCCESS) {
-        printError("Failed writing ktx texture '"s + fileName + "'" + ": " + ktxErrorString(result));
-        return false;
-    }
-    // Double check file exists
-    if (!ifstream(fileName).good()) {
-        printError("Failed writing ktx texture '"s + fileName + "'" + ": Unknown error saving to disk");
-        return false;
-    }
-    return true;
+    return texture;
 }
 
 bool TextureLoad::isUniqueTexture() noexcept
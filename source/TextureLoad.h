@@ -17,12 +17,17 @@
 
 #include <memory>
 #include <string>
+#include <vector>
+
+struct ktxTexture2;
 
 class TextureLoad
 {
 public:
     TextureLoad(const std::string& fileName) noexcept;
 
+    TextureLoad(const uint8_t* memory, size_t size, const std::string& name) noexcept;
+
     TextureLoad(const TextureLoad& other, uint32_t channel) noexcept;
 
     TextureLoad(uint32_t width, uint32_t height, uint32_t channels, uint32_t bytes) noexcept;
@@ -33,6 +38,8 @@ public:
 
     bool writeKTX(const std::string& fileName) noexcept;
 
+    bool writeKTX(std::vector<uint8_t>& output, const std::string& name) noexcept;
+
     bool isUniqueTexture() noexcept;
 
     bool convertTo8bit() noexcept;
@@ -48,4 +55,7 @@ public:
     uint32_t bytesPerChannel = 0;
     bool sRGB = false;
     bool normalMap = false;
+
+private:
+    std::shared_ptr<ktxTexture2> compressKTX(const std::string& fileName) noexcept;
 };
@@ -0,0 +1,322 @@
+/**
+ * Copyright Matthew Oliver
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "TextureManifest.h"
+
+#include "BS_thread_pool.hpp"
+#include "Shared.h"
+#include "TextureLoad.h"
+
+#include <array>
+#include <atomic>
+#include <charconv>
+#include <chrono>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+
+#ifdef _WIN32
+#    ifndef NOMINMAX
+#        define NOMINMAX
+#    endif
+#    ifndef WIN32_LEAN_AND_MEAN
+#        define WIN32_LEAN_AND_MEAN
+#    endif
+#    include <windows.h>
+#else
+#    include <cerrno>
+#    include <csignal>
+#    include <unistd.h>
+#endif
+
+using namespace std;
+
+namespace {
+constexpr string_view manifestHeader = "# GLTFOptimiser texture manifest: sRGB, normalMap, hash, input, output"sv;
+
+/** Locks older than this are assumed to belong to a worker that was killed before releasing them */
+constexpr chrono::hours lockTimeout(1);
+
+/** Owner of a job lock, written into the lock file as 'host, pid, time' separated by tabs */
+struct LockOwner
+{
+    string host;
+    uint64_t pid = 0;
+    int64_t time = 0; /**< Seconds since the epoch when the lock was claimed */
+};
+
+string getHostName() noexcept
+{
+#ifdef _WIN32
+    array<char, MAX_COMPUTERNAME_LENGTH + 1> name = {};
+    DWORD length = static_cast<DWORD>(name.size());
+    if (GetComputerNameA(name.data(), &length) == 0) {
+        return {};
+    }
+    return string(name.data(), length);
+#else
+    array<char, 256> name = {};
+    if (gethostname(name.data(), name.size() - 1) != 0) {
+        return {};
+    }
+    return string(name.data());
+#endif
+}
+
+uint64_t getProcessID() noexcept
+{
+#ifdef _WIN32
+    return GetCurrentProcessId();
+#else
+    return static_cast<uint64_t>(getpid());
+#endif
+}
+
+bool isProcessRunning(uint64_t pid) noexcept
+{
+#ifdef _WIN32
+    HANDLE process = OpenProcess(SYNCHRONIZE, FALSE, static_cast<DWORD>(pid));
+    if (process == nullptr) {
+        return GetLastError() != ERROR_INVALID_PARAMETER;
+    }
+    const bool running = WaitForSingleObject(process, 0) == WAIT_TIMEOUT;
+    CloseHandle(process);
+    return running;
+#else
+    return kill(static_cast<pid_t>(pid), 0) == 0 || errno != ESRCH;
+#endif
+}
+
+bool readLock(const string& lockFile, LockOwner& owner) noexcept
+{
+    ifstream file(lockFile);
+    string line;
+    if (!getline(file, line)) {
+        return false;
+    }
+    const size_t pidStart = line.find('\t');
+    const size_t timeStart = (pidStart != string::npos) ? line.find('\t', pidStart + 1) : string::npos;
+    if (timeStart == string::npos) {
+        return false;
+    }
+    owner.host = line.substr(0, pidStart);
+    const char* end = line.data() + line.length();
+    return from_chars(line.data() + pidStart + 1, line.data() + timeStart, owner.pid).ec == errc() &&
+        from_chars(line.data() + timeStart + 1, end, owner.time).ec == errc();
+}
+
+string describeLock(const string& lockFile) noexcept
+{
+    LockOwner owner;
+    if (!readLock(lockFile, owner)) {
+        return "an unknown worker"s;
+    }
+    const auto age = chrono::duration_cast<chrono::minutes>(
+        chrono::system_clock::now() - chrono::system_clock::time_point(chrono::seconds(owner.time)));
+    return "process "s + to_string(owner.pid) + " on " + owner.host + " claimed " + to_string(age.count()) +
+        " minutes ago";
+}
+
+bool isLockStale(const string& lockFile) noexcept
+{
+    // Locks from an older version or that are still being written have no owner so only their age is used
+    LockOwner owner;
+    if (readLock(lockFile, owner)) {
+        if (owner.host == getHostName() && !isProcessRunning(owner.pid)) {
+            return true;
+        }
+        return chrono::system_clock::now() - chrono::system_clock::time_point(chrono::seconds(owner.time)) >
+            lockTimeout;
+    }
+    error_code ec;
+    const auto modified = filesystem::last_write_time(lockFile, ec);
+    return !ec && filesystem::file_time_type::clock::now() - modified > lockTimeout;
+}
+
+bool claimJob(const string& lockFile) noexcept
+{
+    // Exclusive creation fails if any other worker has already claimed the job
+    FILE* lock = fopen(lockFile.c_str(), "wx");
+    if (lock == nullptr) {
+        if (!isLockStale(lockFile)) {
+            return false;
+        }
+        // Stale locks are moved aside first so that only one worker can reclaim them, the moved lock is checked again
+        // as another worker may have replaced the stale lock in between. Any remaining race only results in a job
+        // being encoded twice which is harmless as outputs are moved into place once complete
+        const string staleFile = lockFile + '.' + getHostName() + '.' + to_string(getProcessID());
+        if (rename(lockFile.c_str(), staleFile.c_str()) != 0) {
+            return false;
+        }
+        const bool stale = isLockStale(staleFile);
+        if (!stale) {
+            rename(staleFile.c_str(), lockFile.c_str());
+            return false;
+        }
+        printWarning("Reclaiming stale texture job lock held by "s + describeLock(staleFile) + ": " + lockFile);
+        remove(staleFile.c_str());
+        lock = fopen(lockFile.c_str(), "wx");
+        if (lock == nullptr) {
+            return false;
+        }
+    }
+    const auto now = chrono::duration_cast<chrono::seconds>(chrono::system_clock::now().time_since_epoch());
+    fprintf(lock, "%s\t%llu\t%lld\n", getHostName().c_str(), static_cast<unsigned long long>(getProcessID()),
+        static_cast<long long>(now.count()));
+    fclose(lock);
+    return true;
+}
+
+bool encodeJob(const TextureJob& job) noexcept
+{
+    // The source may have been modified since the manifest was written
+    if (getFileHash(job.inputFile) != job.hash) {
+        printError("Source texture has changed since the manifest was written: "s + job.inputFile);
+        return false;
+    }
+    TextureLoad image(job.inputFile);
+    if (image.data.get() == nullptr) {
+        return false;
+    }
+    image.sRGB = job.sRGB;
+    image.normalMap = job.normalMap;
+
+    // Textures are moved into place once complete so other processes never see a partially written texture
+    return image.writeKTX(job.outputFile);
+}
+} // namespace
+
+bool writeTextureManifest(const string& manifest, const vector<TextureJob>& jobs) noexcept
+{
+    printInfo("Writing texture manifest: "s + manifest);
+    ofstream file(manifest);
+    file << manifestHeader << '\n';
+    for (auto& job : jobs) {
+        file << (job.sRGB ? '1' : '0') << '\t' << (job.normalMap ? '1' : '0') << '\t' << job.hash << '\t'
+             << job.inputFile << '\t' << job.outputFile << '\n';
+    }
+    file.close();
+    if (file.fail()) {
+        printError("Failed writing texture manifest: "s + manifest);
+        return false;
+    }
+    return true;
+}
+
+bool readTextureManifest(const string& manifest, vector<TextureJob>& jobs) noexcept
+{
+    ifstream file(manifest);
+    if (!file.is_open()) {
+        printError("Failed to open texture manifest: "s + manifest);
+        return false;
+    }
+    string line;
+    while (getline(file, line)) {
+        if (!line.empty() && line.back() == '\r') {
+            line.pop_back();
+        }
+        if (line.empty() || line.front() == '#') {
+            continue;
+        }
+        array<string, 5> fields;
+        size_t start = 0;
+        for (size_t i = 0; i < fields.size(); ++i) {
+            const size_t end = (i + 1 < fields.size()) ? line.find('\t', start) : line.length();
+            if (end == string::npos) {
+                printError("Invalid texture manifest entry: "s + line);
+                return false;
+            }
+            fields[i] = line.substr(start, end - start);
+            start = end + 1;
+        }
+        TextureJob job;
+        job.sRGB = (fields[0] == "1");
+        job.normalMap = (fields[1] == "1");
+        job.hash = fields[2];
+        job.inputFile = fields[3];
+        job.outputFile = fields[4];
+        jobs.push_back(std::move(job));
+    }
+    return true;
+}
+
+bool runTextureWorker(const string& manifest) noexcept
+{
+    vector<TextureJob> jobs;
+    if (!readTextureManifest(manifest, jobs)) {
+        return false;
+    }
+
+    BS::thread_pool pool;
+    atomic<size_t> encoded = 0;
+    atomic<size_t> failed = 0;
+    vector<future<void>> tasks;
+    for (auto& job : jobs) {
+        tasks.push_back(pool.submit([&job, &encoded, &failed]() {
+            if (ifstream(job.outputFile).good()) {
+                return;
+            }
+            const string lockFile = job.outputFile + ".lock";
+            if (!claimJob(lockFile)) {
+                return;
+            }
+            // The job may have been completed and released between the first check and claiming it
+            if (!ifstream(job.outputFile).good()) {
+                if (encodeJob(job)) {
+                    ++encoded;
+                } else {
+                    printError("Failed texture job: "s + job.inputFile);
+                    ++failed;
+                }
+            }
+            remove(lockFile.c_str());
+        }));
+    }
+    for (auto& task : tasks) {
+        task.wait();
+    }
+    printInfo("Worker encoded "s + to_string(encoded) + " of " + to_string(jobs.size()) +
+        " textures, the rest were completed or claimed by other workers");
+    return failed == 0;
+}
+
+bool checkTextureManifest(const string& manifest) noexcept
+{
+    vector<TextureJob> jobs;
+    if (!readTextureManifest(manifest, jobs)) {
+        return false;
+    }
+    bool complete = true;
+    size_t locks = 0;
+    for (auto& job : jobs) {
+        const string lockFile = job.outputFile + ".lock";
+        const bool locked = ifstream(lockFile).good();
+        if (!ifstream(job.outputFile).good()) {
+            printError("Texture job has not been completed: "s + job.outputFile +
+                (locked ? " (locked by " + describeLock(lockFile) + ')' : ""s));
+            complete = false;
+        } else if (locked) {
+            printWarning("Completed texture job still has a lock: "s + lockFile);
+        }
+        locks += locked ? 1 : 0;
+    }
+    if (locks > 0) {
+        printWarning(to_string(locks) + " texture job locks remain. If no worker is still running, delete the '.lock' "
+            "files next to the outputs or run a worker which reclaims locks whose process has exited or that are more "
+            "than " + to_string(lockTimeout.count()) + " hours old");
+    }
+    return complete;
+}
@@ -0,0 +1,50 @@
+/**
+ * Copyright Matthew Oliver
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#pragma once
+
+#include <string>
+#include <vector>
+
+/** A texture compression job that can be run by a separate worker process */
+struct TextureJob
+{
+    std::string inputFile;  /**< Absolute path of the source image */
+    std::string outputFile; /**< Absolute path of the ktx2 file to write */
+    std::string hash;       /**< Content hash of the source image when the manifest was written */
+    bool sRGB = false;
+    bool normalMap = false;
+};
+
+[[nodiscard]] bool writeTextureManifest(const std::string& manifest, const std::vector<TextureJob>& jobs) noexcept;
+
+[[nodiscard]] bool readTextureManifest(const std::string& manifest, std::vector<TextureJob>& jobs) noexcept;
+
+/**
+ * Run the jobs in a texture manifest that have not been completed or claimed by another worker. Workers only
+ * coordinate through the file system, each job is claimed by exclusively creating a lock file next to its output so
+ * any number of workers can share the same manifest. Locks left by a worker whose process has exited or that are more
+ * than an hour old are reclaimed.
+ * @param manifest The manifest file.
+ * @return True if all jobs run by this worker succeeded, false if any failed.
+ */
+[[nodiscard]] bool runTextureWorker(const std::string& manifest) noexcept;
+
+/**
+ * Check that every job in a texture manifest has been completed, any job locks that remain are reported.
+ * @param manifest The manifest file.
+ * @return True if all output textures exist, false if any are missing.
+ */
+[[nodiscard]] bool checkTextureManifest(const std::string& manifest) noexcept;
@@ -14,7 +14,11 @@
  * limitations under the License.
  */
 
+#include "Batch.h"
+#include "Benchmark.h"
 #include "Optimiser.h"
+#include "Server.h"
+#include "TextureManifest.h"
 #include "Version.h"
 
 #include <CLI/App.hpp>
@@ -29,9 +33,37 @@ int main(int argc, char* argv[])
     CLI::App app{"GLTF file optimiser"};
     app.set_version_flag("--version", std::string(SIG_VERSION_STR));
     string inputFile;
-    app.add_option("-i,--input", inputFile, "The input GLTF file")->required();
+    auto inputOption = app.add_option("-i,--input", inputFile, "The input GLTF file");
     string outputFile;
-    app.add_option("-o,--output", outputFile, "The output GLTF file (defaults to input file)")->default_str(inputFile);
+    app.add_option("-o,--output", outputFile,
+           "The output GLTF file (defaults to input file), or the output folder when optimising a batch")
+        ->default_str(inputFile);
+    string batch;
+    auto batchOption = app.add_option("-b,--batch", batch,
+           "Optimise multiple files using shared threads and texture encodes, either a text file listing one input "
+           "file per line or a folder path ending with a wildcard file name (e.g. *.gltf)")
+        ->excludes(inputOption);
+    uint32_t batchJobs = 4;
+    app.add_option("--batch-jobs", batchJobs,
+           "Number of batch files (or server jobs) that are optimised at the same time")
+        ->default_val(4)
+        ->check(CLI::PositiveNumber);
+    string serveSocket;
+    auto serveOption = app.add_option("--serve", serveSocket,
+                              "Run as a server that optimises files submitted to this local socket path until "
+                              "interrupted, threads and texture caches are kept between jobs")
+                           ->excludes(inputOption)
+                           ->excludes(batchOption);
+    string submitSocket;
+    app.add_option("--submit", submitSocket,
+           "Submit the input file to a server listening on this socket path instead of optimising it in this "
+           "process")
+        ->excludes(serveOption)
+        ->excludes(batchOption);
+    uint32_t cacheSize = 1024;
+    app.add_option("--cache-size", cacheSize,
+           "Maximum size in MiB of each of the texture caches shared by batch files or server jobs (0 for no limit)")
+        ->default_val(1024);
     bool keepTextures = false;
     app.add_flag("-k,--keep-uncompressed-textures", keepTextures, "Keep original uncompressed textures")
         ->default_val(false);
@@ -43,19 +75,183 @@ int main(int argc, char* argv[])
     app.add_flag("-t,--split-metal-rough", splitTextures,
            "Split compressed metallicity/roughness textures into separate files (not GLTF standard)")
         ->default_val(false);
+    bool flattenNodes = false;
+    app.add_flag("-f,--flatten-static-nodes", flattenNodes,
+           "Bake transforms of non-animated nodes into their meshes and merge them by material")
+        ->default_val(false);
+    uint32_t instancingMinimum = 0;
+    app.add_option("-g,--gpu-instancing", instancingMinimum,
+           "Replace static nodes sharing a mesh with a single EXT_mesh_gpu_instancing node when there are at least "
+           "this many (0 disables)")
+        ->default_val(0);
+    bool dracoCompress = false;
+    app.add_flag("-d,--draco-compress", dracoCompress, "Compress output meshes using KHR_draco_mesh_compression")
+        ->default_val(false);
+    bool meshlets = false;
+    app.add_flag("-m,--meshlets", meshlets, "Generate meshlets with culling data for each triangle mesh primitive")
+        ->default_val(false);
+    uint32_t meshletVertices = 64;
+    app.add_option("--meshlet-vertices", meshletVertices, "Maximum number of vertices in each meshlet")
+        ->default_val(64)
+        ->check(CLI::Range(3, 255));
+    uint32_t meshletTriangles = 124;
+    app.add_option("--meshlet-triangles", meshletTriangles,
+           "Maximum number of triangles in each meshlet (must be a multiple of 4)")
+        ->default_val(124)
+        ->check(CLI::Range(4, 512))
+        ->check([](const string& value) { return (stoul(value) % 4 == 0) ? ""s : "Value must be a multiple of 4"s; });
+    float morphEpsilon = 0.0f;
+    app.add_option("--morph-epsilon", morphEpsilon,
+           "Morph target deltas at or below this value are treated as zero when removing empty targets and creating "
+           "sparse targets")
+        ->default_val(0.0f)
+        ->check(CLI::NonNegativeNumber);
+    float animationTolerance = 0.000001f;
+    app.add_option("--animation-tolerance", animationTolerance,
+           "Maximum error allowed when removing animation keys that can be recreated by interpolation")
+        ->default_val(0.000001f)
+        ->check(CLI::NonNegativeNumber);
+    bool quantiseRotations = false;
+    app.add_flag("--quantise-rotations", quantiseRotations, "Store animation rotations as normalised 16bit integers")
+        ->default_val(false);
+    bool spatialSort = false;
+    app.add_flag("-s,--spatial-sort", spatialSort,
+           "Reorder nodes, meshes and geometry buffers so that spatially close objects are stored together")
+        ->default_val(false);
+    uint32_t tileNodes = 0;
+    auto tileOption = app.add_option("--tile-nodes", tileNodes,
+           "Split the output into spatial tiles of at most this many mesh nodes along with a tileset index (0 "
+           "disables)")
+        ->default_val(0);
+    bool texturesOnly = false;
+    app.add_flag("--textures-only", texturesOnly,
+           "Only optimise images and textures, geometry buffers are left untouched and are not loaded")
+        ->default_val(false);
+    bool outputGLB = false;
+    app.add_flag("--glb", outputGLB,
+           "Write a single binary glb file with all geometry and compressed textures embedded (the output file "
+           "extension is changed to .glb)")
+        ->default_val(false)
+        ->excludes(tileOption);
+    bool resume = false;
+    app.add_flag("--resume", resume,
+           "Skip textures recorded as complete in the journal of an interrupted run (written next to the output "
+           "file), after checking the recorded output is unchanged")
+        ->default_val(false);
+    bool incremental = false;
+    app.add_flag("--incremental", incremental,
+           "Record the source image of each compressed texture next to the output file and only recompress textures "
+           "whose source image or settings have changed since a previous run (even with -r)")
+        ->default_val(false);
+    bool continueOnError = false;
+    app.add_flag("--continue-on-error", continueOnError,
+           "Keep running all remaining texture jobs after one fails and report every failure, by default the first "
+           "failure cancels any jobs that have not started (no output is written in either case)")
+        ->default_val(false);
+    string exportManifest;
+    auto exportOption = app.add_option("--export-textures", exportManifest,
+                               "Write texture compression jobs to this manifest file for --worker processes instead "
+                               "of compressing them, images are left unchanged until --merge is run")
+                            ->excludes(batchOption);
+    string workerManifest;
+    auto workerOption = app.add_option("--worker", workerManifest,
+                               "Run the jobs in a texture manifest that have not been completed or claimed by other "
+                               "workers, any number of workers can share a manifest")
+                            ->excludes(inputOption)
+                            ->excludes(batchOption)
+                            ->excludes(serveOption);
+    string mergeManifest;
+    app.add_option("--merge", mergeManifest,
+           "Check that all jobs in a texture manifest have completed and update the input file (as written by "
+           "--export-textures) to use the compressed textures")
+        ->excludes(batchOption)
+        ->excludes(exportOption)
+        ->excludes(workerOption);
+    bool benchmarkWriter = false;
+    app.add_flag("--benchmark-writer", benchmarkWriter,
+           "Report the write time and peak memory use of writing the input file's JSON with the streaming writer "
+           "and with cgltf_write_file, the input is not optimised")
+        ->needs(inputOption);
     CLI11_PARSE(app, argc, argv);
-    if (outputFile.empty()) {
-        outputFile = inputFile;
+    if (!serveSocket.empty()) {
+        return runServer(serveSocket, batchJobs, static_cast<size_t>(cacheSize) * 1024 * 1024) ? 0 : 1;
+    }
+    if (!workerManifest.empty()) {
+        return runTextureWorker(workerManifest) ? 0 : 1;
     }
+    if (benchmarkWriter) {
+        return runWriterBenchmark(inputFile) ? 0 : 1;
+    }
+    if (inputFile.empty() && batch.empty()) {
+        printError("An input file or batch is required"sv);
+        return 1;
+    }
+    auto getOutputFile = [&](const string& input) {
+        string output = outputFile;
+        if (!batch.empty() && !output.empty()) {
+            // Batch outputs keep their input file names
+            if (output.back() != '/' && output.back() != '\\') {
+                output += '/';
+            }
+            output += input.substr(input.find_last_of("/\\") + 1);
+        } else if (output.empty()) {
+            output = input;
+        }
+        if (outputGLB) {
+            output = getFolder(output) + getSidecarFileName(output, ".glb"sv);
+        }
+        return output;
+    };
 
     // Optimise meshes
     Optimiser::Options opts;
     opts.keepOriginalTextures = keepTextures;
     opts.replaceCompressedTextures = regenCompressed;
     opts.splitMetalRoughTextures = splitTextures;
+    opts.flattenStaticNodes = flattenNodes;
+    opts.instancingMinimum = instancingMinimum;
+    opts.dracoCompressMeshes = dracoCompress;
+    opts.generateMeshlets = meshlets;
+    opts.meshletMaxVertices = meshletVertices;
+    opts.meshletMaxTriangles = meshletTriangles;
+    opts.morphTargetEpsilon = morphEpsilon;
+    opts.animationTolerance = animationTolerance;
+    opts.quantiseRotations = quantiseRotations;
+    opts.spatialSort = spatialSort;
+    opts.tileMaxNodes = tileNodes;
+    opts.texturesOnly = texturesOnly;
+    opts.outputGLB = outputGLB;
+    opts.resume = resume;
+    opts.incremental = incremental;
+    opts.continueOnError = continueOnError;
+    opts.textureManifest = exportManifest;
+
+    // Geometry was already optimised when the manifest was exported so only the textures are updated
+    if (!mergeManifest.empty()) {
+        if (!checkTextureManifest(mergeManifest)) {
+            return 1;
+        }
+        opts.texturesOnly = true;
+        opts.replaceCompressedTextures = false;
+    }
+
+    // Optimise all files in a batch together
+    if (!batch.empty()) {
+        vector<pair<string, string>> files;
+        for (auto& file : findBatchFiles(batch)) {
+            files.emplace_back(file, getOutputFile(file));
+        }
+        return optimiseBatch(opts, files, batchJobs, static_cast<size_t>(cacheSize) * 1024 * 1024) ? 0 : 1;
+    }
+
+    // Run on an already running server
+    if (!submitSocket.empty()) {
+        return submitJob(submitSocket, inputFile, getOutputFile(inputFile), opts) ? 0 : 1;
+    }
+
     Optimiser opt(opts);
 
-    if (!opt.pass(inputFile, outputFile)) {
+    if (!opt.pass(inputFile, getOutputFile(inputFile))) {
         return 1;
     }
 